@@ -0,0 +1,120 @@
+/* bounded.c - render a multi-gigabyte synthetic document under an RSS cap
+ *
+ * Usage: bench_bounded [FILE [SIZE_MB [RSS_CAP_MB]]]
+ *
+ * FILE (default /tmp/scidown-bounded.md) is generated with SIZE_MB
+ * megabytes (default 4096) of log-like sections, unless it already has
+ * that size: headers, paragraphs, lists, code, tables and links to a fixed
+ * set of references, with a figure and a footnote every BENCH_FLOAT_EVERY
+ * sections. It is then rendered with md2html_mapped to /dev/null; the exit
+ * status is 1 when the peak RSS exceeds RSS_CAP_MB (default 64).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define DEF_FILE "/tmp/scidown-bounded.md"
+#define DEF_SIZE_MB 4096
+#define DEF_RSS_CAP_MB 64
+
+#define BENCH_REFS 64
+#define BENCH_FLOAT_EVERY 1024
+
+int md2html_mapped(const char *input, FILE *output);
+
+static double
+now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* put_section: one section of the synthetic document, n numbers its labels */
+static void
+put_section(FILE *file, unsigned long n)
+{
+	fprintf(file, "## Section %lu\n\n", n);
+	fprintf(file,
+		"Generated entry %lu with *emphasis*, **strong** text, `inline code` and "
+		"a [reference link][ref%lu].\n"
+		"The second line of the paragraph has an <http://example.com/%lu> autolink.\n\n",
+		n, n % BENCH_REFS, n);
+	fprintf(file, "- first item %lu\n- second item with _emphasis_\n- third item\n\n", n);
+	fprintf(file, "```\nfor (i = 0; i < %lu; i++)\n\tsum += i;\n```\n\n", n);
+	fprintf(file, "| key | value |\n|-----|-------|\n| n | %lu |\n| n^2 | %lu |\n\n", n, n * n);
+
+	if (n % BENCH_FLOAT_EVERY)
+		return;
+
+	fprintf(file, "See figure (#fig:%lu)[^n%lu].\n\n", n, n);
+	fprintf(file, "@figure(fig:%lu)\n![plot %lu](plot%lu.png)\n\n@caption(Plot number %lu)\n@/\n\n", n, n, n, n);
+	fprintf(file, "[^n%lu]: Footnote of entry %lu.\n\n", n, n);
+}
+
+static int
+generate(const char *path, unsigned long long size)
+{
+	struct stat st;
+	unsigned long n = 0;
+	FILE *file;
+
+	if (stat(path, &st) == 0 && (unsigned long long)st.st_size >= size)
+		return 0;
+
+	file = fopen(path, "wb");
+	if (!file) {
+		perror(path);
+		return -1;
+	}
+
+	fprintf(file, "---\ntitle: Bounded memory benchmark\nauthor: bench_bounded\n---\n\n");
+	for (n = 0; n < BENCH_REFS; n++)
+		fprintf(file, "[ref%lu]: http://example.com/ref/%lu \"Reference %lu\"\n", n, n, n);
+	fprintf(file, "\n");
+
+	n = 0;
+	while ((unsigned long long)ftell(file) < size)
+		put_section(file, n++);
+
+	fclose(file);
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : DEF_FILE;
+	unsigned long long size = (argc > 2 ? strtoull(argv[2], NULL, 10) : DEF_SIZE_MB) << 20;
+	long cap = argc > 3 ? strtol(argv[3], NULL, 10) : DEF_RSS_CAP_MB;
+	struct rusage usage;
+	double t1, t2;
+	FILE *output;
+	int ret;
+
+	t1 = now_s();
+	if (generate(path, size))
+		return 5;
+	t2 = now_s();
+	fprintf(stderr, "Input: %s, %llu MB (%.1f s to generate).\n", path, size >> 20, t2 - t1);
+
+	output = fopen("/dev/null", "wb");
+	t1 = now_s();
+	ret = md2html_mapped(path, output);
+	t2 = now_s();
+	fclose(output);
+
+	if (ret)
+		return ret;
+
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(stderr, "Rendered in %.1f s, %.1f MB/s, peak RSS %ld MB (cap %ld MB).\n",
+		t2 - t1, (size >> 20) / (t2 - t1), usage.ru_maxrss >> 10, cap);
+
+	return usage.ru_maxrss >> 10 > cap;
+}
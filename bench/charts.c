@@ -0,0 +1,119 @@
+/* charts.c - render time of a chart-heavy document
+ *
+ * Usage: bench_charts [FILE [RUNS]]
+ *
+ * FILE (default bench/charts.md) is rendered RUNS times (default 20) to
+ * HTML, where charter blocks become SVG, and to LaTeX, where they become
+ * pgfplots. For each renderer it reports the output bytes, the median
+ * render time and that time divided by the number of charter blocks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "document.h"
+#include "html.h"
+#include "latex.h"
+
+#define DEF_FILE "bench/charts.md"
+#define DEF_RUNS 20
+
+static double
+now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+/* count_charts: charter blocks of the source */
+static size_t
+count_charts(const uint8_t *data, size_t size)
+{
+	static const char fence[] = "```charter";
+	size_t i, count = 0;
+
+	for (i = 0; i + sizeof(fence) - 1 <= size; ++i)
+		if ((i == 0 || data[i - 1] == '\n') && memcmp(data + i, fence, sizeof(fence) - 1) == 0)
+			count++;
+
+	return count;
+}
+
+/* bench_renderer: render data runs times, prints the figures of the last render */
+static void
+bench_renderer(const char *name, const uint8_t *data, size_t size, size_t charts, int latex, int runs)
+{
+	localization local = {"Figure", "Listing", "Table"};
+	ext_definition ext = {NULL, NULL};
+	double *times = malloc(runs * sizeof(double)), t0, median;
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	hoedown_buffer *ob = hoedown_buffer_new(64);
+	int i;
+
+	for (i = 0; i < runs; ++i) {
+		hoedown_buffer_reset(ob);
+		t0 = now_s();
+		renderer = latex ?
+			scidown_latex_renderer_new(SCIDOWN_RENDER_CHARTER, 0, local) :
+			hoedown_html_renderer_new(SCIDOWN_RENDER_CHARTER, 0, local);
+		document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, &ext, NULL, 16);
+		hoedown_document_render(document, ob, data, size, -1);
+		hoedown_document_free(document);
+		if (latex)
+			scidown_latex_renderer_free(renderer);
+		else
+			hoedown_html_renderer_free(renderer);
+		times[i] = now_s() - t0;
+	}
+
+	qsort(times, runs, sizeof(double), cmp_double);
+	median = times[runs / 2] * 1e3;
+	fprintf(stderr, "%-6s %10zu bytes %10.3f ms %8.3f ms per chart\n",
+		name, ob->size, median, charts ? median / charts : 0.0);
+
+	hoedown_buffer_free(ob);
+	free(times);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : DEF_FILE;
+	int runs = argc > 2 ? atoi(argv[2]) : DEF_RUNS;
+	hoedown_buffer *source;
+	size_t charts;
+	FILE *file;
+
+	if (runs < 1)
+		runs = 1;
+
+	file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Unable to open \"%s\".\n", path);
+		return 5;
+	}
+	source = hoedown_buffer_new(1024);
+	hoedown_buffer_putf(source, file);
+	fclose(file);
+
+	charts = count_charts(source->data, source->size);
+	fprintf(stderr, "%zu charter blocks\n", charts);
+
+	bench_renderer("html", source->data, source->size, charts, 0, runs);
+	bench_renderer("latex", source->data, source->size, charts, 1, runs);
+
+	hoedown_buffer_free(source);
+	return 0;
+}
@@ -0,0 +1,131 @@
+/* compact.c - output size of the compact HTML mode
+ *
+ * Usage: bench_compact [FILE [RUNS]]
+ *
+ * FILE (default examples/example_report.md) is rendered RUNS times (default
+ * 200) with the default HTML flags, then with SCIDOWN_RENDER_COMPACT added.
+ * For each mode it reports the output bytes, the median render time and the
+ * number of text nodes a browser builds out of the whitespace between tags,
+ * which is the part of the DOM the compact mode saves.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "document.h"
+#include "html.h"
+
+#define DEF_FILE "examples/example_report.md"
+#define DEF_RUNS 200
+
+#define BENCH_FLAGS (SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS)
+
+static double
+now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+/* whitespace_nodes: runs of whitespace alone between two tags */
+static size_t
+whitespace_nodes(const uint8_t *data, size_t size)
+{
+	size_t i, count = 0, run;
+
+	for (i = 0; i < size; ++i) {
+		if (data[i] != '>')
+			continue;
+
+		for (run = i + 1; run < size && (data[run] == ' ' || data[run] == '\n' || data[run] == '\t'); ++run);
+		if (run > i + 1 && run < size && data[run] == '<')
+			count++;
+	}
+
+	return count;
+}
+
+/* bench_mode: render data runs times, prints the figures of the last render */
+static size_t
+bench_mode(const char *name, const uint8_t *data, size_t size, const char *base_folder, scidown_render_flags flags, int runs)
+{
+	localization local = {"Figure", "Listing", "Table"};
+	ext_definition ext = {NULL, NULL};
+	double *times = malloc(runs * sizeof(double)), t0;
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	hoedown_buffer *ob = hoedown_buffer_new(64);
+	size_t bytes;
+	int i;
+
+	for (i = 0; i < runs; ++i) {
+		hoedown_buffer_reset(ob);
+		t0 = now_s();
+		renderer = hoedown_html_renderer_new(flags, 0, local);
+		document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, &ext, base_folder, 16);
+		hoedown_document_render(document, ob, data, size, -1);
+		hoedown_document_free(document);
+		hoedown_html_renderer_free(renderer);
+		times[i] = now_s() - t0;
+	}
+
+	qsort(times, runs, sizeof(double), cmp_double);
+	fprintf(stderr, "%-8s %10zu bytes %8.3f ms %8zu whitespace nodes\n",
+		name, ob->size, times[runs / 2] * 1e3, whitespace_nodes(ob->data, ob->size));
+
+	bytes = ob->size;
+	hoedown_buffer_free(ob);
+	free(times);
+	return bytes;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : DEF_FILE;
+	int runs = argc > 2 ? atoi(argv[2]) : DEF_RUNS;
+	hoedown_buffer *source;
+	size_t plain, compact;
+	char *base_folder, *slash;
+	FILE *file;
+
+	if (runs < 1)
+		runs = 1;
+
+	file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Unable to open \"%s\".\n", path);
+		return 5;
+	}
+	source = hoedown_buffer_new(1024);
+	hoedown_buffer_putf(source, file);
+	fclose(file);
+
+	/* @include paths are relative to the document */
+	base_folder = strdup(path);
+	slash = strrchr(base_folder, '/');
+	if (slash)
+		*slash = 0;
+	else
+		strcpy(base_folder, ".");
+
+	plain = bench_mode("default", source->data, source->size, base_folder, BENCH_FLAGS, runs);
+	compact = bench_mode("compact", source->data, source->size, base_folder,
+		BENCH_FLAGS | SCIDOWN_RENDER_COMPACT, runs);
+	fprintf(stderr, "compact output is %.1f%% smaller\n", plain ? 100.0 * (plain - compact) / plain : 0.0);
+
+	hoedown_buffer_free(source);
+	free(base_folder);
+	return 0;
+}
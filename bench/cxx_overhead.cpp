@@ -0,0 +1,212 @@
+/* cxx_overhead.cpp - compare the C++ wrapper with the C API it wraps
+ *
+ * Usage: bench_cxx [FILE [ITERATIONS [TOLERANCE_PCT]]]
+ *
+ * FILE (default: a generated document of about 256 KB) is rendered to HTML
+ * ITERATIONS times (default 10), once through the C API with a document and
+ * an output buffer reused across renders, once through scidown::Session,
+ * and once through each of them with everything created for every render,
+ * as md2html does. The best of BENCH_ROUNDS rounds is kept for each; the
+ * exit status is 1 when the wrapper is slower than the C API by more than
+ * TOLERANCE_PCT percent (default 5).
+ */
+
+#include "scidown.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#define DEF_ITERATIONS 10
+#define DEF_TOLERANCE_PCT 5
+#define BENCH_ROUNDS 3
+#define BENCH_SECTIONS 1024
+
+static double
+now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static std::string
+generate(void)
+{
+	std::string doc = "---\ntitle: C++ wrapper benchmark\nauthor: bench_cxx\n---\n\n";
+	char section[1024];
+	unsigned long n;
+
+	for (n = 0; n < 64; n++) {
+		snprintf(section, sizeof(section), "[ref%lu]: http://example.com/ref/%lu \"Reference %lu\"\n", n, n, n);
+		doc += section;
+	}
+
+	for (n = 0; n < BENCH_SECTIONS; n++) {
+		snprintf(section, sizeof(section),
+			"\n## Section %lu\n\n"
+			"Entry %lu with *emphasis*, **strong** text, `inline code` and a [link][ref%lu].\n\n"
+			"- first item\n- second item with _emphasis_\n\n"
+			"```\nfor (i = 0; i < %lu; i++)\n\tsum += i;\n```\n\n"
+			"| key | value |\n|-----|-------|\n| n | %lu |\n",
+			n, n, n % 64, n, n);
+		doc += section;
+	}
+
+	return doc;
+}
+
+static std::string
+load(const char *path)
+{
+	std::string doc;
+	char chunk[1 << 16];
+	size_t n;
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		perror(path);
+		exit(5);
+	}
+
+	while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		doc.append(chunk, n);
+
+	fclose(file);
+	return doc;
+}
+
+/* c_reused: the C API, document and output buffer kept across renders */
+static size_t
+c_reused(const std::string &input, int iterations)
+{
+	hoedown_renderer *renderer = hoedown_html_renderer_new(scidown_render_flags(), 0, scidown::default_localization());
+	hoedown_document *document = hoedown_document_new(renderer, scidown::Document::default_extensions, NULL, NULL, 16);
+	hoedown_buffer *ob = hoedown_buffer_new(input.size() / 2 + 64);
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		ob->size = 0;
+		hoedown_html_renderer_reset(renderer);
+		hoedown_document_render(document, ob, (const uint8_t *)input.data(), input.size(), -1);
+		total += ob->size;
+	}
+
+	hoedown_buffer_free(ob);
+	hoedown_document_free(document);
+	hoedown_html_renderer_free(renderer);
+	return total;
+}
+
+/* c_fresh: the C API, everything created for every render and the output copied out */
+static size_t
+c_fresh(const std::string &input, int iterations)
+{
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		hoedown_renderer *renderer = hoedown_html_renderer_new(scidown_render_flags(), 0, scidown::default_localization());
+		hoedown_document *document = hoedown_document_new(renderer, scidown::Document::default_extensions, NULL, NULL, 16);
+		hoedown_buffer *ob = hoedown_buffer_new(64);
+		uint8_t *output;
+
+		hoedown_document_render(document, ob, (const uint8_t *)input.data(), input.size(), -1);
+		hoedown_document_free(document);
+		hoedown_html_renderer_free(renderer);
+
+		output = (uint8_t *)malloc(ob->size);
+		memcpy(output, ob->data, ob->size);
+		total += ob->size;
+		hoedown_buffer_free(ob);
+		free(output);
+	}
+
+	return total;
+}
+
+/* cxx_session: scidown::Session */
+static size_t
+cxx_session(const std::string &input, int iterations)
+{
+	scidown::Session session(scidown::Renderer::html());
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < iterations; i++)
+		total += session.render(input).size();
+
+	return total;
+}
+
+/* cxx_fresh: renderer and document created for every render, output moved out */
+static size_t
+cxx_fresh(const std::string &input, int iterations)
+{
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		scidown::Renderer renderer = scidown::Renderer::html();
+		scidown::Document document(renderer);
+		scidown::Buffer output = document.render(input);
+		total += output.size();
+	}
+
+	return total;
+}
+
+typedef size_t (*bench_run)(const std::string &, int);
+
+/* best: the fastest of BENCH_ROUNDS rounds of c and cxx, in seconds; their
+ * rounds alternate, so that both see the same machine load */
+static void
+best(bench_run c, bench_run cxx, const std::string &input, int iterations, double *time, size_t *total)
+{
+	bench_run runs[2] = {c, cxx};
+	int round, i;
+
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		for (i = 0; i < 2; i++) {
+			double t1 = now_s();
+			total[i] = runs[i](input, iterations);
+			double t2 = now_s();
+
+			if (!round || t2 - t1 < time[i])
+				time[i] = t2 - t1;
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	std::string input = argc > 1 ? load(argv[1]) : generate();
+	int iterations = argc > 2 ? atoi(argv[2]) : DEF_ITERATIONS;
+	double tolerance = (argc > 3 ? atof(argv[3]) : DEF_TOLERANCE_PCT) / 100;
+	size_t reused_total[2], fresh_total[2];
+	double reused[2], fresh[2];
+	double mb = (double)input.size() * iterations / (1 << 20);
+
+	best(c_reused, cxx_session, input, iterations, reused, reused_total);
+	best(c_fresh, cxx_fresh, input, iterations, fresh, fresh_total);
+
+	fprintf(stderr, "Input: %zu bytes, %d iterations.\n", input.size(), iterations);
+	fprintf(stderr, "C API, reused:     %7.3f s, %7.1f MB/s\n", reused[0], mb / reused[0]);
+	fprintf(stderr, "C++ Session:       %7.3f s, %7.1f MB/s (%+.1f%%)\n", reused[1], mb / reused[1],
+		(reused[1] / reused[0] - 1) * 100);
+	fprintf(stderr, "C API, fresh:      %7.3f s, %7.1f MB/s\n", fresh[0], mb / fresh[0]);
+	fprintf(stderr, "C++ fresh, moved:  %7.3f s, %7.1f MB/s (%+.1f%%)\n", fresh[1], mb / fresh[1],
+		(fresh[1] / fresh[0] - 1) * 100);
+
+	if (reused_total[0] != reused_total[1] || fresh_total[0] != fresh_total[1]) {
+		fprintf(stderr, "Output sizes differ: %zu/%zu, %zu/%zu.\n",
+			reused_total[0], reused_total[1], fresh_total[0], fresh_total[1]);
+		return 2;
+	}
+
+	return reused[1] > reused[0] * (1 + tolerance) || fresh[1] > fresh[0] * (1 + tolerance);
+}
@@ -0,0 +1,478 @@
+/* replay.c - replay a recorded editing session and measure preview latency
+ *
+ * Usage: bench_replay SESSION [MODE [P99_MS]]
+ *
+ * A session is a text file: lines starting with '#' are comments, then
+ *
+ *	start PATH		the starting document, relative to the session file
+ *	MS i OFFSET TEXT	insert TEXT at byte OFFSET, MS milliseconds into the session
+ *	MS d OFFSET LENGTH	delete LENGTH bytes at byte OFFSET
+ *
+ * where TEXT escapes newlines, tabs and backslashes as \n, \t and \\.
+ * After every operation the whole document is rendered to HTML, with
+ * md2html (MODE md2html), with a document and renderer kept across renders
+ * (MODE reuse) or both (MODE all, the default). @include paths resolve from
+ * the folder of the starting document.
+ *
+ * For each mode, the latency and allocation count (malloc, calloc and
+ * realloc calls, counted through the linker's --wrap) of the renders are
+ * reported as percentiles, with the number of renders that took longer
+ * than the pause before the next operation. The exit status is 1 when the
+ * 99th percentile of a mode exceeds P99_MS milliseconds.
+ */
+
+#include "document.h"
+#include "html.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#define DEF_OUNIT 64
+#define DEF_MAX_NESTING 16
+
+int md2html(const uint8_t* input_data, size_t input_size, uint8_t** output_data, size_t* output_size, int screen_height);
+
+enum replay_op {
+	REPLAY_INSERT,
+	REPLAY_DELETE
+};
+
+struct replay_edit {
+	long ms;
+	enum replay_op op;
+	size_t offset;
+	size_t length;
+	char *text;
+};
+
+struct replay_session {
+	char *start;
+	struct replay_edit *edits;
+	size_t count;
+	size_t asize;
+};
+
+/* replay_sample: latency and allocations of one render */
+struct replay_sample {
+	double ms;
+	size_t allocations;
+};
+
+static size_t allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+static double
+now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+/* SESSION */
+
+static char *
+unescape(const char *text, size_t *size)
+{
+	char *out = malloc(strlen(text) + 1);
+	size_t n = 0;
+
+	for (; *text; text++) {
+		if (*text == '\\' && text[1]) {
+			text++;
+			out[n++] = *text == 'n' ? '\n' : *text == 't' ? '\t' : *text;
+		} else {
+			out[n++] = *text;
+		}
+	}
+
+	out[n] = 0;
+	*size = n;
+	return out;
+}
+
+static int
+load_session(const char *path, struct replay_session *session)
+{
+	FILE *file = fopen(path, "r");
+	char *line = NULL, op;
+	size_t asize = 0, len;
+	ssize_t n;
+	int text;
+
+	if (!file) {
+		perror(path);
+		return -1;
+	}
+
+	memset(session, 0, sizeof(*session));
+	while ((n = getline(&line, &asize, file)) > 0) {
+		struct replay_edit edit;
+
+		if (line[n - 1] == '\n')
+			line[--n] = 0;
+		if (!n || line[0] == '#')
+			continue;
+
+		if (strncmp(line, "start ", 6) == 0) {
+			free(session->start);
+			session->start = strdup(line + 6);
+			continue;
+		}
+
+		memset(&edit, 0, sizeof(edit));
+		text = 0;
+		if (sscanf(line, "%ld %c %zu%n", &edit.ms, &op, &edit.offset, &text) < 3 || !text ||
+			(op != 'i' && op != 'd') || (line[text] != ' ' && line[text] != '\t')) {
+			fprintf(stderr, "%s: invalid line: %s\n", path, line);
+			continue;
+		}
+
+		/* one separator, the spaces after it are part of the text */
+		text++;
+
+		if (op == 'i') {
+			edit.op = REPLAY_INSERT;
+			edit.text = unescape(line + text, &len);
+			edit.length = len;
+		} else {
+			edit.op = REPLAY_DELETE;
+			edit.length = strtoul(line + text, NULL, 10);
+		}
+
+		if (session->count >= session->asize) {
+			session->asize = session->asize ? session->asize * 2 : 256;
+			session->edits = realloc(session->edits, session->asize * sizeof(struct replay_edit));
+		}
+		session->edits[session->count++] = edit;
+	}
+
+	free(line);
+	fclose(file);
+
+	if (!session->start) {
+		fprintf(stderr, "%s: no start document\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+free_session(struct replay_session *session)
+{
+	size_t i;
+
+	for (i = 0; i < session->count; ++i)
+		free(session->edits[i].text);
+	free(session->edits);
+	free(session->start);
+}
+
+/* apply: one edit to the document, out of range offsets are clamped;
+ * the document stays NUL-terminated, the parser reads past its end */
+static void
+apply(hoedown_buffer *doc, const struct replay_edit *edit)
+{
+	size_t offset = edit->offset < doc->size ? edit->offset : doc->size;
+	size_t length = edit->length;
+
+	if (edit->op == REPLAY_INSERT) {
+		hoedown_buffer_grow(doc, doc->size + length);
+		memmove(doc->data + offset + length, doc->data + offset, doc->size - offset);
+		memcpy(doc->data + offset, edit->text, length);
+		doc->size += length;
+	} else {
+		if (length > doc->size - offset)
+			length = doc->size - offset;
+		memmove(doc->data + offset, doc->data + offset + length, doc->size - offset - length);
+		doc->size -= length;
+	}
+
+	hoedown_buffer_cstr(doc);
+}
+
+
+/* RENDERERS */
+
+struct replay_renderer {
+	const char *name;
+	void *(*init)(void);
+	void (*render)(void *state, const hoedown_buffer *doc);
+	void (*free)(void *state);
+};
+
+static void *
+md2html_init(void)
+{
+	return NULL;
+}
+
+static void
+md2html_render(void *state, const hoedown_buffer *doc)
+{
+	uint8_t *output;
+	size_t size;
+
+	md2html(doc->data, doc->size, &output, &size, 0);
+	free(output);
+}
+
+static void
+md2html_free(void *state)
+{
+}
+
+struct reuse_state {
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	hoedown_buffer *ob;
+};
+
+static void *
+reuse_init(void)
+{
+	struct reuse_state *state = calloc(1, sizeof(struct reuse_state));
+	localization local = {"Figure", "Listing", "Table"};
+
+	state->renderer = hoedown_html_renderer_new(SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_CHARTER | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS, 0, local);
+	state->document = hoedown_document_new(state->renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, NULL, NULL, DEF_MAX_NESTING);
+	state->ob = hoedown_buffer_new(DEF_OUNIT);
+
+	return state;
+}
+
+static void
+reuse_render(void *opaque, const hoedown_buffer *doc)
+{
+	struct reuse_state *state = opaque;
+
+	state->ob->size = 0;
+	hoedown_html_renderer_reset(state->renderer);
+	hoedown_document_render(state->document, state->ob, doc->data, doc->size, -1);
+}
+
+static void
+reuse_free(void *opaque)
+{
+	struct reuse_state *state = opaque;
+
+	hoedown_buffer_free(state->ob);
+	hoedown_document_free(state->document);
+	hoedown_html_renderer_free(state->renderer);
+	free(state);
+}
+
+static const struct replay_renderer renderers[] = {
+	{"md2html", md2html_init, md2html_render, md2html_free},
+	{"reuse", reuse_init, reuse_render, reuse_free},
+};
+
+
+/* REPLAY */
+
+/* quiet: send stdout and stderr to /dev/null while rendering, md2html
+ * reports its time after every call; returns the descriptors to restore */
+static void
+quiet(int on, int saved[2])
+{
+	int null;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	if (on) {
+		null = open("/dev/null", O_WRONLY);
+		saved[0] = dup(1);
+		saved[1] = dup(2);
+		dup2(null, 1);
+		dup2(null, 2);
+		close(null);
+	} else {
+		dup2(saved[0], 1);
+		dup2(saved[1], 2);
+		close(saved[0]);
+		close(saved[1]);
+	}
+}
+
+static int
+cmp_ms(const void *a, const void *b)
+{
+	double x = ((const struct replay_sample *)a)->ms, y = ((const struct replay_sample *)b)->ms;
+	return (x > y) - (x < y);
+}
+
+static int
+cmp_allocations(const void *a, const void *b)
+{
+	size_t x = ((const struct replay_sample *)a)->allocations, y = ((const struct replay_sample *)b)->allocations;
+	return (x > y) - (x < y);
+}
+
+static size_t
+rank(size_t count, double percentile)
+{
+	size_t i = (size_t)(percentile / 100 * count);
+	return i < count ? i : count - 1;
+}
+
+/* replay: render the start document, then the document after every edit;
+ * returns the 99th percentile latency in milliseconds */
+static double
+replay(const struct replay_session *session, const uint8_t *start, size_t size, const struct replay_renderer *renderer)
+{
+	struct replay_sample *samples = calloc(session->count + 1, sizeof(struct replay_sample));
+	hoedown_buffer *doc = hoedown_buffer_new(1024);
+	size_t i, over = 0, before;
+	void *state;
+	int saved[2];
+	double t1, p99;
+
+	hoedown_buffer_put(doc, start, size);
+	hoedown_buffer_cstr(doc);
+
+	quiet(1, saved);
+	state = renderer->init();
+
+	/* the first render warms up the allocator and the file cache */
+	renderer->render(state, doc);
+
+	for (i = 0; i < session->count; ++i) {
+		apply(doc, &session->edits[i]);
+
+		before = allocations;
+		t1 = now_ms();
+		renderer->render(state, doc);
+		samples[i].ms = now_ms() - t1;
+		samples[i].allocations = allocations - before;
+
+		/* the render was still running when the next edit came */
+		if (i + 1 < session->count && samples[i].ms > session->edits[i + 1].ms - session->edits[i].ms)
+			over++;
+	}
+
+	renderer->free(state);
+	quiet(0, saved);
+
+	if (!session->count) {
+		free(samples);
+		hoedown_buffer_free(doc);
+		return 0;
+	}
+
+	qsort(samples, session->count, sizeof(struct replay_sample), cmp_ms);
+	p99 = samples[rank(session->count, 99)].ms;
+	printf("%-8s %8.3f %8.3f %8.3f %8.3f", renderer->name,
+		samples[rank(session->count, 50)].ms, samples[rank(session->count, 90)].ms,
+		p99, samples[session->count - 1].ms);
+
+	qsort(samples, session->count, sizeof(struct replay_sample), cmp_allocations);
+	printf(" %8zu %8zu %8zu %6zu\n",
+		samples[rank(session->count, 50)].allocations, samples[rank(session->count, 99)].allocations,
+		samples[session->count - 1].allocations, over);
+
+	free(samples);
+	hoedown_buffer_free(doc);
+	return p99;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *mode = argc > 2 ? argv[2] : "all";
+	double limit = argc > 3 ? atof(argv[3]) : 0;
+	struct replay_session session;
+	hoedown_buffer *start;
+	char *session_dir, *path, *start_dir;
+	FILE *file;
+	size_t i;
+	int ret = 0, found = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s SESSION [MODE [P99_MS]]\n", argv[0]);
+		return 1;
+	}
+
+	if (load_session(argv[1], &session))
+		return 5;
+
+	/* the start document is relative to the session, includes to the start document */
+	session_dir = strdup(argv[1]);
+	path = malloc(strlen(argv[1]) + strlen(session.start) + 2);
+	if (session.start[0] == '/')
+		strcpy(path, session.start);
+	else
+		sprintf(path, "%s/%s", dirname(session_dir), session.start);
+
+	file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		return 5;
+	}
+	start = hoedown_buffer_new(1024);
+	hoedown_buffer_putf(start, file);
+	fclose(file);
+
+	start_dir = strdup(path);
+	if (chdir(dirname(start_dir))) {
+		perror(path);
+		return 5;
+	}
+
+	printf("Session %s: %zu edits over %.1f s on %s (%zu bytes).\n", argv[1], session.count,
+		session.count ? session.edits[session.count - 1].ms / 1e3 : 0, path, start->size);
+	printf("%-8s %8s %8s %8s %8s %8s %8s %8s %6s\n", "mode", "p50 ms", "p90 ms", "p99 ms", "max ms",
+		"allocs50", "allocs99", "allocmax", "late");
+
+	for (i = 0; i < sizeof(renderers) / sizeof(renderers[0]); ++i) {
+		if (strcmp(mode, "all") && strcmp(mode, renderers[i].name))
+			continue;
+
+		found = 1;
+		if (replay(&session, start->data, start->size, &renderers[i]) > limit && limit > 0)
+			ret = 1;
+	}
+
+	if (!found)
+		fprintf(stderr, "Unknown mode %s.\n", mode);
+
+	hoedown_buffer_free(start);
+	free(start_dir);
+	free(path);
+	free(session_dir);
+	free_session(&session);
+
+	return found ? ret : 1;
+}
@@ -0,0 +1,131 @@
+/* worker.c - preview latency of the render worker against in-process rendering
+ *
+ * Usage: bench_worker [FILE [RUNS]]
+ *
+ * FILE (default examples/example_report.md) is rendered RUNS times (default
+ * 200) with md2html, then with md2html_worker_render, and the median and
+ * slowest render times of both are reported. The outputs must be equal.
+ * Last, a worker with a 1 ms timeout renders FILE repeated until it times
+ * out, and an empty render by the restarted worker is timed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEF_FILE "examples/example_report.md"
+#define DEF_RUNS 200
+
+typedef struct md2html_worker md2html_worker;
+
+int md2html(const uint8_t *input_data, size_t input_size, uint8_t **output_data, size_t *output_size, int screen_height);
+md2html_worker *md2html_worker_new(int timeout_ms);
+int md2html_worker_render(md2html_worker *worker, const uint8_t *input_data, size_t input_size, const uint8_t **output_data, size_t *output_size);
+void md2html_worker_free(md2html_worker *worker);
+
+static double
+now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+static FILE *figures;
+
+static void
+report(const char *name, double *times, int runs)
+{
+	qsort(times, runs, sizeof(double), cmp_double);
+	fprintf(figures, "%-10s median %8.3f ms  max %8.3f ms\n", name, times[runs / 2] * 1e3, times[runs - 1] * 1e3);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : DEF_FILE;
+	int runs = argc > 2 ? atoi(argv[2]) : DEF_RUNS;
+	double *times, t0;
+	uint8_t *source, *big, *output = NULL;
+	const uint8_t *mapped = NULL;
+	size_t size, output_size = 0, mapped_size = 0, i;
+	md2html_worker *worker;
+	FILE *file;
+	int r, ret;
+
+	if (runs < 1)
+		runs = 1;
+
+	file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Unable to open \"%s\".\n", path);
+		return 5;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	source = malloc(size ? size : 1);
+	size = fread(source, 1, size, file);
+	fclose(file);
+
+	/* md2html prints its render time, only the figures go to the original stderr */
+	figures = fdopen(dup(2), "w");
+	if (!figures || !freopen("/dev/null", "w", stderr))
+		return 5;
+
+	times = malloc(runs * sizeof(double));
+	worker = md2html_worker_new(0);
+	if (!worker)
+		return 5;
+
+	for (r = 0; r < runs; ++r) {
+		free(output);
+		t0 = now_s();
+		md2html(source, size, &output, &output_size, -1);
+		times[r] = now_s() - t0;
+	}
+	report("in-process", times, runs);
+
+	for (r = 0; r < runs; ++r) {
+		t0 = now_s();
+		md2html_worker_render(worker, source, size, &mapped, &mapped_size);
+		times[r] = now_s() - t0;
+	}
+	report("worker", times, runs);
+
+	if (mapped_size != output_size || memcmp(mapped, output, output_size)) {
+		fprintf(figures, "the worker output differs from md2html\n");
+		return 1;
+	}
+	md2html_worker_free(worker);
+
+	/* recovery: the stuck worker is killed and replaced */
+	big = malloc(size * 64);
+	for (i = 0; i < 64; ++i)
+		memcpy(big + i * size, source, size);
+
+	worker = md2html_worker_new(1);
+	ret = md2html_worker_render(worker, big, size * 64, &mapped, &mapped_size);
+	t0 = now_s();
+	r = md2html_worker_render(worker, source, 0, &mapped, &mapped_size);
+	fprintf(figures, "timed out with status %d, then an empty render took %.3f ms (status %d)\n",
+		ret, (now_s() - t0) * 1e3, r);
+	md2html_worker_free(worker);
+
+	free(big);
+	free(output);
+	free(times);
+	free(source);
+	fclose(figures);
+	return 0;
+}
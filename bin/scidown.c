@@ -1,17 +1,51 @@
 #include "document.h"
 #include "html.h"
 #include "latex.h"
+#include "text.h"
+#include "export.h"
 
 #include "common.h"
 #include "utils.h"
+#include <pthread.h>
 #include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <limits.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/memfd.h>
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
 
 /* FEATURES INFO / DEFAULTS */
 
 enum renderer_type {
 	RENDERER_HTML,
 	RENDERER_LATEX,
-	RENDERER_HTML_TOC
+	RENDERER_HTML_TOC,
+	RENDERER_TEXT
 };
 
 struct extension_category_info {
@@ -66,7 +100,9 @@ static struct html_flag_info html_flags_info[] = {
 	{SCIDOWN_RENDER_USE_XHTML, "xhtml", "Render XHTML."},
 	{SCIDOWN_RENDER_MERMAID, "mermaid", "Render mermaid diagrams."},
 	{SCIDOWN_RENDER_GNUPLOT, "gnuplot", "Render gnuplot plot."},
-	{SCIDOWN_RENDER_CSS, "style", "Set specified style-sheet."}
+	{SCIDOWN_RENDER_CSS, "style", "Set specified style-sheet."},
+	{SCIDOWN_RENDER_SANITIZE, "sanitize", "Keep only allow-listed tags and attributes of raw HTML."},
+	{SCIDOWN_RENDER_COMPACT, "compact", "Leave out the newlines between blocks and the dir=\"auto\" attributes."}
 };
 
 static const char *category_prefix = "all-";
@@ -75,6 +111,13 @@ static const char *negative_prefix = "no-";
 #define DEF_IUNIT 1024
 #define DEF_OUNIT 64
 #define DEF_MAX_NESTING 16
+#define DEF_MAP_WINDOW (1 << 20)
+#define DEF_HOLD_LIMIT (16 << 20)
+/* the installed style-sheets, meson passes the configured data directory */
+#ifndef DEF_STYLE_FOLDER
+#define DEF_STYLE_FOLDER "/usr/local/share/scidown/css"
+#endif
+#define DEF_WORKER_TIMEOUT 10000
 
 /* Get local info */
 localization get_local()
@@ -104,7 +147,7 @@ print_help(const char *basename)
 
 	/* main options */
 	printf("Main options:\n");
-	print_option('n', "max-nesting=N", "Maximum level of block nesting parsed. Default is " str(DEF_MAX_NESTING) ".");
+	print_option('n', "max-nesting=N", "Maximum level of inline nesting parsed, block containers nest freely. Default is " str(DEF_MAX_NESTING) ".");
 	print_option('t', "toc-level=N", "Maximum level for headers included in the TOC. Zero disables TOC (the default).");
 	print_option(  0, "html", "Render (X)HTML. The default.");
 	print_option(  0, "latex", "Render as LATEX.");
@@ -112,6 +155,11 @@ print_help(const char *basename)
 
 
 	print_option('T', "time", "Show time spent in rendering.");
+	print_option('p', "profile", "Overlay the parse and render time and output size of each top-level block on the HTML output, and report them as JSON.");
+	print_option('s', "stream", "Render the input as it is read, block by block, in memory bounded by the largest block. There is no TOC, and output after a forward reference is held until it is defined (up to 16 MiB).");
+	print_option('b', "batch", "Render each FILE to FILE.html on every core, reading and writing through io_uring when the kernel supports it.");
+	print_option(  0, "compress=FORMAT", "With --batch, write FILE.html.gz (gzip) or FILE.html.zst (zstd) instead, compressed on threads of their own while the next files are rendered.");
+	print_option('w', "watch", "Render each FILE to FILE.html again whenever it or a file it reads changes.");
 	print_option('i', "input-unit=N", "Reading block size. Default is " str(DEF_IUNIT) ".");
 	print_option('o', "output-unit=N", "Writing block size. Default is " str(DEF_OUNIT) ".");
 	print_option('h', "help", "Print this help text.");
@@ -148,6 +196,39 @@ print_help(const char *basename)
 }
 
 
+/* HTML EXTENSION */
+
+static void
+set_html_extension(ext_definition *ext)
+{
+	ext->extra_header =
+                "<link rel=\"stylesheet\" href=\"qrc:/web_res/ajax/libs/KaTeX/0.11.1/katex.min.css\" crossorigin=\"anonymous\">"
+                "<link rel=\"stylesheet\" href=\"qrc:/web_res/ajax/libs/highlight.js/9.18.1/styles/xcode.min.css\">"
+                "<link rel=\"stylesheet\" href=\"qrc:/web_res/ajax/libs/github-markdown-css/4.0.0/github-markdown.min.css\">"
+                "<script src=\"qrc:/web_res/ajax/libs/KaTeX/0.11.1/katex.min.js\" crossorigin=\"anonymous\"></script>\n"
+                "<script src=\"qrc:/web_res/ajax/libs/KaTeX/0.11.1/contrib/auto-render.min.js\" crossorigin=\"anonymous\"></script>\n"
+                "<script src=\"qrc:/web_res/ajax/libs/highlight.js/9.18.1/highlight.min.js\"></script>"
+                "<script src=\"qrc:/web_res/npm/mermaid@8.4.0/dist/mermaid.min.js\"></script>"
+                "<script src=\"qrc:///qtwebchannel/qwebchannel.js\"></script>"
+							;
+    ext->extra_closing = "<style>@font-face {\n"
+                            "    font-family: 'HiraginoSans';\n"
+                            "    src: url('qrc:/web_res/Hiragino-Sans-GB-W3.ttf');\n"
+                            "    font-weight: 300;\n"
+                            "    font-style: normal;\n"
+                            "  }"
+                            "body {"
+                            "   font-family: 'HiraginoSans';"
+                            "   background: #FFF;"
+                            "}"
+                            " </style>"
+                            "<script>renderMathInElement(document.body); hljs.initHighlightingOnLoad(); mermaid.initialize({startOnLoad:true});    "
+                            "var channel = new QWebChannel(qt.webChannelTransport, function (channel) {\n"
+                            "console.log(\" web channel ok\");"
+                            "    });</script>\n";
+}
+
+
 /* OPTION PARSING */
 
 struct option_data {
@@ -198,39 +279,16 @@ int md2html(const uint8_t* input_data, size_t input_size, uint8_t** output_data,
 		renderer = hoedown_html_toc_renderer_new(data.toc_level, get_local());
 	else if (data.renderer == RENDERER_LATEX)
 		renderer = scidown_latex_renderer_new(data.render_flags, data.toc_level, get_local());
-	renderer_free = hoedown_html_renderer_free;
+	else if (data.renderer == RENDERER_TEXT)
+		renderer = scidown_text_renderer_new(data.render_flags);
+	renderer_free = (data.renderer == RENDERER_TEXT) ? scidown_text_renderer_free : hoedown_html_renderer_free;
 
 	/* Perform Markdown rendering */
 	ob = hoedown_buffer_new(data.ounit);
 
 	ext_definition ext = {NULL, NULL};
-	if (data.renderer == RENDERER_HTML) {
-		ext.extra_header =
-                "<link rel=\"stylesheet\" href=\"qrc:/web_res/ajax/libs/KaTeX/0.11.1/katex.min.css\" crossorigin=\"anonymous\">"
-                "<link rel=\"stylesheet\" href=\"qrc:/web_res/ajax/libs/highlight.js/9.18.1/styles/xcode.min.css\">"
-                "<link rel=\"stylesheet\" href=\"qrc:/web_res/ajax/libs/github-markdown-css/4.0.0/github-markdown.min.css\">"
-                "<script src=\"qrc:/web_res/ajax/libs/KaTeX/0.11.1/katex.min.js\" crossorigin=\"anonymous\"></script>\n"
-                "<script src=\"qrc:/web_res/ajax/libs/KaTeX/0.11.1/contrib/auto-render.min.js\" crossorigin=\"anonymous\"></script>\n"
-                "<script src=\"qrc:/web_res/ajax/libs/highlight.js/9.18.1/highlight.min.js\"></script>"
-                "<script src=\"qrc:/web_res/npm/mermaid@8.4.0/dist/mermaid.min.js\"></script>"
-                "<script src=\"qrc:///qtwebchannel/qwebchannel.js\"></script>"
-							;
-        ext.extra_closing = "<style>@font-face {\n"
-                            "    font-family: 'HiraginoSans';\n"
-                            "    src: url('qrc:/web_res/Hiragino-Sans-GB-W3.ttf');\n"
-                            "    font-weight: 300;\n"
-                            "    font-style: normal;\n"
-                            "  }"
-                            "body {"
-                            "   font-family: 'HiraginoSans';"
-                            "   background: #FFF;"
-                            "}"
-                            " </style>"
-                            "<script>renderMathInElement(document.body); hljs.initHighlightingOnLoad(); mermaid.initialize({startOnLoad:true});    "
-                            "var channel = new QWebChannel(qt.webChannelTransport, function (channel) {\n"
-                            "console.log(\" web channel ok\");"
-                            "    });</script>\n";
-	}
+	if (data.renderer == RENDERER_HTML)
+		set_html_extension(&ext);
 	document = hoedown_document_new(renderer, data.extensions, &ext, NULL, data.max_nesting);
 
 	t1 = clock();
@@ -266,3 +324,1803 @@ int md2html(const uint8_t* input_data, size_t input_size, uint8_t** output_data,
 
 	return 0;
 }
+
+
+/* PROFILE MODE */
+
+/* copy_out: a malloc'd copy of the buffer contents */
+static uint8_t *
+copy_out(const hoedown_buffer *ob, size_t *size)
+{
+	uint8_t *copy = malloc(ob->size ? ob->size : 1);
+
+	memcpy(copy, ob->data, ob->size);
+	*size = ob->size;
+	return copy;
+}
+
+/* md2html_profile: like md2html, with an overlay listing the costliest
+ * top-level blocks at the end of the body; the cost of every block is
+ * also returned as JSON in profile_data */
+int md2html_profile(const uint8_t *input_data, size_t input_size, uint8_t **output_data, size_t *output_size, uint8_t **profile_data, size_t *profile_size)
+{
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	hoedown_profile *profile;
+	hoedown_buffer *ob, *overlay, *json;
+	ext_definition ext = {NULL, NULL};
+	size_t body;
+
+	renderer = hoedown_html_renderer_new(SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_CHARTER | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS, 0, get_local());
+	set_html_extension(&ext);
+	document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, &ext, NULL, DEF_MAX_NESTING);
+	profile = hoedown_profile_new();
+	hoedown_document_set_profile(document, profile);
+
+	ob = hoedown_buffer_new(DEF_OUNIT);
+	hoedown_document_render(document, ob, input_data, input_size, -1);
+
+	overlay = hoedown_buffer_new(DEF_OUNIT);
+	hoedown_profile_write_html(profile, overlay, 20);
+	json = hoedown_buffer_new(DEF_OUNIT);
+	hoedown_profile_write_json(profile, json);
+
+	/* the overlay goes before the last </body>, or at the end */
+	for (body = ob->size; body >= 7; body--)
+		if (memcmp(ob->data + body - 7, "</body>", 7) == 0)
+			break;
+	body = body >= 7 ? body - 7 : ob->size;
+
+	*output_size = ob->size + overlay->size;
+	*output_data = malloc(*output_size ? *output_size : 1);
+	memcpy(*output_data, ob->data, body);
+	memcpy(*output_data + body, overlay->data, overlay->size);
+	memcpy(*output_data + body + overlay->size, ob->data + body, ob->size - body);
+	*profile_data = copy_out(json, profile_size);
+
+	hoedown_buffer_free(json);
+	hoedown_buffer_free(overlay);
+	hoedown_buffer_free(ob);
+	hoedown_document_free(document);
+	hoedown_profile_free(profile);
+	hoedown_html_renderer_free(renderer);
+
+	return 0;
+}
+
+
+/* EXPORT MODE */
+
+/* assets stay encoded across exports until their file changes */
+static scidown_asset_cache *export_cache;
+static pthread_mutex_t export_lock = PTHREAD_MUTEX_INITIALIZER;
+static char export_styles[4096];
+
+static void
+export_cache_free(void)
+{
+	scidown_asset_cache_free(export_cache);
+	export_cache = NULL;
+}
+
+/* export_style_folder: resources/css next to the executable or one level up
+ * (a build directory in the source tree), else the installed style-sheets;
+ * never relative to the working directory */
+static const char *
+export_style_folder(void)
+{
+	static const char *candidates[] = {"/resources/css", "/../resources/css"};
+	char exe[sizeof(export_styles) - 32], *slash;
+	struct stat st;
+	ssize_t n;
+	size_t i;
+
+	if (export_styles[0])
+		return export_styles;
+
+	strcpy(export_styles, DEF_STYLE_FOLDER);
+#ifdef __linux__
+	n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (n <= 0)
+		return export_styles;
+	exe[n] = 0;
+	slash = strrchr(exe, '/');
+	if (!slash)
+		return export_styles;
+	*slash = 0;
+
+	for (i = 0; i < count_of(candidates); ++i) {
+		snprintf(export_styles, sizeof(export_styles), "%s%s", exe, candidates[i]);
+		if (stat(export_styles, &st) == 0 && S_ISDIR(st.st_mode))
+			return export_styles;
+	}
+	strcpy(export_styles, DEF_STYLE_FOLDER);
+#endif
+	return export_styles;
+}
+
+/* md2html_export: render a single self-contained HTML file, with the
+ * style-sheet (from base_folder or export_style_folder) and the local images of
+ * the document inlined; the qrc: resources of the viewer are left out since
+ * they only resolve inside it */
+int md2html_export(const uint8_t *input_data, size_t input_size, const char *base_folder, uint8_t **output_data, size_t *output_size)
+{
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	hoedown_buffer *ob, *exported;
+	ext_definition ext = {NULL, NULL};
+
+	renderer = hoedown_html_renderer_new(SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_CHARTER | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS, 0, get_local());
+	document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, &ext, base_folder, DEF_MAX_NESTING);
+
+	ob = hoedown_buffer_new(DEF_OUNIT);
+	hoedown_document_render(document, ob, input_data, input_size, -1);
+
+	exported = hoedown_buffer_new(DEF_OUNIT);
+	pthread_mutex_lock(&export_lock);
+	if (!export_cache) {
+		export_cache = scidown_asset_cache_new();
+		atexit(export_cache_free);
+	}
+	scidown_html_export(exported, ob->data, ob->size, export_cache, base_folder, export_style_folder());
+	pthread_mutex_unlock(&export_lock);
+
+	*output_data = copy_out(exported, output_size);
+
+	hoedown_buffer_free(exported);
+	hoedown_buffer_free(ob);
+	hoedown_document_free(document);
+	hoedown_html_renderer_free(renderer);
+
+	return 0;
+}
+
+
+/* STREAM MODE */
+
+static hoedown_document *
+stream_document_new(hoedown_renderer **renderer, ext_definition *ext)
+{
+	hoedown_document *document;
+
+	*renderer = hoedown_html_renderer_new(SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_CHARTER | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS, 0, get_local());
+	set_html_extension(ext);
+	document = hoedown_document_new(*renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, ext, NULL, DEF_MAX_NESTING);
+	hoedown_document_set_stream_limit(document, DEF_HOLD_LIMIT);
+
+	return document;
+}
+
+static void
+stream_write(hoedown_buffer *ob, FILE *output)
+{
+	if (!ob->size)
+		return;
+
+	fwrite(ob->data, 1, ob->size, output);
+	fflush(output);
+	ob->size = 0;
+}
+
+int md2html_stream(FILE *input, FILE *output)
+{
+	uint8_t *chunk;
+	size_t size;
+	hoedown_buffer *ob;
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	ext_definition ext = {NULL, NULL};
+	int ret = 0;
+
+	document = stream_document_new(&renderer, &ext);
+	chunk = malloc(DEF_IUNIT);
+	ob = hoedown_buffer_new(DEF_OUNIT);
+
+	hoedown_document_stream_begin(document);
+	while ((size = fread(chunk, 1, DEF_IUNIT, input)) > 0) {
+		hoedown_document_stream_feed(document, ob, chunk, size);
+		stream_write(ob, output);
+	}
+	if (ferror(input)) {
+		fprintf(stderr, "I/O errors found while reading input.\n");
+		ret = 5;
+	}
+	hoedown_document_stream_end(document, ob);
+	stream_write(ob, output);
+
+	free(chunk);
+	hoedown_buffer_free(ob);
+	hoedown_document_free(document);
+	hoedown_html_renderer_free(renderer);
+
+	return ret;
+}
+
+/* md2html_mapped: stream a file through a read-only mapping, dropping each
+ * window from memory once it is rendered; peak memory stays around the
+ * largest block plus the reference tables, whatever the file size */
+int md2html_mapped(const char *input, FILE *output)
+{
+#ifdef __linux__
+	int fd;
+	struct stat st;
+	uint8_t *map;
+	size_t size, offset, n;
+	hoedown_buffer *ob;
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	ext_definition ext = {NULL, NULL};
+
+	fd = open(input, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to open input file \"%s\": %s\n", input, strerror(errno));
+		return 5;
+	}
+
+	if (fstat(fd, &st) || st.st_size == 0 ||
+	    (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		FILE *file = fdopen(fd, "rb");
+		int ret = md2html_stream(file, output);
+		fclose(file);
+		return ret;
+	}
+	size = st.st_size;
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	document = stream_document_new(&renderer, &ext);
+	ob = hoedown_buffer_new(DEF_OUNIT);
+
+	hoedown_document_stream_begin(document);
+	for (offset = 0; offset < size; offset += n) {
+		n = size - offset < DEF_MAP_WINDOW ? size - offset : DEF_MAP_WINDOW;
+		hoedown_document_stream_feed(document, ob, map + offset, n);
+		stream_write(ob, output);
+
+		/* the document keeps a copy of an unfinished block */
+		madvise(map + offset, n, MADV_DONTNEED);
+	}
+	hoedown_document_stream_end(document, ob);
+	stream_write(ob, output);
+
+	hoedown_buffer_free(ob);
+	hoedown_document_free(document);
+	hoedown_html_renderer_free(renderer);
+	munmap(map, size);
+	close(fd);
+
+	return 0;
+#else
+	FILE *file = fopen(input, "rb");
+	int ret;
+
+	if (!file) {
+		fprintf(stderr, "Unable to open input file \"%s\": %s\n", input, strerror(errno));
+		return 5;
+	}
+	ret = md2html_stream(file, output);
+	fclose(file);
+	return ret;
+#endif
+}
+
+
+/* WATCH MODE */
+
+#ifdef __linux__
+
+#define WATCH_DEBOUNCE_MS 100
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM)
+
+struct watch_document {
+	char *input;
+	char *output;
+	char *base_folder;
+
+	/* every file the last render looked for, normalized */
+	char **deps;
+	size_t deps_count;
+	size_t deps_asize;
+};
+
+struct watch_dir {
+	int wd;
+	char *path;
+};
+
+struct watch_state {
+	int fd;
+
+	struct watch_document *docs;
+	size_t docs_count;
+
+	struct watch_dir *dirs;
+	size_t dirs_count;
+	size_t dirs_asize;
+};
+
+static double
+watch_now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* watch_normalize: absolute path with a resolved directory, the file itself may not exist */
+static char *
+watch_normalize(const char *path)
+{
+	char dir[PATH_MAX], resolved[PATH_MAX];
+	const char *base = strrchr(path, '/');
+	char *result;
+	size_t n;
+
+	if (base) {
+		n = base - path;
+		if (n == 0) n = 1;
+		if (n >= sizeof(dir)) return strdup(path);
+		memcpy(dir, path, n);
+		dir[n] = 0;
+		base++;
+	} else {
+		strcpy(dir, ".");
+		base = path;
+	}
+
+	if (!realpath(dir, resolved))
+		return strdup(path);
+
+	n = strlen(resolved);
+	result = malloc(n + strlen(base) + 2);
+	memcpy(result, resolved, n);
+	result[n] = '/';
+	strcpy(result + n + 1, base);
+	return result;
+}
+
+static void
+watch_add_dir(struct watch_state *state, const char *path)
+{
+	char *dir = strdup(path);
+	char *slash = strrchr(dir, '/');
+	size_t i;
+	int wd;
+
+	if (slash == dir) slash[1] = 0;
+	else if (slash) *slash = 0;
+
+	for (i = 0; i < state->dirs_count; ++i) {
+		if (strcmp(state->dirs[i].path, dir) == 0) {
+			free(dir);
+			return;
+		}
+	}
+
+	wd = inotify_add_watch(state->fd, dir, WATCH_EVENTS);
+	if (wd < 0) {
+		fprintf(stderr, "Unable to watch %s\n", dir);
+		free(dir);
+		return;
+	}
+
+	if (state->dirs_count >= state->dirs_asize) {
+		state->dirs_asize = state->dirs_asize ? state->dirs_asize * 2 : 8;
+		state->dirs = realloc(state->dirs, state->dirs_asize * sizeof(struct watch_dir));
+	}
+
+	state->dirs[state->dirs_count].wd = wd;
+	state->dirs[state->dirs_count].path = dir;
+	state->dirs_count++;
+}
+
+static void
+watch_dependency(const char *path, void *opaque)
+{
+	struct watch_document *doc = opaque;
+	char *normalized = watch_normalize(path);
+	size_t i;
+
+	for (i = 0; i < doc->deps_count; ++i) {
+		if (strcmp(doc->deps[i], normalized) == 0) {
+			free(normalized);
+			return;
+		}
+	}
+
+	if (doc->deps_count >= doc->deps_asize) {
+		doc->deps_asize = doc->deps_asize ? doc->deps_asize * 2 : 8;
+		doc->deps = realloc(doc->deps, doc->deps_asize * sizeof(char *));
+	}
+
+	doc->deps[doc->deps_count++] = normalized;
+}
+
+static void
+watch_clear_deps(struct watch_document *doc)
+{
+	size_t i;
+
+	for (i = 0; i < doc->deps_count; ++i)
+		free(doc->deps[i]);
+	doc->deps_count = 0;
+}
+
+static int
+watch_render(struct watch_state *state, struct watch_document *doc)
+{
+	hoedown_buffer *ib, *ob;
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	ext_definition ext = {NULL, NULL};
+	size_t i;
+	FILE *file;
+
+	file = fopen(doc->input, "rb");
+	if (!file) {
+		fprintf(stderr, "Unable to open input file \"%s\": %s\n", doc->input, strerror(errno));
+		return 5;
+	}
+
+	ib = hoedown_buffer_new(DEF_IUNIT);
+	if (hoedown_buffer_putf(ib, file)) {
+		fprintf(stderr, "I/O errors found while reading input.\n");
+		fclose(file);
+		hoedown_buffer_free(ib);
+		return 5;
+	}
+	fclose(file);
+
+	renderer = hoedown_html_renderer_new(SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_CHARTER | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS, 0, get_local());
+	set_html_extension(&ext);
+	document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, &ext, doc->base_folder, DEF_MAX_NESTING);
+
+	watch_clear_deps(doc);
+	hoedown_document_set_dependency(document, watch_dependency, doc);
+
+	ob = hoedown_buffer_new(DEF_OUNIT);
+	hoedown_document_render(document, ob, ib->data, ib->size, -1);
+
+	hoedown_buffer_free(ib);
+	hoedown_document_free(document);
+	hoedown_html_renderer_free(renderer);
+
+	file = fopen(doc->output, "wb");
+	if (!file) {
+		fprintf(stderr, "Unable to open output file \"%s\": %s\n", doc->output, strerror(errno));
+		hoedown_buffer_free(ob);
+		return 5;
+	}
+	fwrite(ob->data, 1, ob->size, file);
+	fclose(file);
+	hoedown_buffer_free(ob);
+
+	/* includes may have moved to other directories */
+	watch_add_dir(state, doc->input);
+	for (i = 0; i < doc->deps_count; ++i)
+		watch_add_dir(state, doc->deps[i]);
+
+	return 0;
+}
+
+/* watch_affects: whether a changed file is the input of a document or was read by its last render */
+static int
+watch_affects(const struct watch_document *doc, const char *path)
+{
+	size_t i;
+
+	if (strcmp(doc->input, path) == 0)
+		return 1;
+
+	for (i = 0; i < doc->deps_count; ++i)
+		if (strcmp(doc->deps[i], path) == 0)
+			return 1;
+
+	return 0;
+}
+
+/* watch_read: collect the changed files of the pending events into dirty */
+static void
+watch_read(struct watch_state *state, int *dirty)
+{
+	char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	char *path;
+	ssize_t len;
+	size_t i, n;
+	char *p;
+
+	len = read(state->fd, events, sizeof(events));
+	if (len <= 0)
+		return;
+
+	for (p = events; p < events + len; p += sizeof(struct inotify_event) + event->len) {
+		event = (const struct inotify_event *)p;
+		if (!event->len)
+			continue;
+
+		for (i = 0; i < state->dirs_count; ++i)
+			if (state->dirs[i].wd == event->wd)
+				break;
+		if (i == state->dirs_count)
+			continue;
+
+		n = strlen(state->dirs[i].path);
+		path = malloc(n + strlen(event->name) + 2);
+		strcpy(path, state->dirs[i].path);
+		if (n == 0 || path[n - 1] != '/')
+			path[n++] = '/';
+		strcpy(path + n, event->name);
+
+		for (i = 0; i < state->docs_count; ++i)
+			if (watch_affects(&state->docs[i], path))
+				dirty[i] = 1;
+
+		free(path);
+	}
+}
+
+/* md2html_watch: render each input to <input>.html, then render again the
+ * documents affected by every change of their input, includes or
+ * bibliographies, waiting WATCH_DEBOUNCE_MS for the changes to settle;
+ * runs until interrupted, returns 5 on I/O errors */
+int
+md2html_watch(char **inputs, int count)
+{
+	struct watch_state state;
+	struct pollfd pfd;
+	int *dirty;
+	double changed, t1, t2;
+	int i;
+	size_t n;
+
+	memset(&state, 0, sizeof(state));
+	state.fd = inotify_init1(IN_CLOEXEC);
+	if (state.fd < 0) {
+		fprintf(stderr, "Unable to initialize inotify: %s\n", strerror(errno));
+		return 5;
+	}
+
+	state.docs = calloc(count, sizeof(struct watch_document));
+	state.docs_count = count;
+	dirty = calloc(count, sizeof(int));
+
+	for (i = 0; i < count; ++i) {
+		struct watch_document *doc = &state.docs[i];
+		char *slash;
+
+		doc->input = watch_normalize(inputs[i]);
+		n = strlen(doc->input);
+		doc->output = malloc(n + 6);
+		memcpy(doc->output, doc->input, n);
+		if (n > 3 && strcmp(doc->input + n - 3, ".md") == 0)
+			n -= 3;
+		strcpy(doc->output + n, ".html");
+
+		doc->base_folder = strdup(doc->input);
+		slash = strrchr(doc->base_folder, '/');
+		if (slash) *slash = 0;
+
+		watch_render(&state, doc);
+	}
+
+	pfd.fd = state.fd;
+	pfd.events = POLLIN;
+
+	while (poll(&pfd, 1, -1) > 0) {
+		changed = watch_now_ms();
+		watch_read(&state, dirty);
+
+		/* debounce: editors write files in several steps */
+		while (poll(&pfd, 1, WATCH_DEBOUNCE_MS) > 0)
+			watch_read(&state, dirty);
+
+		for (i = 0; i < count; ++i) {
+			if (!dirty[i])
+				continue;
+
+			dirty[i] = 0;
+
+			t1 = watch_now_ms();
+			if (watch_render(&state, &state.docs[i]) == 0) {
+				t2 = watch_now_ms();
+				fprintf(stderr, "Rendered %s in %.2f ms, %.2f ms after the change.\n",
+					state.docs[i].output, t2 - t1, t2 - changed);
+			}
+		}
+	}
+
+	for (i = 0; i < count; ++i) {
+		watch_clear_deps(&state.docs[i]);
+		free(state.docs[i].deps);
+		free(state.docs[i].input);
+		free(state.docs[i].output);
+		free(state.docs[i].base_folder);
+	}
+	for (n = 0; n < state.dirs_count; ++n)
+		free(state.dirs[n].path);
+	free(state.dirs);
+	free(state.docs);
+	free(dirty);
+	close(state.fd);
+
+	return 0;
+}
+
+#endif
+
+
+/* BATCH MODE */
+
+#define BATCH_QUEUE_DEPTH 64
+#define BATCH_READ_UNIT (64 * 1024)
+
+enum batch_state {
+	BATCH_LOAD,	/* the worker reads and writes the files itself */
+	BATCH_OPEN,
+	BATCH_READ,
+	BATCH_RENDER,
+	BATCH_CREATE,
+	BATCH_WRITE,
+	BATCH_FAILED	/* handed back by the stage, not written */
+};
+
+enum batch_compression {
+	BATCH_PLAIN,
+	BATCH_GZIP,
+	BATCH_ZSTD
+};
+
+struct batch_job {
+	char *input;
+	char *output;
+	char *base_folder;
+
+	enum batch_state state;
+	int fd;
+	hoedown_buffer *data;	/* the source, then the rendered output */
+	size_t written;
+	int slot;		/* in the jobs of the I/O loop */
+
+	struct batch_job *next;
+};
+
+struct batch_queue {
+	struct batch_job *head;
+	struct batch_job *tail;
+};
+
+struct batch_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	struct batch_queue todo;
+	struct batch_queue done;
+	int quit;
+	int errors;
+
+	/* eventfd signalled for every rendered job, -1 when workers write outputs themselves */
+	int notify;
+
+	/* compression of the rendered jobs, NULL for plain outputs */
+	struct batch_stage *stage;
+};
+
+/* batch_stage: compresses rendered jobs on threads of its own, so that the
+ * workers go on with the next document meanwhile; compressed jobs are
+ * written by the stage, or handed to the I/O loop through the pool */
+struct batch_stage {
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	struct batch_queue todo;
+	int quit;
+
+	enum batch_compression compression;
+	struct batch_pool *pool;
+};
+
+static void
+batch_push(struct batch_queue *queue, struct batch_job *job)
+{
+	job->next = NULL;
+	if (queue->tail)
+		queue->tail->next = job;
+	else
+		queue->head = job;
+	queue->tail = job;
+}
+
+static struct batch_job *
+batch_pop(struct batch_queue *queue)
+{
+	struct batch_job *job = queue->head;
+
+	if (job) {
+		queue->head = job->next;
+		if (!queue->head)
+			queue->tail = NULL;
+	}
+	return job;
+}
+
+static struct batch_job *
+batch_job_new(const char *input, enum batch_state state, enum batch_compression compression)
+{
+	struct batch_job *job = calloc(1, sizeof(struct batch_job));
+	size_t n = strlen(input);
+	char *slash;
+
+	job->input = strdup(input);
+	job->output = malloc(n + 10);
+	memcpy(job->output, input, n);
+	if (n > 3 && strcmp(input + n - 3, ".md") == 0)
+		n -= 3;
+	strcpy(job->output + n, compression == BATCH_GZIP ? ".html.gz" : compression == BATCH_ZSTD ? ".html.zst" : ".html");
+
+	job->base_folder = strdup(input);
+	slash = strrchr(job->base_folder, '/');
+	if (slash)
+		*slash = 0;
+	else {
+		free(job->base_folder);
+		job->base_folder = NULL;
+	}
+
+	job->state = state;
+	job->fd = -1;
+	job->data = hoedown_buffer_new(DEF_IUNIT);
+	return job;
+}
+
+static void
+batch_job_free(struct batch_job *job)
+{
+	hoedown_buffer_free(job->data);
+	free(job->input);
+	free(job->output);
+	free(job->base_folder);
+	free(job);
+}
+
+/* batch_render: replace the source of a job with its HTML */
+static void
+batch_render(struct batch_job *job)
+{
+	hoedown_buffer *ob;
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	ext_definition ext = {NULL, NULL};
+
+	renderer = hoedown_html_renderer_new(SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_CHARTER | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS, 0, get_local());
+	set_html_extension(&ext);
+	document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, &ext, job->base_folder, DEF_MAX_NESTING);
+
+	ob = hoedown_buffer_new(DEF_OUNIT);
+	hoedown_document_render(document, ob, job->data->data, job->data->size, -1);
+
+	hoedown_document_free(document);
+	hoedown_html_renderer_free(renderer);
+
+	hoedown_buffer_free(job->data);
+	job->data = ob;
+}
+
+/* batch_load: read and render a job in the worker */
+static int
+batch_load(struct batch_job *job)
+{
+	FILE *file = fopen(job->input, "rb");
+
+	if (!file) {
+		fprintf(stderr, "Unable to open input file \"%s\": %s\n", job->input, strerror(errno));
+		return 5;
+	}
+	if (hoedown_buffer_putf(job->data, file)) {
+		fprintf(stderr, "I/O errors found while reading \"%s\".\n", job->input);
+		fclose(file);
+		return 5;
+	}
+	fclose(file);
+
+	batch_render(job);
+	return 0;
+}
+
+/* batch_write: the write path, the output in a single write */
+static int
+batch_write(struct batch_job *job)
+{
+	FILE *file = fopen(job->output, "wb");
+
+	if (!file) {
+		fprintf(stderr, "Unable to open output file \"%s\": %s\n", job->output, strerror(errno));
+		return 5;
+	}
+	fwrite(job->data->data, 1, job->data->size, file);
+	fclose(file);
+	return 0;
+}
+
+/* batch_finish: hand a rendered job to the I/O loop */
+static void
+batch_finish(struct batch_pool *pool, struct batch_job *job)
+{
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&pool->lock);
+	batch_push(&pool->done, job);
+	pthread_mutex_unlock(&pool->lock);
+
+	if (write(pool->notify, &one, sizeof(one)) < 0)
+		fprintf(stderr, "Unable to wake up the I/O loop: %s\n", strerror(errno));
+}
+
+/* batch_compress: replace the output of a job with its compressed form */
+static int
+batch_compress(struct batch_job *job, enum batch_compression compression)
+{
+	hoedown_buffer *packed = hoedown_buffer_new(DEF_OUNIT);
+	int ret = 5;
+
+#ifdef HAVE_ZLIB
+	if (compression == BATCH_GZIP) {
+		z_stream stream;
+
+		memset(&stream, 0, sizeof(stream));
+		/* 16 over the window bits asks for a gzip header */
+		if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+			hoedown_buffer_grow(packed, deflateBound(&stream, job->data->size));
+			stream.next_in = job->data->data;
+			stream.avail_in = job->data->size;
+			stream.next_out = packed->data;
+			stream.avail_out = packed->asize;
+			if (deflate(&stream, Z_FINISH) == Z_STREAM_END) {
+				packed->size = stream.total_out;
+				ret = 0;
+			}
+			deflateEnd(&stream);
+		}
+	}
+#endif
+
+#ifdef HAVE_ZSTD
+	if (compression == BATCH_ZSTD) {
+		size_t size;
+
+		hoedown_buffer_grow(packed, ZSTD_compressBound(job->data->size));
+		size = ZSTD_compress(packed->data, packed->asize, job->data->data, job->data->size, 3);
+		if (!ZSTD_isError(size)) {
+			packed->size = size;
+			ret = 0;
+		}
+	}
+#endif
+
+	if (ret) {
+		fprintf(stderr, "Unable to compress \"%s\".\n", job->output);
+		hoedown_buffer_free(packed);
+		return ret;
+	}
+
+	hoedown_buffer_free(job->data);
+	job->data = packed;
+	return 0;
+}
+
+static void
+batch_stage_push(struct batch_stage *stage, struct batch_job *job)
+{
+	pthread_mutex_lock(&stage->lock);
+	batch_push(&stage->todo, job);
+	pthread_cond_signal(&stage->ready);
+	pthread_mutex_unlock(&stage->lock);
+}
+
+static void *
+batch_compressor(void *opaque)
+{
+	struct batch_stage *stage = opaque;
+	struct batch_pool *pool = stage->pool;
+	struct batch_job *job;
+	int ret;
+
+	pthread_mutex_lock(&stage->lock);
+	while (1) {
+		while (!stage->todo.head && !stage->quit)
+			pthread_cond_wait(&stage->ready, &stage->lock);
+
+		job = batch_pop(&stage->todo);
+		if (!job)
+			break;
+		pthread_mutex_unlock(&stage->lock);
+
+		ret = batch_compress(job, stage->compression);
+
+		/* a job the I/O loop is waiting for goes back to it, marked
+		 * when it could not be compressed */
+		if (pool->notify >= 0) {
+			if (ret)
+				job->state = BATCH_FAILED;
+			batch_finish(pool, job);
+		} else {
+			if (!ret)
+				ret = batch_write(job);
+			batch_job_free(job);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		pool->errors += ret != 0;
+		pthread_mutex_unlock(&pool->lock);
+
+		pthread_mutex_lock(&stage->lock);
+	}
+	pthread_mutex_unlock(&stage->lock);
+
+	return NULL;
+}
+
+static void *
+batch_worker(void *opaque)
+{
+	struct batch_pool *pool = opaque;
+	struct batch_job *job;
+	int ret;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1) {
+		while (!pool->todo.head && !pool->quit)
+			pthread_cond_wait(&pool->ready, &pool->lock);
+
+		job = batch_pop(&pool->todo);
+		if (!job)
+			break;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (job->state == BATCH_LOAD) {
+			ret = batch_load(job);
+			if (!ret && pool->stage) {
+				batch_stage_push(pool->stage, job);
+				pthread_mutex_lock(&pool->lock);
+				continue;
+			}
+
+			if (!ret)
+				ret = batch_write(job);
+			batch_job_free(job);
+
+			pthread_mutex_lock(&pool->lock);
+			pool->errors += ret != 0;
+			continue;
+		}
+
+		batch_render(job);
+
+		if (pool->stage)
+			batch_stage_push(pool->stage, job);
+		else
+			batch_finish(pool, job);
+
+		pthread_mutex_lock(&pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+#ifdef HAVE_IO_URING
+
+struct batch_ring {
+	int fd;
+	unsigned entries;
+	unsigned tail;
+	unsigned pending;
+
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+
+	void *sq_map, *cq_map;
+	size_t sq_map_size, cq_map_size, sqes_size;
+};
+
+static void
+ring_free(struct batch_ring *ring)
+{
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_map && ring->cq_map != ring->sq_map)
+		munmap(ring->cq_map, ring->cq_map_size);
+	if (ring->sq_map)
+		munmap(ring->sq_map, ring->sq_map_size);
+	if (ring->fd >= 0)
+		close(ring->fd);
+}
+
+static void *
+ring_map(int fd, size_t size, off_t offset)
+{
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+	return map == MAP_FAILED ? NULL : map;
+}
+
+/* ring_init: set up an io_uring without liburing; fails on kernels
+ * older than 5.6, which lack the open, read and close operations */
+static int
+ring_init(struct batch_ring *ring, unsigned entries)
+{
+	struct io_uring_params p;
+	uint8_t *sq, *cq;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -1;
+
+	if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+		ring_free(ring);
+		return -1;
+	}
+
+	ring->entries = p.sq_entries;
+	ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_map_size > ring->sq_map_size)
+			ring->sq_map_size = ring->cq_map_size;
+		ring->sq_map = ring_map(ring->fd, ring->sq_map_size, IORING_OFF_SQ_RING);
+		ring->cq_map = ring->sq_map;
+	} else {
+		ring->sq_map = ring_map(ring->fd, ring->sq_map_size, IORING_OFF_SQ_RING);
+		ring->cq_map = ring_map(ring->fd, ring->cq_map_size, IORING_OFF_CQ_RING);
+	}
+	ring->sqes = ring_map(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+
+	if (!ring->sq_map || !ring->cq_map || !ring->sqes) {
+		ring_free(ring);
+		return -1;
+	}
+
+	sq = ring->sq_map;
+	cq = ring->cq_map;
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	ring->tail = *ring->sq_tail;
+
+	return 0;
+}
+
+/* ring_submit: hand the prepared entries to the kernel, waiting for wait completions */
+static int
+ring_submit(struct batch_ring *ring, unsigned wait)
+{
+	int ret;
+
+	__atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret > 0)
+		ring->pending -= ret;
+	return ret;
+}
+
+static struct io_uring_sqe *
+ring_prep(struct batch_ring *ring, uint8_t opcode, int fd, const void *addr, unsigned len, uint64_t offset, void *user_data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned index;
+
+	/* submission queue full */
+	if (ring->tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->entries)
+		ring_submit(ring, 0);
+
+	index = ring->tail & *ring->sq_mask;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)addr;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = (uintptr_t)user_data;
+
+	ring->sq_array[index] = index;
+	ring->tail++;
+	ring->pending++;
+	return sqe;
+}
+
+/* ring_next: take the next completion, if any */
+static int
+ring_next(struct batch_ring *ring, struct io_uring_cqe *cqe)
+{
+	unsigned head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return 0;
+
+	*cqe = ring->cqes[head & *ring->cq_mask];
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static void
+batch_close(struct batch_ring *ring, struct batch_job *job)
+{
+	if (job->fd >= 0)
+		ring_prep(ring, IORING_OP_CLOSE, job->fd, NULL, 0, 0, NULL);
+	job->fd = -1;
+}
+
+/* batch_abort: after a failed submission, tear the ring down, which drops
+ * its requests, wait for the pool to hand back the rendering jobs and
+ * free every job of the I/O loop */
+static void
+batch_abort(struct batch_ring *ring, struct batch_pool *pool, struct batch_job **jobs, int rendering)
+{
+	struct pollfd event = { pool->notify, POLLIN, 0 };
+	struct batch_job *job;
+	uint64_t value;
+	int i;
+
+	ring_free(ring);
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		while ((job = batch_pop(&pool->done)) != NULL) {
+			jobs[job->slot] = NULL;
+			batch_job_free(job);
+			rendering--;
+		}
+		pthread_mutex_unlock(&pool->lock);
+
+		if (!rendering)
+			break;
+
+		if (poll(&event, 1, -1) > 0 && read(pool->notify, &value, sizeof(value)) < 0 && errno != EAGAIN)
+			fprintf(stderr, "Unable to read the worker events: %s\n", strerror(errno));
+	}
+
+	for (i = 0; i < BATCH_QUEUE_DEPTH; ++i) {
+		if (!jobs[i])
+			continue;
+		if (jobs[i]->fd >= 0)
+			close(jobs[i]->fd);
+		batch_job_free(jobs[i]);
+		jobs[i] = NULL;
+	}
+}
+
+/* batch_uring: open, read, create, write and close every file through
+ * the ring, at most BATCH_QUEUE_DEPTH files at a time, while the pool
+ * renders the ones read */
+static int
+batch_uring(struct batch_ring *ring, struct batch_pool *pool, char **inputs, int count)
+{
+	struct batch_job *jobs[BATCH_QUEUE_DEPTH] = { NULL }, *job, *ready;
+	struct io_uring_cqe cqe;
+	uint64_t value;
+	int next = 0, active = 0, rendering = 0, errors = 0, polling = 0, slot = 0;
+
+	while (next < count || active) {
+		while (next < count && active < BATCH_QUEUE_DEPTH) {
+			job = batch_job_new(inputs[next++], BATCH_OPEN, pool->stage ? pool->stage->compression : BATCH_PLAIN);
+			while (jobs[slot])
+				slot = (slot + 1) % BATCH_QUEUE_DEPTH;
+			job->slot = slot;
+			jobs[slot] = job;
+			ring_prep(ring, IORING_OP_OPENAT, AT_FDCWD, job->input, 0, 0, job)->open_flags = O_RDONLY | O_CLOEXEC;
+			active++;
+		}
+
+		if (!polling) {
+			ring_prep(ring, IORING_OP_POLL_ADD, pool->notify, NULL, 0, 0, &pool->notify)->poll_events = POLLIN;
+			polling = 1;
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		ready = pool->done.head;
+		pool->done.head = pool->done.tail = NULL;
+		pthread_mutex_unlock(&pool->lock);
+
+		while ((job = ready) != NULL) {
+			ready = job->next;
+			rendering--;
+
+			/* the stage reported it */
+			if (job->state == BATCH_FAILED) {
+				jobs[job->slot] = NULL;
+				batch_job_free(job);
+				active--;
+				continue;
+			}
+
+			job->state = BATCH_CREATE;
+			ring_prep(ring, IORING_OP_OPENAT, AT_FDCWD, job->output, 0644, 0, job)->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+		}
+
+		/* the last jobs may just have failed, nothing to wait for then */
+		if (ring_submit(ring, active ? 1 : 0) < 0) {
+			fprintf(stderr, "Unable to submit I/O: %s\n", strerror(errno));
+			batch_abort(ring, pool, jobs, rendering);
+			return errors + active + (count - next);
+		}
+
+		while (ring_next(ring, &cqe)) {
+			if (cqe.user_data == (uintptr_t)&pool->notify) {
+				if (read(pool->notify, &value, sizeof(value)) < 0 && errno != EAGAIN)
+					fprintf(stderr, "Unable to read the worker events: %s\n", strerror(errno));
+				polling = 0;
+				continue;
+			}
+
+			/* close */
+			if (!cqe.user_data)
+				continue;
+
+			job = (struct batch_job *)(uintptr_t)cqe.user_data;
+
+			if (cqe.res < 0) {
+				fprintf(stderr, "I/O error on \"%s\": %s\n",
+					job->state < BATCH_RENDER ? job->input : job->output, strerror(-cqe.res));
+				batch_close(ring, job);
+				jobs[job->slot] = NULL;
+				batch_job_free(job);
+				active--;
+				errors++;
+				continue;
+			}
+
+			switch (job->state) {
+			case BATCH_OPEN:
+				job->fd = cqe.res;
+				job->state = BATCH_READ;
+				hoedown_buffer_grow(job->data, BATCH_READ_UNIT);
+				ring_prep(ring, IORING_OP_READ, job->fd, job->data->data, job->data->asize, 0, job);
+				break;
+
+			case BATCH_READ:
+				if (cqe.res == 0) {
+					batch_close(ring, job);
+					job->state = BATCH_RENDER;
+					rendering++;
+
+					pthread_mutex_lock(&pool->lock);
+					batch_push(&pool->todo, job);
+					pthread_cond_signal(&pool->ready);
+					pthread_mutex_unlock(&pool->lock);
+					break;
+				}
+
+				job->data->size += cqe.res;
+				hoedown_buffer_grow(job->data, job->data->size + BATCH_READ_UNIT);
+				ring_prep(ring, IORING_OP_READ, job->fd, job->data->data + job->data->size,
+					job->data->asize - job->data->size, job->data->size, job);
+				break;
+
+			case BATCH_CREATE:
+				job->fd = cqe.res;
+				job->state = BATCH_WRITE;
+				job->written = 0;
+				cqe.res = 0;
+				/* fall through */
+
+			case BATCH_WRITE:
+				job->written += cqe.res;
+				if (job->written < job->data->size) {
+					ring_prep(ring, IORING_OP_WRITE, job->fd, job->data->data + job->written,
+						job->data->size - job->written, job->written, job);
+					break;
+				}
+
+				batch_close(ring, job);
+				jobs[job->slot] = NULL;
+				batch_job_free(job);
+				active--;
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+	/* the last closes */
+	while (ring->pending && ring_submit(ring, 0) >= 0)
+		;
+
+	return errors;
+}
+
+#endif
+
+/* md2html_batch_compressed: like md2html_batch, with every output
+ * compressed to X.html.gz ("gzip") or X.html.zst ("zstd") by as many
+ * threads as workers, plain X.html when compression is NULL; returns 1
+ * for a format this build does not support */
+int md2html_batch_compressed(char **inputs, int count, int threads, const char *compression)
+{
+	struct batch_pool pool;
+	struct batch_stage stage;
+	pthread_t *workers, *compressors = NULL;
+	enum batch_compression format = BATCH_PLAIN;
+	int i, errors = 0;
+#ifdef HAVE_IO_URING
+	struct batch_ring ring;
+	int uring;
+#endif
+
+	if (compression) {
+#ifdef HAVE_ZLIB
+		if (strcmp(compression, "gzip") == 0)
+			format = BATCH_GZIP;
+#endif
+#ifdef HAVE_ZSTD
+		if (strcmp(compression, "zstd") == 0)
+			format = BATCH_ZSTD;
+#endif
+		if (format == BATCH_PLAIN) {
+			fprintf(stderr, "Unsupported compression \"%s\".\n", compression);
+			return 1;
+		}
+	}
+
+	memset(&pool, 0, sizeof(pool));
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.ready, NULL);
+	pool.notify = -1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	if (threads < 1)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (threads < 1)
+		threads = 1;
+
+#ifdef HAVE_IO_URING
+	uring = ring_init(&ring, BATCH_QUEUE_DEPTH * 8) == 0;
+	if (uring && (pool.notify = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+		ring_free(&ring);
+		uring = 0;
+	}
+#endif
+
+	if (format != BATCH_PLAIN) {
+		memset(&stage, 0, sizeof(stage));
+		pthread_mutex_init(&stage.lock, NULL);
+		pthread_cond_init(&stage.ready, NULL);
+		stage.compression = format;
+		stage.pool = &pool;
+		pool.stage = &stage;
+
+		compressors = malloc(threads * sizeof(pthread_t));
+		for (i = 0; i < threads; ++i)
+			pthread_create(&compressors[i], NULL, batch_compressor, &stage);
+	}
+
+	workers = malloc(threads * sizeof(pthread_t));
+	for (i = 0; i < threads; ++i)
+		pthread_create(&workers[i], NULL, batch_worker, &pool);
+
+#ifdef HAVE_IO_URING
+	if (uring)
+		errors = batch_uring(&ring, &pool, inputs, count);
+	else
+#endif
+	{
+		pthread_mutex_lock(&pool.lock);
+		for (i = 0; i < count; ++i)
+			batch_push(&pool.todo, batch_job_new(inputs[i], BATCH_LOAD, format));
+		pthread_cond_broadcast(&pool.ready);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.ready);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < threads; ++i)
+		pthread_join(workers[i], NULL);
+	free(workers);
+
+	/* the workers are done, so is the queue of the stage */
+	if (compressors) {
+		pthread_mutex_lock(&stage.lock);
+		stage.quit = 1;
+		pthread_cond_broadcast(&stage.ready);
+		pthread_mutex_unlock(&stage.lock);
+
+		for (i = 0; i < threads; ++i)
+			pthread_join(compressors[i], NULL);
+		free(compressors);
+
+		pthread_cond_destroy(&stage.ready);
+		pthread_mutex_destroy(&stage.lock);
+	}
+
+	errors += pool.errors;
+
+#ifdef HAVE_IO_URING
+	if (uring) {
+		ring_free(&ring);
+		close(pool.notify);
+	}
+#endif
+	pthread_cond_destroy(&pool.ready);
+	pthread_mutex_destroy(&pool.lock);
+
+	return errors ? 5 : 0;
+}
+
+/* md2html_batch: render each input X.md to X.html on threads workers
+ * (0 for one per core), reading and writing through io_uring where the
+ * kernel has it and with plain reads and writes in the workers otherwise */
+int md2html_batch(char **inputs, int count, int threads)
+{
+	return md2html_batch_compressed(inputs, count, threads, NULL);
+}
+
+
+/* WORKER MODE */
+
+#ifdef __linux__
+
+#define WORKER_UNIT (64 * 1024)
+
+enum worker_status {
+	WORKER_CRASHED = 6,
+	WORKER_TIMEOUT = 7
+};
+
+struct worker_request {
+	size_t size;	/* of the source at the start of the input file, NUL excluded */
+};
+
+struct worker_reply {
+	int status;
+	size_t size;	/* of the output at the start of the output file */
+};
+
+/* md2html_worker: a forked render process, fed and read through two memfds
+ * that outlive it; restarted after every crash or timeout */
+struct md2html_worker {
+	pid_t pid;	/* 0 while there is no worker */
+	int sock;
+	int timeout_ms;
+	unsigned restarts;
+
+	int input_fd;
+	uint8_t *input;	/* read-write host mapping */
+	size_t input_asize;
+
+	int output_fd;
+	uint8_t *output;	/* read-only host mapping of the last result */
+	size_t output_asize;
+};
+
+/* the output file as seen by the worker process, which renders one document at a time */
+static struct {
+	int fd;
+	uint8_t *map;
+	size_t asize;
+} worker_output;
+
+/* worker_grow: map a shared file again, first doubling it from WORKER_UNIT
+ * until it holds size bytes; files never shrink, since the other process
+ * may map more of them. Returns the mapped size, 0 on failure */
+static size_t
+worker_grow(int fd, uint8_t **map, size_t asize, size_t size, int prot)
+{
+	struct stat st;
+	size_t neoasz;
+	uint8_t *neomap;
+
+	if (fstat(fd, &st))
+		return 0;
+
+	neoasz = st.st_size > 0 ? (size_t)st.st_size : WORKER_UNIT;
+	while (neoasz < size)
+		neoasz *= 2;
+
+	if (neoasz > (size_t)st.st_size && ftruncate(fd, neoasz))
+		return 0;
+
+	neomap = mmap(NULL, neoasz, prot, MAP_SHARED, fd, 0);
+	if (neomap == MAP_FAILED)
+		return 0;
+
+	if (*map)
+		munmap(*map, asize);
+	*map = neomap;
+	return neoasz;
+}
+
+/* worker_realloc: data_realloc of the output buffer of the worker, the
+ * render lands in the output file and the host maps it without a copy */
+static void *
+worker_realloc(void *ptr, size_t size)
+{
+	size_t asize;
+
+	(void)ptr;
+
+	if (size <= worker_output.asize)
+		return worker_output.map;
+
+	asize = worker_grow(worker_output.fd, &worker_output.map, worker_output.asize, size, PROT_READ | PROT_WRITE);
+	if (!asize) {
+		fprintf(stderr, "Allocation failed.\n");
+		abort();
+	}
+	worker_output.asize = asize;
+	return worker_output.map;
+}
+
+/* worker_keep: data_free of the output buffer, the mapping is reused by the next render */
+static void
+worker_keep(void *ptr)
+{
+	(void)ptr;
+}
+
+/* worker_main: serve render requests until the host closes the socket */
+static void
+worker_main(int sock, int input_fd, int output_fd)
+{
+	struct worker_request request;
+	struct worker_reply reply;
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	hoedown_buffer ob;
+	ext_definition ext = {NULL, NULL};
+	uint8_t *input;
+
+	worker_output.fd = output_fd;
+	worker_output.map = NULL;
+	worker_output.asize = 0;
+
+	while (recv(sock, &request, sizeof(request), 0) == sizeof(request)) {
+		reply.status = 0;
+		reply.size = 0;
+
+		input = mmap(NULL, request.size + 1, PROT_READ, MAP_SHARED, input_fd, 0);
+		if (input == MAP_FAILED) {
+			reply.status = 5;
+		} else {
+			renderer = hoedown_html_renderer_new(SCIDOWN_RENDER_MERMAID | SCIDOWN_RENDER_CHARTER | SCIDOWN_RENDER_GNUPLOT | SCIDOWN_RENDER_CSS, 0, get_local());
+			set_html_extension(&ext);
+			document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, &ext, NULL, DEF_MAX_NESTING);
+
+			hoedown_buffer_init(&ob, WORKER_UNIT, worker_realloc, worker_keep, NULL);
+			hoedown_document_render(document, &ob, input, request.size, -1);
+			reply.size = ob.size;
+
+			hoedown_document_free(document);
+			hoedown_html_renderer_free(renderer);
+			munmap(input, request.size + 1);
+		}
+
+		fflush(stdout);
+		if (send(sock, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply))
+			break;
+	}
+
+	_exit(0);
+}
+
+/* worker_start: fork a worker, in a process group of its own so that a kill
+ * takes its gnuplot children along */
+static int
+worker_start(struct md2html_worker *worker)
+{
+	int sv[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv)) {
+		fprintf(stderr, "Unable to create the worker socket: %s\n", strerror(errno));
+		return 5;
+	}
+
+	/* the child must not write out what the host buffered */
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "Unable to start the render worker: %s\n", strerror(errno));
+		close(sv[0]);
+		close(sv[1]);
+		return 5;
+	}
+
+	if (pid == 0) {
+		close(sv[0]);
+		setpgid(0, 0);
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+		worker_main(sv[1], worker->input_fd, worker->output_fd);
+	}
+
+	setpgid(pid, pid);
+	close(sv[1]);
+	worker->pid = pid;
+	worker->sock = sv[0];
+	return 0;
+}
+
+static void
+worker_stop(struct md2html_worker *worker)
+{
+	if (!worker->pid)
+		return;
+
+	close(worker->sock);
+	kill(-worker->pid, SIGKILL);
+	waitpid(worker->pid, NULL, 0);
+	worker->pid = 0;
+}
+
+/* worker_restart: replace a dead or stuck worker right away, so that the
+ * next render does not wait for the fork */
+static void
+worker_restart(struct md2html_worker *worker)
+{
+	worker_stop(worker);
+	worker->restarts++;
+	worker_start(worker);
+}
+
+/* worker_wait: the reply to the pending request, WORKER_TIMEOUT when it does
+ * not come in time and WORKER_CRASHED when the worker exits first */
+static int
+worker_wait(struct md2html_worker *worker, struct worker_reply *reply)
+{
+	struct pollfd pfd;
+	double deadline = watch_now_ms() + worker->timeout_ms, left;
+	ssize_t n;
+	int ret;
+
+	pfd.fd = worker->sock;
+	pfd.events = POLLIN;
+
+	for (;;) {
+		left = deadline - watch_now_ms();
+		if (left <= 0)
+			return WORKER_TIMEOUT;
+
+		ret = poll(&pfd, 1, (int)left + 1);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret == 0)
+			return WORKER_TIMEOUT;
+		if (ret < 0)
+			return WORKER_CRASHED;
+
+		n = recv(worker->sock, reply, sizeof(*reply), 0);
+		return n == sizeof(*reply) ? 0 : WORKER_CRASHED;
+	}
+}
+
+/* md2html_worker_new: start a render worker process; a render taking longer
+ * than timeout_ms (DEF_WORKER_TIMEOUT when not positive) is killed. Start
+ * workers early: they are forked from the calling process */
+struct md2html_worker *
+md2html_worker_new(int timeout_ms)
+{
+	struct md2html_worker *worker = calloc(1, sizeof(struct md2html_worker));
+
+	worker->timeout_ms = timeout_ms > 0 ? timeout_ms : DEF_WORKER_TIMEOUT;
+	worker->input_fd = syscall(SYS_memfd_create, "scidown-input", MFD_CLOEXEC);
+	worker->output_fd = syscall(SYS_memfd_create, "scidown-output", MFD_CLOEXEC);
+
+	if (worker->input_fd < 0 || worker->output_fd < 0 || worker_start(worker)) {
+		if (worker->input_fd < 0 || worker->output_fd < 0)
+			fprintf(stderr, "Unable to create the worker files: %s\n", strerror(errno));
+		if (worker->input_fd >= 0)
+			close(worker->input_fd);
+		if (worker->output_fd >= 0)
+			close(worker->output_fd);
+		free(worker);
+		return NULL;
+	}
+
+	return worker;
+}
+
+/* md2html_worker_render: render like md2html in the worker process; the
+ * output is mapped from the worker's output file and stays valid until the
+ * next render or md2html_worker_free. Returns 0, 5 on I/O errors, 6 when
+ * the worker crashed and 7 when it timed out; the worker is restarted */
+int
+md2html_worker_render(struct md2html_worker *worker, const uint8_t *input_data, size_t input_size,
+	const uint8_t **output_data, size_t *output_size)
+{
+	struct worker_request request;
+	struct worker_reply reply;
+	size_t asize;
+	int ret, attempt;
+
+	*output_data = NULL;
+	*output_size = 0;
+
+	/* NUL-terminated: the parser peeks at a few bytes past the end of its input */
+	if (input_size + 1 > worker->input_asize) {
+		asize = worker_grow(worker->input_fd, &worker->input, worker->input_asize, input_size + 1, PROT_READ | PROT_WRITE);
+		if (!asize) {
+			fprintf(stderr, "Unable to grow the worker input: %s\n", strerror(errno));
+			return 5;
+		}
+		worker->input_asize = asize;
+	}
+	if (input_size)
+		memcpy(worker->input, input_data, input_size);
+	worker->input[input_size] = 0;
+
+	request.size = input_size;
+
+	/* a worker that died while idle is restarted once, the render is not retried */
+	for (attempt = 0; ; ++attempt) {
+		if (!worker->pid && worker_start(worker))
+			return 5;
+		if (send(worker->sock, &request, sizeof(request), MSG_NOSIGNAL) == sizeof(request))
+			break;
+		if (attempt)
+			return WORKER_CRASHED;
+		worker_restart(worker);
+	}
+
+	ret = worker_wait(worker, &reply);
+	if (ret) {
+		fprintf(stderr, "The render worker %s, restarting it.\n", ret == WORKER_TIMEOUT ? "timed out" : "crashed");
+		worker_restart(worker);
+		return ret;
+	}
+	if (reply.status)
+		return reply.status;
+
+	/* the worker grew the file, the host only maps it again */
+	if (reply.size > worker->output_asize) {
+		asize = worker_grow(worker->output_fd, &worker->output, worker->output_asize, reply.size, PROT_READ);
+		if (!asize) {
+			fprintf(stderr, "Unable to map the worker output: %s\n", strerror(errno));
+			return 5;
+		}
+		worker->output_asize = asize;
+	}
+
+	*output_data = worker->output;
+	*output_size = reply.size;
+	return 0;
+}
+
+/* md2html_worker_free: stop the worker and release its files */
+void
+md2html_worker_free(struct md2html_worker *worker)
+{
+	if (!worker)
+		return;
+
+	worker_stop(worker);
+	if (worker->input)
+		munmap(worker->input, worker->input_asize);
+	if (worker->output)
+		munmap(worker->output, worker->output_asize);
+	close(worker->input_fd);
+	close(worker->output_fd);
+	free(worker);
+}
+
+#endif
@@ -7,5 +7,18 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 extern "C" int md2html(const uint8_t* input_data, size_t input_size, uint8_t** output_data, size_t* output_size, int screen_height);
+extern "C" int md2html_profile(const uint8_t* input_data, size_t input_size, uint8_t** output_data, size_t* output_size, uint8_t** profile_data, size_t* profile_size);
+extern "C" int md2html_export(const uint8_t* input_data, size_t input_size, const char* base_folder, uint8_t** output_data, size_t* output_size);
+extern "C" int md2html_stream(FILE* input, FILE* output);
+extern "C" int md2html_mapped(const char* input, FILE* output);
+extern "C" int md2html_batch(char** inputs, int count, int threads);
+extern "C" int md2html_batch_compressed(char** inputs, int count, int threads, const char* compression);
+extern "C" int md2html_watch(char** inputs, int count);
+
+typedef struct md2html_worker md2html_worker;
+extern "C" md2html_worker* md2html_worker_new(int timeout_ms);
+extern "C" int md2html_worker_render(md2html_worker* worker, const uint8_t* input_data, size_t input_size, const uint8_t** output_data, size_t* output_size);
+extern "C" void md2html_worker_free(md2html_worker* worker);
 #endif //SYNCFOLDER_SCIDOWN_MD_H
@@ -3,7 +3,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
+
+#include "charclass.h"
 
 #ifndef _MSC_VER
 #include <strings.h>
@@ -27,7 +28,7 @@ hoedown_autolink_is_safe(const uint8_t *data, size_t size)
 
 		if (size > len &&
 			strncasecmp((char *)data, valid_uris[i], len) == 0 &&
-			isalnum(data[len]))
+			hoedown_isalnum(data[len]))
 			return uris_offset[i];
 	}
 
@@ -53,7 +54,7 @@ autolink_delim(uint8_t *data, size_t link_end, size_t max_rewind, size_t size)
 		else if (data[link_end - 1] == ';') {
 			size_t new_end = link_end - 2;
 
-			while (new_end > 0 && isalpha(data[new_end]))
+			while (new_end > 0 && hoedown_isalpha(data[new_end]))
 				new_end--;
 
 			if (new_end < link_end - 2 && data[new_end] == '&')
@@ -123,12 +124,12 @@ check_domain(uint8_t *data, size_t size, int allow_short)
 {
 	size_t i, np = 0;
 
-	if (!isalnum(data[0]))
+	if (!hoedown_isalnum(data[0]))
 		return 0;
 
 	for (i = 1; i < size - 1; ++i) {
 		if (strchr(".:", data[i]) != NULL) np++;
-		else if (!isalnum(data[i]) && data[i] != '-') break;
+		else if (!hoedown_isalnum(data[i]) && data[i] != '-') break;
 	}
 
 	if (allow_short) {
@@ -155,7 +156,7 @@ hoedown_autolink__www(
 {
 	size_t link_end;
 
-	if (max_rewind > 0 && !ispunct(data[-1]) && !isspace(data[-1]))
+	if (max_rewind > 0 && !hoedown_ispunct(data[-1]) && !hoedown_isspace(data[-1]))
 		return 0;
 
 	if (size < 4 || memcmp(data, "www.", strlen("www.")) != 0)
@@ -166,7 +167,7 @@ hoedown_autolink__www(
 	if (link_end == 0)
 		return 0;
 
-	while (link_end < size && !isspace(data[link_end]))
+	while (link_end < size && !hoedown_isspace(data[link_end]))
 		link_end++;
 
 	link_end = autolink_delim(data, link_end, max_rewind, size);
@@ -195,7 +196,7 @@ hoedown_autolink__email(
 	for (rewind = 0; rewind < max_rewind; ++rewind) {
 		uint8_t c = data[-1 - rewind];
 
-		if (isalnum(c))
+		if (hoedown_isalnum(c))
 			continue;
 
 		if (strchr(".+-_", c) != NULL)
@@ -210,7 +211,7 @@ hoedown_autolink__email(
 	for (link_end = 0; link_end < size; ++link_end) {
 		uint8_t c = data[link_end];
 
-		if (isalnum(c))
+		if (hoedown_isalnum(c))
 			continue;
 
 		if (c == '@')
@@ -222,7 +223,7 @@ hoedown_autolink__email(
 	}
 
 	if (link_end < 2 || nb != 1 || np == 0 ||
-		!isalpha(data[link_end - 1]))
+		!hoedown_isalpha(data[link_end - 1]))
 		return 0;
 
 	link_end = autolink_delim(data, link_end, max_rewind, size);
@@ -250,7 +251,7 @@ hoedown_autolink__url(
 	if (size < 4 || data[1] != '/' || data[2] != '/')
 		return 0;
 
-	while (rewind < max_rewind && isalpha(data[-1 - rewind]))
+	while (rewind < max_rewind && hoedown_isalpha(data[-1 - rewind]))
 		rewind++;
 
 	if (!hoedown_autolink_is_safe(data - rewind, size + rewind))
@@ -267,7 +268,7 @@ hoedown_autolink__url(
 		return 0;
 
 	link_end += domain_len;
-	while (link_end < size && !isspace(data[link_end]))
+	while (link_end < size && !hoedown_isspace(data[link_end]))
 		link_end++;
 
 	link_end = autolink_delim(data, link_end, max_rewind, size);
@@ -0,0 +1,464 @@
+#include "book.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "charclass.h"
+#include "utils.h"
+
+#define BOOK_SOURCE_UNIT 1024
+#define BOOK_OUTPUT_UNIT 64
+
+/* book_job: chapters handed out to the render threads */
+struct book_job {
+	scidown_book *book;
+	const scidown_book_renderer *renderer;
+	pthread_mutex_t lock;
+	size_t next;
+	size_t rendered;
+};
+
+
+/********************
+ * HELPER FUNCTIONS *
+ ********************/
+
+/* chapter_path: path of a chapter file, relative to the base folder */
+static char *
+chapter_path(const scidown_book *book, const char *path)
+{
+	size_t n1, n2;
+	char *full;
+
+	if (!book->base_folder || path[0] == '/')
+		return strdup(path);
+
+	n1 = strlen(book->base_folder);
+	n2 = strlen(path);
+	full = hoedown_malloc(n1 + n2 + 2);
+	memcpy(full, book->base_folder, n1);
+	full[n1] = '/';
+	memcpy(full + n1 + 1, path, n2 + 1);
+
+	return full;
+}
+
+/* set_source: replace the source of a chapter, flags it for a scan if it changed */
+static void
+set_source(scidown_book_chapter *chapter, const uint8_t *data, size_t size)
+{
+	if (chapter->source->size == size && memcmp(chapter->source->data, data, size) == 0)
+		return;
+
+	hoedown_buffer_set(chapter->source, data, size);
+	chapter->rescan = 1;
+}
+
+/* reload_chapter: read a chapter file again if it changed on disk */
+static void
+reload_chapter(const scidown_book *book, scidown_book_chapter *chapter)
+{
+	char *path = chapter_path(book, chapter->path);
+	hoedown_buffer *data;
+	struct stat st;
+	FILE *f;
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+		free(path);
+		return;
+	}
+
+	if ((long)st.st_mtime == chapter->mtime && (long)st.st_size == chapter->file_size) {
+		free(path);
+		return;
+	}
+
+	f = fopen(path, "rb");
+	free(path);
+	if (!f)
+		return;
+
+	data = hoedown_buffer_new(BOOK_SOURCE_UNIT);
+	if (hoedown_buffer_putf(data, f) == 0) {
+		set_source(chapter, data->data, data->size);
+		chapter->mtime = (long)st.st_mtime;
+		chapter->file_size = (long)st.st_size;
+	}
+
+	hoedown_buffer_free(data);
+	fclose(f);
+}
+
+static void
+free_labels(reference *labels)
+{
+	reference *next;
+
+	for (; labels; labels = next) {
+		next = labels->next;
+		free(labels->id);
+		free(labels);
+	}
+}
+
+/* float_offset: number of the floats of the given type before a chapter */
+static uint32_t
+float_offset(const html_counter *floats, float_type type)
+{
+	switch (type) {
+	case FIGURE:
+		return floats->figure;
+	case TABLE:
+		return floats->table;
+	case LISTING:
+		return floats->listing;
+	case EQUATION:
+		return floats->equation;
+	}
+
+	return 0;
+}
+
+/* advance_headers: header numbers after the headers of a chapter, counted like the renderer does */
+static h_counter
+advance_headers(h_counter counter, const toc *headers)
+{
+	for (; headers; headers = headers->sibling) {
+		if (headers->nesting == 1) {
+			counter.chapter++;
+			counter.section = 0;
+			counter.subsection = 0;
+		} else if (headers->nesting == 2) {
+			counter.section++;
+			counter.subsection = 0;
+		} else if (headers->nesting == 3) {
+			counter.subsection++;
+		}
+	}
+
+	return counter;
+}
+
+static int
+same_numbering(const doc_numbering *a, const doc_numbering *b)
+{
+	return a->headers.chapter == b->headers.chapter &&
+		a->headers.section == b->headers.section &&
+		a->headers.subsection == b->headers.subsection &&
+		a->floats.figure == b->floats.figure &&
+		a->floats.equation == b->floats.equation &&
+		a->floats.listing == b->floats.listing &&
+		a->floats.table == b->floats.table;
+}
+
+/* cited_hash: digest of the numbers the (#id) references of a chapter resolve to */
+static uint32_t
+cited_hash(const scidown_book *book, const scidown_book_chapter *chapter)
+{
+	const uint8_t *data = chapter->source->data;
+	size_t size = chapter->source->size, i = 0, end;
+	uint32_t hash = SCIDOWN_HASH_INIT;
+	const reference *label;
+	int32_t number;
+
+	while (i + 1 < size) {
+		if (data[i] != '(' || data[i + 1] != '#') {
+			i++;
+			continue;
+		}
+
+		i += 2;
+		for (end = i; end < size && data[end] != ')' && data[end] != '\n'; end++);
+
+		number = -1;
+		for (label = book->labels; label; label = label->next) {
+			if (strlen(label->id) == end - i && memcmp(label->id, data + i, end - i) == 0) {
+				number = label->counter;
+				break;
+			}
+		}
+
+		hash = scidown_hash_more(hash, data + i, end - i);
+		hash = scidown_hash_more(hash, &number, sizeof(number));
+		i = end;
+	}
+
+	return hash;
+}
+
+static void
+render_chapter(scidown_book *book, scidown_book_chapter *chapter, const scidown_book_renderer *renderer)
+{
+	hoedown_renderer *rndr = renderer->renderer_new(chapter, renderer->opaque);
+	hoedown_document *doc = hoedown_document_new(rndr, renderer->extensions,
+		renderer->external_extensions, book->base_folder, renderer->max_nesting);
+
+	hoedown_document_set_numbering(doc, &chapter->start);
+
+	hoedown_buffer_reset(chapter->output);
+	hoedown_document_render(doc, chapter->output, chapter->source->data, chapter->source->size, -1);
+
+	hoedown_document_free(doc);
+	renderer->renderer_free(rndr);
+	chapter->dirty = 0;
+}
+
+static void *
+render_thread(void *opaque)
+{
+	struct book_job *job = opaque;
+	scidown_book_chapter *chapter;
+
+	while (1) {
+		chapter = NULL;
+
+		pthread_mutex_lock(&job->lock);
+		while (job->next < job->book->count && !chapter) {
+			if (job->book->chapters[job->next].dirty) {
+				chapter = &job->book->chapters[job->next];
+				job->rendered++;
+			}
+			job->next++;
+		}
+		pthread_mutex_unlock(&job->lock);
+
+		if (!chapter)
+			break;
+
+		render_chapter(job->book, chapter, job->renderer);
+	}
+
+	return NULL;
+}
+
+
+/**********************
+ * EXPORTED FUNCTIONS *
+ **********************/
+
+scidown_book *
+scidown_book_new(const char *base_folder)
+{
+	scidown_book *book = hoedown_calloc(1, sizeof(scidown_book));
+
+	book->base_folder = base_folder ? strdup(base_folder) : NULL;
+
+	return book;
+}
+
+size_t
+scidown_book_add_chapter(scidown_book *book, const char *path)
+{
+	scidown_book_chapter *chapter;
+
+	if (book->count >= book->asize) {
+		book->asize = book->asize ? book->asize * 2 : 8;
+		book->chapters = hoedown_realloc(book->chapters, book->asize * sizeof(scidown_book_chapter));
+	}
+
+	chapter = &book->chapters[book->count];
+	memset(chapter, 0x0, sizeof(scidown_book_chapter));
+
+	chapter->path = strdup(path);
+	chapter->source = hoedown_buffer_new(BOOK_SOURCE_UNIT);
+	chapter->output = hoedown_buffer_new(BOOK_OUTPUT_UNIT);
+	chapter->mtime = -1;
+	chapter->file_size = -1;
+	chapter->rescan = 1;
+	chapter->dirty = 1;
+
+	return book->count++;
+}
+
+size_t
+scidown_book_load_manifest(scidown_book *book, const uint8_t *data, size_t size)
+{
+	size_t i = 0, beg, end, added = 0;
+	char *path;
+
+	while (i < size) {
+		beg = i;
+		while (i < size && data[i] != '\n')
+			i++;
+		end = i++;
+
+		while (beg < end && hoedown_isspace(data[beg]))
+			beg++;
+		while (end > beg && hoedown_isspace(data[end - 1]))
+			end--;
+
+		if (beg == end || data[beg] == '#')
+			continue;
+
+		if (end - beg > 10 && memcmp(data + beg, "@include(", 9) == 0 && data[end - 1] == ')') {
+			beg += 9;
+			end--;
+		}
+
+		path = hoedown_malloc(end - beg + 1);
+		memcpy(path, data + beg, end - beg);
+		path[end - beg] = 0;
+
+		scidown_book_add_chapter(book, path);
+		free(path);
+		added++;
+	}
+
+	return added;
+}
+
+void
+scidown_book_set_source(scidown_book *book, size_t chapter, const uint8_t *data, size_t size)
+{
+	scidown_book_chapter *ch = &book->chapters[chapter];
+	char *path = chapter_path(book, ch->path);
+	struct stat st;
+
+	set_source(ch, data, size);
+
+	/* keep the unsaved version until the file changes on disk */
+	if (stat(path, &st) == 0) {
+		ch->mtime = (long)st.st_mtime;
+		ch->file_size = (long)st.st_size;
+	}
+
+	free(path);
+}
+
+size_t
+scidown_book_scan(scidown_book *book, hoedown_extensions extensions)
+{
+	static const hoedown_renderer scanner = {0};
+	hoedown_document *doc = NULL;
+	doc_numbering start = {{0, 0, 0}, {0, 0, 0, 0}, NULL};
+	reference *label, *copy, **tail;
+	scidown_book_chapter *chapter;
+	uint32_t hash;
+	size_t i, dirty = 0;
+
+	/* pre-scan the chapters that changed */
+	for (i = 0; i < book->count; ++i) {
+		chapter = &book->chapters[i];
+		reload_chapter(book, chapter);
+
+		if (!chapter->rescan)
+			continue;
+
+		if (!doc)
+			doc = hoedown_document_new(&scanner, extensions, NULL, book->base_folder, 1);
+
+		hoedown_document_scan_free(&chapter->scan);
+		hoedown_document_scan(doc, chapter->source->data, chapter->source->size, &chapter->scan);
+		chapter->rescan = 0;
+		chapter->dirty = 1;
+	}
+
+	if (doc)
+		hoedown_document_free(doc);
+
+	/* number the chapters and their labels across the book */
+	free_labels(book->labels);
+	book->labels = NULL;
+	book->labels_count = 0;
+	tail = &book->labels;
+
+	for (i = 0; i < book->count; ++i) {
+		chapter = &book->chapters[i];
+
+		if (!same_numbering(&chapter->start, &start))
+			chapter->dirty = 1;
+		chapter->start.headers = start.headers;
+		chapter->start.floats = start.floats;
+
+		for (label = chapter->scan.labels; label; label = label->next) {
+			copy = hoedown_malloc(sizeof(reference));
+			copy->id = strdup(label->id);
+			copy->type = label->type;
+			copy->counter = label->counter + float_offset(&start.floats, label->type);
+			copy->next = NULL;
+
+			*tail = copy;
+			tail = (reference **)&copy->next;
+			book->labels_count++;
+		}
+
+		start.headers = advance_headers(start.headers, chapter->scan.headers);
+		start.floats.figure += chapter->scan.floats.figure;
+		start.floats.equation += chapter->scan.floats.equation;
+		start.floats.listing += chapter->scan.floats.listing;
+		start.floats.table += chapter->scan.floats.table;
+	}
+
+	/* a chapter is also out of date when a number it cites moved */
+	for (i = 0; i < book->count; ++i) {
+		chapter = &book->chapters[i];
+		chapter->start.labels = book->labels;
+
+		hash = cited_hash(book, chapter);
+		if (hash != chapter->cited_hash)
+			chapter->dirty = 1;
+		chapter->cited_hash = hash;
+
+		if (chapter->dirty)
+			dirty++;
+	}
+
+	return dirty;
+}
+
+size_t
+scidown_book_render(scidown_book *book, const scidown_book_renderer *renderer, int threads)
+{
+	struct book_job job;
+	pthread_t *workers;
+	int i, started = 0;
+
+	job.book = book;
+	job.renderer = renderer;
+	job.next = 0;
+	job.rendered = 0;
+	pthread_mutex_init(&job.lock, NULL);
+
+	if (threads > 1) {
+		workers = hoedown_malloc(threads * sizeof(pthread_t));
+
+		for (i = 0; i < threads; ++i)
+			if (pthread_create(&workers[started], NULL, render_thread, &job) == 0)
+				started++;
+
+		for (i = 0; i < started; ++i)
+			pthread_join(workers[i], NULL);
+
+		free(workers);
+	}
+
+	/* single threaded, or finish what the threads could not start on */
+	if (!started)
+		render_thread(&job);
+
+	pthread_mutex_destroy(&job.lock);
+
+	return job.rendered;
+}
+
+void
+scidown_book_free(scidown_book *book)
+{
+	size_t i;
+
+	for (i = 0; i < book->count; ++i) {
+		free(book->chapters[i].path);
+		hoedown_buffer_free(book->chapters[i].source);
+		hoedown_buffer_free(book->chapters[i].output);
+		hoedown_document_scan_free(&book->chapters[i].scan);
+	}
+
+	free_labels(book->labels);
+	free(book->chapters);
+	free(book->base_folder);
+	free(book);
+}
@@ -0,0 +1,101 @@
+/* book.h - multi-file books with shared numbering */
+
+#ifndef SCIDOWN_BOOK_H
+#define SCIDOWN_BOOK_H
+
+#include "document.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*********
+ * TYPES *
+ *********/
+
+/* scidown_book_chapter: a chapter file, its pre-scan and its rendered output */
+struct scidown_book_chapter {
+	char *path;
+
+	hoedown_buffer *source;
+	long mtime;
+	long file_size;
+	int rescan;
+
+	doc_scan scan;
+
+	/* numbering the chapter starts from, labels point to the whole book */
+	doc_numbering start;
+	uint32_t cited_hash;
+
+	int dirty;
+	hoedown_buffer *output;
+};
+typedef struct scidown_book_chapter scidown_book_chapter;
+
+/* scidown_book_renderer: how chapters are rendered, renderer_new is called once per
+ * chapter and from several threads at a time; it should set the float
+ * counters of its renderer state from chapter->start.floats */
+struct scidown_book_renderer {
+	hoedown_renderer *(*renderer_new)(const scidown_book_chapter *chapter, void *opaque);
+	void (*renderer_free)(hoedown_renderer *renderer);
+	void *opaque;
+
+	hoedown_extensions extensions;
+	ext_definition *external_extensions;
+	size_t max_nesting;
+};
+typedef struct scidown_book_renderer scidown_book_renderer;
+
+struct scidown_book {
+	char *base_folder;
+
+	scidown_book_chapter *chapters;
+	size_t count;
+	size_t asize;
+
+	/* labels of every chapter, numbered across the book */
+	reference *labels;
+	size_t labels_count;
+};
+typedef struct scidown_book scidown_book;
+
+
+/*************
+ * FUNCTIONS *
+ *************/
+
+/* scidown_book_new: allocate an empty book, chapter paths are relative to base_folder (NULL for the working directory) */
+scidown_book *scidown_book_new(const char *base_folder) __attribute__ ((malloc));
+
+/* scidown_book_add_chapter: append a chapter, returns its number */
+size_t scidown_book_add_chapter(scidown_book *book, const char *path);
+
+/* scidown_book_load_manifest: append the chapters listed in a manifest, one
+ * path or @include(path) per line, blank lines and lines starting with '#'
+ * are ignored; returns the number of chapters added */
+size_t scidown_book_load_manifest(scidown_book *book, const uint8_t *data, size_t size);
+
+/* scidown_book_set_source: replace the source of a chapter with an unsaved version */
+void scidown_book_set_source(scidown_book *book, size_t chapter, const uint8_t *data, size_t size);
+
+/* scidown_book_scan: reload the chapter files changed on disk, pre-scan the
+ * changed chapters and recompute the numbering of the book; returns the
+ * number of chapters whose output is out of date */
+size_t scidown_book_scan(scidown_book *book, hoedown_extensions extensions);
+
+/* scidown_book_render: render every out of date chapter into its output,
+ * using up to threads threads; returns the number of chapters rendered */
+size_t scidown_book_render(scidown_book *book, const scidown_book_renderer *renderer, int threads);
+
+/* scidown_book_free: deallocate a book */
+void scidown_book_free(scidown_book *book);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** SCIDOWN_BOOK_H **/
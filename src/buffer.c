@@ -62,6 +62,34 @@ hoedown_buffer_init(
 	buf->buffer_free = buffer_free;
 }
 
+/* fixed_free: data_free of a buffer still using storage it does not own */
+static void
+fixed_free(void *ptr)
+{
+	(void)ptr;
+}
+
+void
+hoedown_buffer_init_fixed(hoedown_buffer *buf, uint8_t *data, size_t size, size_t unit)
+{
+	hoedown_buffer_init(buf, unit, NULL, fixed_free, NULL);
+	buf->data = data;
+	buf->asize = size;
+}
+
+int
+hoedown_buffer_fixed(const hoedown_buffer *buf)
+{
+	return buf->data_free == fixed_free;
+}
+
+hoedown_buffer *
+hoedown_buffer_init_small(hoedown_buffer_small *small, size_t unit)
+{
+	hoedown_buffer_init_fixed(&small->buffer, small->storage, HOEDOWN_BUFFER_SMALL, unit);
+	return &small->buffer;
+}
+
 void
 hoedown_buffer_uninit(hoedown_buffer *buf)
 {
@@ -112,7 +140,18 @@ hoedown_buffer_grow(hoedown_buffer *buf, size_t neosz)
 	while (neoasz < neosz)
 		neoasz += buf->unit;
 
-	buf->data = buf->data_realloc(buf->data, neoasz);
+	if (buf->data_free == fixed_free) {
+		/* spill the fixed storage to the heap */
+		uint8_t *data = hoedown_malloc(neoasz);
+		if (buf->size)
+			memcpy(data, buf->data, buf->size);
+
+		buf->data = data;
+		buf->data_realloc = hoedown_realloc;
+		buf->data_free = free;
+	} else {
+		buf->data = buf->data_realloc(buf->data, neoasz);
+	}
 	buf->asize = neoasz;
 }
 
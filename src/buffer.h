@@ -40,6 +40,18 @@ struct hoedown_buffer {
 
 typedef struct hoedown_buffer hoedown_buffer;
 
+/* inline storage of a small buffer, enough for most short-lived temporaries */
+#define HOEDOWN_BUFFER_SMALL 64
+
+/* hoedown_buffer_small: a buffer with inline storage, meant to live on the
+ * stack; it only allocates once its contents outgrow the storage */
+struct hoedown_buffer_small {
+	hoedown_buffer buffer;
+	uint8_t storage[HOEDOWN_BUFFER_SMALL];
+};
+
+typedef struct hoedown_buffer_small hoedown_buffer_small;
+
 
 /*************
  * FUNCTIONS *
@@ -62,6 +74,18 @@ void hoedown_buffer_init(
 /* hoedown_buffer_uninit: uninitialize an existing buffer */
 void hoedown_buffer_uninit(hoedown_buffer *buf);
 
+/* hoedown_buffer_init_fixed: initialize a buffer over the size bytes at data,
+ * which it writes to until they are outgrown; then its contents move to the
+ * heap, as for a small buffer. Release it with hoedown_buffer_uninit */
+void hoedown_buffer_init_fixed(hoedown_buffer *buf, uint8_t *data, size_t size, size_t unit);
+
+/* hoedown_buffer_fixed: whether a buffer still writes to storage it does not own */
+int hoedown_buffer_fixed(const hoedown_buffer *buf);
+
+/* hoedown_buffer_init_small: initialize a small buffer and return the buffer
+ * to use, release it with hoedown_buffer_uninit */
+hoedown_buffer *hoedown_buffer_init_small(hoedown_buffer_small *small, size_t unit);
+
 /* hoedown_buffer_new: allocate a new buffer */
 hoedown_buffer *hoedown_buffer_new(size_t unit) __attribute__ ((malloc));
 
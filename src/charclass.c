@@ -0,0 +1,45 @@
+#include "charclass.h"
+
+/*
+ * Every byte is classified once, here, instead of going through the libc
+ * <ctype.h> functions: those depend on the current locale (so a document
+ * could render differently depending on the embedding application) and
+ * cost an indirect table lookup per call.
+ *
+ * Bytes >= 0x80 belong to no class: UTF-8 sequences are never spacing,
+ * punctuation or alphanumeric as far as the parser is concerned.
+ *
+ * The URL class contains the characters that are not escaped inside an
+ * href:
+ *
+ *		-_.+!*'(),%#@?=;:/,+&$ alphanum
+ *
+ * that is, the characters which are safe to be in an URL plus the RESERVED
+ * ones, which we assume (lazily) are meant to have their native function.
+ * The & (amp) and ' (single quote) are not part of the class: they are
+ * valid URL components but need HTML-entity escaping to generate valid
+ * markup.
+ *
+ * The active class contains the characters that have a meaning in
+ * Markdown and can be escaped with a backslash:
+ *
+ *		\ ` * _ { } [ ] ( ) # + - . ! : | & < > ^ ~ = " $
+ */
+const uint8_t hoedown_charclass[UINT8_MAX+1] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x21, 0x01, 0x01, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x21, 0xc2, 0x42, 0xc2, 0xc2, 0x82, 0x42, 0x02, 0xc2, 0xc2, 0xc2, 0xc2, 0x82, 0xc2, 0xc2, 0x82,
+	0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0xc2, 0x82, 0x42, 0xc2, 0x42, 0x82,
+	0x82, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84,
+	0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x84, 0x42, 0x42, 0x42, 0x42, 0xc2,
+	0x42, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+	0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x42, 0x42, 0x42, 0x42, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
@@ -0,0 +1,64 @@
+/* charclass.h - locale-independent character classification */
+
+#ifndef HOEDOWN_CHARCLASS_H
+#define HOEDOWN_CHARCLASS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_MSC_VER)
+#define inline __inline
+#endif
+
+
+/*************
+ * CONSTANTS *
+ *************/
+
+typedef enum hoedown_char_class {
+	HOEDOWN_CHAR_SPACE   = (1 << 0),	/* ' ' \t \n \v \f \r */
+	HOEDOWN_CHAR_PUNCT   = (1 << 1),	/* ASCII punctuation */
+	HOEDOWN_CHAR_UPPER   = (1 << 2),	/* A-Z */
+	HOEDOWN_CHAR_LOWER   = (1 << 3),	/* a-z */
+	HOEDOWN_CHAR_DIGIT   = (1 << 4),	/* 0-9 */
+	HOEDOWN_CHAR_MDSPACE = (1 << 5),	/* Markdown spacing: ' ' and \n */
+	HOEDOWN_CHAR_ACTIVE  = (1 << 6),	/* Markdown-active, escapable with '\\' */
+	HOEDOWN_CHAR_URL     = (1 << 7)	/* no escaping needed inside an href */
+} hoedown_char_class;
+
+#define HOEDOWN_CHAR_ALPHA (HOEDOWN_CHAR_UPPER | HOEDOWN_CHAR_LOWER)
+#define HOEDOWN_CHAR_ALNUM (HOEDOWN_CHAR_ALPHA | HOEDOWN_CHAR_DIGIT)
+
+
+/*************
+ * VARIABLES *
+ *************/
+
+/* hoedown_charclass: class bits of every byte value, independent of the locale */
+extern const uint8_t hoedown_charclass[UINT8_MAX+1];
+
+
+/*************
+ * FUNCTIONS *
+ *************/
+
+static inline int hoedown_isspace(uint8_t c) { return hoedown_charclass[c] & HOEDOWN_CHAR_SPACE; }
+static inline int hoedown_ispunct(uint8_t c) { return hoedown_charclass[c] & HOEDOWN_CHAR_PUNCT; }
+static inline int hoedown_isalpha(uint8_t c) { return hoedown_charclass[c] & HOEDOWN_CHAR_ALPHA; }
+static inline int hoedown_isalnum(uint8_t c) { return hoedown_charclass[c] & HOEDOWN_CHAR_ALNUM; }
+static inline int hoedown_ismdspace(uint8_t c) { return hoedown_charclass[c] & HOEDOWN_CHAR_MDSPACE; }
+static inline int hoedown_isactive(uint8_t c) { return hoedown_charclass[c] & HOEDOWN_CHAR_ACTIVE; }
+static inline int hoedown_isurlsafe(uint8_t c) { return hoedown_charclass[c] & HOEDOWN_CHAR_URL; }
+
+/* hoedown_tolower: ASCII-only lowercase, bytes >= 0x80 are returned unchanged */
+static inline uint8_t hoedown_tolower(uint8_t c) { return (hoedown_charclass[c] & HOEDOWN_CHAR_UPPER) ? c + ('a' - 'A') : c; }
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** HOEDOWN_CHARCLASS_H **/
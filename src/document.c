@@ -1,14 +1,15 @@
 #include "document.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include "stack.h"
+#include "charclass.h"
 #include "utf8.h"
 #ifndef _MSC_VER
 #include <strings.h>
@@ -24,7 +25,11 @@
 #define HOEDOWN_LI_END 8	/* internal list flag */
 
 const char *hoedown_find_block_tag(const char *str, unsigned int len);
-int find_ref(reference * refs, char*id, int *counter);
+void free_references(reference * ref);
+void free_toc(toc * ToC);
+void free_meta(metadata * meta);
+static void clear_meta(metadata * meta);
+void look_for_ref(hoedown_document *doc, const uint8_t *data, size_t size, html_counter * counter);
 
 /***************
  * LOCAL TYPES *
@@ -63,6 +68,126 @@ struct footnote_list {
 	struct footnote_item *tail;
 };
 
+/* delim_type: kinds of delimiter runs tracked by inline_index */
+enum delim_type {
+	DELIM_BACKTICK,
+	DELIM_DOLLAR
+};
+
+#define DELIM_NONE ((size_t)-1)
+
+/* delim_run: a run of '`' or '$' inside an inline span */
+struct delim_run {
+	size_t start;		/* offset of the run in the span */
+	size_t size;		/* number of delimiter chars */
+	size_t next[2];		/* following runs able to close it */
+	size_t text_before;	/* end of the last non-spacing char before the run */
+	size_t text_after;	/* first non-spacing char after the run */
+	int escaped;		/* the first char is escaped by '\\' */
+};
+
+/* source_line: start of a line in the preprocessed text and in the source */
+struct source_line {
+	size_t text;
+	size_t source;
+};
+
+/* inline_index: delimiter runs of the span being parsed by parse_inline, */
+/*   built lazily the first time an opener of the given type is found */
+struct inline_index {
+	const uint8_t *data;
+	size_t size;
+
+	struct delim_run *runs[2];
+	size_t count[2];
+	size_t asize[2];
+	size_t cursor[2];
+	int built[2];
+};
+
+/* stream_ref_type: kinds of forward references a streaming render can defer */
+enum stream_ref_type {
+	STREAM_LINK,		/* [text][id], ![alt][id] */
+	STREAM_FOOTNOTE,	/* [^id] */
+	STREAM_FLOAT,		/* (#id) */
+	STREAM_TOC		/* @toc, in a single-pass render */
+};
+
+/* stream_placeholder: a reference not defined yet, the output holds */
+/*   STREAM_MARK index STREAM_MARK until it is rendered again from raw; */
+/*   a STREAM_MARK of the streamed source is fed doubled and output once */
+struct stream_placeholder {
+	enum stream_ref_type type;
+	hoedown_buffer *id;
+	hoedown_buffer *raw;
+};
+
+/* stream_state: input, output and scanning state of a streaming render */
+struct stream_state {
+	hoedown_buffer *input;		/* source not yet rendered */
+	hoedown_buffer *output;		/* rendered, from the first unresolved placeholder */
+
+	struct stream_placeholder *placeholders;
+	size_t count;
+	size_t asize;
+
+	/* block scanner: input[0 .. scanned) has been classified */
+	size_t scanned;
+	size_t cut;		/* last offset where a top-level block starts */
+	size_t fence_width;
+	uint8_t fence;
+	int in_env, in_yaml, in_footnote, blank;
+	const char *html_tag;	/* open raw html block */
+
+	html_counter floats;
+	size_t defined;		/* definitions seen so far */
+	size_t blocked_defined;	/* definitions seen when the output got stuck */
+	int blocked;
+	int started;
+	int resolving;
+
+	/* single-pass render: floats are labelled and headers listed as they are parsed */
+	int single;
+	toc *toc_last;
+};
+
+/* block_frame_type: what a block frame parses */
+enum block_frame_type {
+	FRAME_RUN,		/* a run of blocks */
+	FRAME_QUOTE,		/* the containers below wait for the run of their contents */
+	FRAME_LIST,
+	FRAME_ITEM,
+	FRAME_FLOAT,
+	FRAME_ABSTRACT
+};
+
+/* block_frame: a run of blocks or an open container, kept in doc->frames */
+/*   instead of the C stack so that containers nest as deep as memory allows */
+struct block_frame {
+	enum block_frame_type type;
+	hoedown_buffer *ob;
+	hoedown_buffer *work;	/* rendered contents of a quote or a list, source of an item */
+	uint8_t *data;
+	size_t size;
+	size_t beg;		/* next block of a run, next item of a list, next part of an item */
+
+	/* FRAME_RUN: cursor position and profiling of the current top-level block */
+	int position;
+	int profiled;
+	double start;
+	size_t output;
+
+	/* FRAME_LIST, FRAME_ITEM */
+	hoedown_list_flags flags;
+	hoedown_buffer *inter;
+	size_t sublist;
+
+	/* FRAME_FLOAT */
+	float_args args;
+};
+
+#define STREAM_MARK 0x1B
+
 /* char_trigger: function pointer to render active chars */
 /*   returns the number of chars taken care of */
 /*   data is the pointer of the beginning of the span */
@@ -131,9 +256,15 @@ struct hoedown_document {
 	hoedown_renderer_data data;
 	metadata * document_metadata;
 	reference * floating_references;
+	reference * external_references;
+	reference ** labels;	/* open-addressed index of the floating, then external references */
+	size_t labels_size;
+	int labels_valid;
 	ext_definition * extensions;
 	toc * table_of_contents;
 	h_counter counter;
+	h_counter counter_start;	/* header numbers every render starts from */
+	html_counter float_counter;
 
 	char * base_folder;
 
@@ -142,7 +273,28 @@ struct hoedown_document {
 	struct footnote_list footnotes_used;
 	uint8_t active_char[256];
 	hoedown_stack work_bufs[2];
+	struct block_frame *frames;	/* innermost last */
+	size_t frames_size;
+	size_t frames_asize;
+	size_t container_bufs;	/* work buffers held by the frames, not counted as nesting */
+	hoedown_stack inline_indexes;
 	hoedown_extensions ext_flags;
+	const uint8_t *source_text;
+	size_t source_text_size;
+	struct source_line *source_map;
+	size_t source_map_size;
+	size_t source_map_asize;
+	hoedown_index *index;
+	hoedown_profile *profile;
+	hoedown_renderer profile_md;	/* renderer callbacks, some of doc->md time them */
+	hoedown_buffer *profile_ob;	/* output of the top-level block being profiled */
+	void (*dependency)(const char *path, void *opaque);
+	void *dependency_opaque;
+	int include_depth;
+	struct stream_state *stream;
+	size_t stream_limit;
+	hoedown_buffer held;	/* rendering hoedown_document_render_to could not fit */
+	hoedown_buffer source;	/* copy of the top-level source, kept between renders */
 	size_t max_nesting;
 	int in_link_body;
 };
@@ -168,8 +320,10 @@ is_separator(uint8_t chr)
 }
 
  static int
- is_regular_file(const char *path, char * base_folder)
+ is_regular_file(const char *path, hoedown_document *doc)
  {
+	char *base_folder = doc->base_folder;
+
  	if (path[0] != '/') {
  		char *cwd;
 
@@ -189,14 +343,19 @@ is_separator(uint8_t chr)
  			strcat(cwd, "/");
  			strcat(cwd, path);
 	 	}
- 		struct stat path_stat;
-	    stat(cwd, &path_stat);
-	    free(cwd);
-	    return S_ISREG(path_stat.st_mode);
+		if (doc->dependency)
+			doc->dependency(cwd, doc->dependency_opaque);
+		struct stat path_stat;
+		int found = stat(cwd, &path_stat) == 0;
+		free(cwd);
+		return found && S_ISREG(path_stat.st_mode);
  	}
 
+	if (doc->dependency)
+		doc->dependency(path, doc->dependency_opaque);
     struct stat path_stat;
-    stat(path, &path_stat);
+    if (stat(path, &path_stat) != 0)
+        return 0;
     return S_ISREG(path_stat.st_mode);
  }
 
@@ -225,6 +384,51 @@ popbuf(hoedown_document *doc, int type)
 	doc->work_bufs[type].size--;
 }
 
+/* container_newbuf • a work buffer held by a block frame until it closes */
+static hoedown_buffer *
+container_newbuf(hoedown_document *doc, int type)
+{
+	doc->container_bufs++;
+	return newbuf(doc, type);
+}
+
+static void
+container_popbuf(hoedown_document *doc, int type)
+{
+	doc->container_bufs--;
+	popbuf(doc, type);
+}
+
+/* push_frame • open a zeroed block frame, returns its index in doc->frames */
+static size_t
+push_frame(hoedown_document *doc, enum block_frame_type type, hoedown_buffer *ob)
+{
+	struct block_frame *frame;
+
+	if (doc->frames_size >= doc->frames_asize) {
+		doc->frames_asize = doc->frames_asize ? doc->frames_asize * 2 : 8;
+		doc->frames = hoedown_realloc(doc->frames, doc->frames_asize * sizeof(struct block_frame));
+	}
+
+	frame = &doc->frames[doc->frames_size];
+	memset(frame, 0, sizeof(struct block_frame));
+	frame->type = type;
+	frame->ob = ob;
+	return doc->frames_size++;
+}
+
+/* push_run • open a run of blocks, parsed once the caller returns to parse_block */
+static void
+push_run(hoedown_document *doc, hoedown_buffer *ob, uint8_t *data, size_t size, int position)
+{
+	size_t top = push_frame(doc, FRAME_RUN, ob);
+	struct block_frame *run = &doc->frames[top];
+
+	run->data = data;
+	run->size = size;
+	run->position = position;
+}
+
 static void
 unscape_text(hoedown_buffer *ob, hoedown_buffer *src)
 {
@@ -252,7 +456,7 @@ hash_link_ref(const uint8_t *link_ref, size_t length)
 	unsigned int hash = 0;
 
 	for (i = 0; i < length; ++i)
-		hash = tolower(link_ref[i]) + (hash << 6) + (hash << 16) - hash;
+		hash = hoedown_tolower(link_ref[i]) + (hash << 6) + (hash << 16) - hash;
 
 	return hash;
 }
@@ -289,6 +493,69 @@ find_link_ref(struct link_ref **references, uint8_t *name, size_t length)
 	return NULL;
 }
 
+/* index_labels • adds the references whose label is not indexed yet */
+static void
+index_labels(hoedown_document *doc, reference *refs)
+{
+	size_t mask = doc->labels_size - 1, slot;
+
+	for (; refs; refs = refs->next) {
+		slot = scidown_hash((uint8_t *)refs->id, strlen(refs->id)) & mask;
+		while (doc->labels[slot] && strcmp(doc->labels[slot]->id, refs->id) != 0)
+			slot = (slot + 1) & mask;
+
+		if (!doc->labels[slot])
+			doc->labels[slot] = refs;
+	}
+}
+
+/* build_labels • indexes the labels of the floating references, then of the external ones */
+static void
+build_labels(hoedown_document *doc)
+{
+	size_t count = 0, size = 16;
+	reference *ref;
+
+	for (ref = doc->floating_references; ref; ref = ref->next)
+		count++;
+	for (ref = doc->external_references; ref; ref = ref->next)
+		count++;
+	while (size < count * 2)
+		size *= 2;
+
+	if (size > doc->labels_size) {
+		free(doc->labels);
+		doc->labels = hoedown_malloc(size * sizeof(reference *));
+		doc->labels_size = size;
+	}
+
+	memset(doc->labels, 0, doc->labels_size * sizeof(reference *));
+	index_labels(doc, doc->floating_references);
+	index_labels(doc, doc->external_references);
+	doc->labels_valid = 1;
+}
+
+/* find_label • returns the reference labelled by the size bytes of id, or NULL */
+static reference *
+find_label(hoedown_document *doc, const uint8_t *id, size_t size)
+{
+	size_t mask, slot;
+	reference *ref;
+
+	if (!doc->labels_valid)
+		build_labels(doc);
+
+	mask = doc->labels_size - 1;
+	slot = scidown_hash(id, size) & mask;
+	while ((ref = doc->labels[slot]) != NULL) {
+		if (strncmp(ref->id, (const char *)id, size) == 0 && ref->id[size] == 0)
+			return ref;
+		slot = (slot + 1) & mask;
+	}
+
+	return NULL;
+}
+
 static void
 free_link_refs(struct link_ref **references)
 {
@@ -353,6 +620,65 @@ find_footnote_ref(struct footnote_list *list, uint8_t *name, size_t length)
 	return NULL;
 }
 
+/* stream_defer • in a streaming render, outputs a placeholder for a reference
+ * that may be defined later in the input; returns 0 if it must be rendered now */
+static int
+stream_defer(hoedown_buffer *ob, hoedown_document *doc, enum stream_ref_type type,
+	const uint8_t *id, size_t id_size, const uint8_t *raw, size_t raw_size)
+{
+	struct stream_state *stream = doc->stream;
+	struct stream_placeholder *ph;
+
+	if (!stream || stream->resolving)
+		return 0;
+
+	/* a single-pass render knows every link and footnote definition,
+	 * a streaming one has no table of contents */
+	if (stream->single ? type == STREAM_LINK || type == STREAM_FOOTNOTE : type == STREAM_TOC)
+		return 0;
+
+	if (stream->count >= stream->asize) {
+		stream->asize = stream->asize ? stream->asize * 2 : 16;
+		stream->placeholders = hoedown_realloc(stream->placeholders,
+			stream->asize * sizeof(struct stream_placeholder));
+	}
+
+	ph = &stream->placeholders[stream->count];
+	ph->type = type;
+	ph->id = hoedown_buffer_new(id_size + 1);
+	hoedown_buffer_put(ph->id, id, id_size);
+	ph->raw = hoedown_buffer_new(raw_size + 1);
+	hoedown_buffer_put(ph->raw, raw, raw_size);
+
+	hoedown_buffer_printf(ob, "%c%zu%c", STREAM_MARK, stream->count, STREAM_MARK);
+	stream->count++;
+	return 1;
+}
+
+/* single_pass_header • in a single-pass render, appends a header to the table of contents */
+static void
+single_pass_header(hoedown_document *doc, size_t level, const uint8_t *title, size_t size)
+{
+	struct stream_state *stream = doc->stream;
+	toc *next;
+
+	if (!stream || !stream->single || level > 3)
+		return;
+
+	next = malloc(sizeof(toc));
+	next->sibling = NULL;
+	next->nesting = level;
+	next->text = malloc(size + 1);
+	memcpy(next->text, title, size);
+	next->text[size] = 0;
+
+	if (stream->toc_last)
+		stream->toc_last->sibling = next;
+	else
+		doc->table_of_contents = next;
+	stream->toc_last = next;
+}
+
 static void
 free_footnote_ref(struct footnote_ref *ref)
 {
@@ -377,28 +703,21 @@ free_footnote_list(struct footnote_list *list, int free_refs)
 
 
 /*
- * Check whether a char is a Markdown spacing char.
-
- * Right now we only consider spaces the actual
- * space and a newline: tabs and carriage returns
- * are filtered out during the preprocessing phase.
+ * Markdown spacing chars (hoedown_ismdspace) are only
+ * the actual space and a newline: tabs and carriage
+ * returns are filtered out during the preprocessing phase.
  *
  * If we wanted to actually be UTF-8 compliant, we
  * should instead extract an Unicode codepoint from
  * this character and check for space properties.
  */
-static int
-_isspace(int c)
-{
-	return c == ' ' || c == '\n';
-}
 
 /* is_empty_all: verify that all the data is spacing */
 static int
 is_empty_all(const uint8_t *data, size_t size)
 {
 	size_t i = 0;
-	while (i < size && _isspace(data[i])) i++;
+	while (i < size && hoedown_ismdspace(data[i])) i++;
 	return i == size;
 }
 
@@ -437,7 +756,7 @@ is_mail_autolink(uint8_t *data, size_t size)
 
 	/* address is assumed to be: [-@._a-zA-Z0-9]+ with exactly one '@' */
 	for (i = 0; i < size; ++i) {
-		if (isalnum(data[i]))
+		if (hoedown_isalnum(data[i]))
 			continue;
 
 		switch (data[i]) {
@@ -487,14 +806,14 @@ tag_length(uint8_t *data, size_t size, hoedown_autolink_type *autolink)
 	/* begins with a '<' optionally followed by '/', followed by letter or number */
         i = (data[1] == '/') ? 2 : 1;
 
-	if (!isalnum(data[i]))
+	if (!hoedown_isalnum(data[i]))
 		return 0;
 
 	/* scheme test */
 	*autolink = HOEDOWN_AUTOLINK_NONE;
 
 	/* try to find the beginning of an URI */
-	while (i < size && (isalnum(data[i]) || data[i] == '.' || data[i] == '+' || data[i] == '-'))
+	while (i < size && (hoedown_isalnum(data[i]) || data[i] == '.' || data[i] == '+' || data[i] == '-'))
 		i++;
 
 	if (i > 1 && data[i] == '@') {
@@ -536,6 +855,149 @@ tag_length(uint8_t *data, size_t size, hoedown_autolink_type *autolink)
 	return i + 1;
 }
 
+/* push_inline_index • makes data the span indexed for the char triggers */
+static void
+push_inline_index(hoedown_document *doc, const uint8_t *data, size_t size)
+{
+	struct inline_index *idx = NULL;
+	hoedown_stack *pool = &doc->inline_indexes;
+
+	if (pool->size < pool->asize &&
+		pool->item[pool->size] != NULL) {
+		idx = pool->item[pool->size++];
+	} else {
+		idx = hoedown_calloc(1, sizeof(struct inline_index));
+		hoedown_stack_push(pool, idx);
+	}
+
+	idx->data = data;
+	idx->size = size;
+	idx->built[DELIM_BACKTICK] = 0;
+	idx->built[DELIM_DOLLAR] = 0;
+}
+
+static void
+pop_inline_index(hoedown_document *doc)
+{
+	doc->inline_indexes.size--;
+}
+
+/* index_block • tells the index sink, if any, that a new block starts */
+static void
+index_block(hoedown_document *doc, hoedown_index_block_type type)
+{
+	if (doc->index)
+		hoedown_index_begin_block(doc->index, type);
+}
+
+/* index_break • keeps the words on both sides of an unindexed span apart */
+static void
+index_break(hoedown_document *doc)
+{
+	if (doc->index)
+		hoedown_index_break(doc->index);
+}
+
+/* build_inline_index • records every delimiter run of the given type in one pass */
+static void
+build_inline_index(struct inline_index *idx, int type)
+{
+	const uint8_t c = (type == DELIM_BACKTICK) ? '`' : '$';
+	const uint8_t *data = idx->data;
+	size_t size = idx->size;
+	size_t i = 0, j, k, text = 0, next[2];
+	struct delim_run *run;
+
+	idx->count[type] = 0;
+	idx->cursor[type] = 0;
+	idx->built[type] = 1;
+
+	while (i < size) {
+		if (data[i] != c) {
+			if (!hoedown_ismdspace(data[i]))
+				text = i + 1;
+			i++;
+			continue;
+		}
+
+		if (idx->count[type] >= idx->asize[type]) {
+			idx->asize[type] = idx->asize[type] ? idx->asize[type] * 2 : 16;
+			idx->runs[type] = hoedown_realloc(idx->runs[type],
+				idx->asize[type] * sizeof(struct delim_run));
+		}
+
+		run = &idx->runs[type][idx->count[type]++];
+		run->start = i;
+		run->text_before = text;
+
+		j = i;
+		while (j > 0 && data[j - 1] == '\\')
+			j--;
+		run->escaped = (i - j) % 2;
+
+		while (i < size && data[i] == c)
+			i++;
+		run->size = i - run->start;
+		text = i;
+
+		j = i;
+		while (j < size && hoedown_ismdspace(data[j]))
+			j++;
+		run->text_after = j;
+	}
+
+	/* link every run to the following ones able to close it: backtick */
+	/* runs to the next one at least as long, dollar runs to the next */
+	/* one holding an unescaped '$' (next[0]) or '$$' (next[1]) */
+	run = idx->runs[type];
+	next[0] = next[1] = DELIM_NONE;
+	for (k = idx->count[type]; k-- > 0; ) {
+		if (type == DELIM_BACKTICK) {
+			j = (k + 1 < idx->count[type]) ? k + 1 : DELIM_NONE;
+			while (j != DELIM_NONE && run[j].size < run[k].size)
+				j = run[j].next[0];
+			run[k].next[0] = j;
+			run[k].next[1] = DELIM_NONE;
+		} else {
+			run[k].next[0] = next[0];
+			run[k].next[1] = next[1];
+			if (run[k].size - run[k].escaped >= 1) next[0] = k;
+			if (run[k].size - run[k].escaped >= 2) next[1] = k;
+		}
+	}
+}
+
+/* find_inline_index • returns the index of the span data belongs to, if any */
+static struct inline_index *
+find_inline_index(hoedown_document *doc, const uint8_t *data, size_t size, int type)
+{
+	struct inline_index *idx = hoedown_stack_top(&doc->inline_indexes);
+
+	if (!idx || data < idx->data || data + size != idx->data + idx->size)
+		return NULL;
+
+	if (!idx->built[type])
+		build_inline_index(idx, type);
+
+	return idx;
+}
+
+/* find_delim_run • returns the first run ending after pos (count if none) */
+static size_t
+find_delim_run(struct inline_index *idx, int type, size_t pos)
+{
+	const struct delim_run *run = idx->runs[type];
+	size_t k = idx->cursor[type];
+
+	while (k > 0 && run[k - 1].start + run[k - 1].size > pos)
+		k--;
+	while (k < idx->count[type] && run[k].start + run[k].size <= pos)
+		k++;
+
+	idx->cursor[type] = k;
+	return k;
+}
+
 /* parse_inline • parses inline markdown elements */
 static void
 parse_inline(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size)
@@ -545,12 +1007,16 @@ parse_inline(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t si
 	uint8_t *active_char = doc->active_char;
 
 	if (doc->work_bufs[BUFFER_SPAN].size +
-		doc->work_bufs[BUFFER_BLOCK].size > doc->max_nesting)
+		doc->work_bufs[BUFFER_BLOCK].size - doc->container_bufs > doc->max_nesting)
 		return;
 
+	push_inline_index(doc, data, size);
+
 	while (i < size) {
-		/* copying inactive chars into the output */
-		while (end < size && active_char[data[end]] == 0)
+		/* copying inactive chars into the output, with the parentheses
+		 * that cannot open a (#label) reference */
+		while (end < size && (active_char[data[end]] == 0 ||
+			(active_char[data[end]] == MD_CHAR_REF && (end + 1 >= size || data[end + 1] != '#'))))
 			end++;
 
 		if (doc->md.normal_text) {
@@ -561,6 +1027,9 @@ parse_inline(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t si
 		else
 			hoedown_buffer_put(ob, data + i, end - i);
 
+		if (doc->index)
+			hoedown_index_text(doc->index, data + i, end - i);
+
 		if (end >= size) break;
 		i = end;
 
@@ -573,6 +1042,8 @@ parse_inline(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t si
 			consumed = i;
 		}
 	}
+
+	pop_inline_index(doc);
 }
 
 /* is_escaped • returns whether special char at data[loc] is escaped by '\\' */
@@ -644,7 +1115,7 @@ find_emph_char(uint8_t *data, size_t size, uint8_t c)
 			}
 
 			i++;
-			while (i < size && _isspace(data[i]))
+			while (i < size && hoedown_ismdspace(data[i]))
 				i++;
 
 			if (i >= size)
@@ -698,10 +1169,10 @@ parse_emph1(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t siz
 		i += len;
 		if (i >= size) return 0;
 
-		if (data[i] == c && !_isspace(data[i - 1])) {
+		if (data[i] == c && !hoedown_ismdspace(data[i - 1])) {
 
 			if (doc->ext_flags & HOEDOWN_EXT_NO_INTRA_EMPHASIS) {
-				if (i + 1 < size && isalnum(data[i + 1]))
+				if (i + 1 < size && hoedown_isalnum(data[i + 1]))
 					continue;
 			}
 
@@ -734,7 +1205,7 @@ parse_emph2(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t siz
 		if (!len) return 0;
 		i += len;
 
-		if (i + 1 < size && data[i] == c && data[i + 1] == c && i && !_isspace(data[i - 1])) {
+		if (i + 1 < size && data[i] == c && data[i + 1] == c && i && !hoedown_ismdspace(data[i - 1])) {
 			work = newbuf(doc, BUFFER_SPAN);
 			parse_inline(work, doc, data, i);
 
@@ -767,7 +1238,7 @@ parse_emph3(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t siz
 		i += len;
 
 		/* skip spacing preceded symbols */
-		if (data[i] != c || _isspace(data[i - 1]))
+		if (data[i] != c || hoedown_ismdspace(data[i - 1]))
 			continue;
 
 		if (i + 2 < size && data[i + 1] == c && data[i + 2] == c && doc->md.triple_emphasis) {
@@ -802,22 +1273,57 @@ parse_math(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offs
 	hoedown_buffer text = { NULL, 0, 0, 0, NULL, NULL, NULL };
 	size_t i = delimsz;
 
+	struct inline_index *idx = NULL;
+	const struct delim_run *run = NULL;
+	size_t pos = 0, k, text_before = 0;
+
 	if (!doc->md.math)
 		return 0;
 
-	/* find ending delimiter */
-	while (1) {
-		while (i < size && data[i] != (uint8_t)end[0])
-			i++;
+	if (end[0] == '$')
+		idx = find_inline_index(doc, data, size, DELIM_DOLLAR);
 
-		if (i >= size)
+	if (idx) {
+		/* closer and context come from the dollar runs of the span */
+		pos = data - idx->data;
+		k = find_delim_run(idx, DELIM_DOLLAR, pos);
+		run = &idx->runs[DELIM_DOLLAR][k];
+		text_before = (pos > run->start) ? pos : run->text_before;
+
+		k = find_delim_run(idx, DELIM_DOLLAR, pos + delimsz);
+		if (k >= idx->count[DELIM_DOLLAR])
 			return 0;
 
-		if (!is_escaped(data, i) && !(i + delimsz > size)
-			&& memcmp(data + i, end, delimsz) == 0)
-			break;
+		run = &idx->runs[DELIM_DOLLAR][k];
+		i = run->start + run->escaped;
+		if (i < pos + delimsz)
+			i = pos + delimsz;
 
-		i++;
+		if (i + delimsz > run->start + run->size) {
+			k = run->next[delimsz - 1];
+			if (k == DELIM_NONE)
+				return 0;
+
+			run = &idx->runs[DELIM_DOLLAR][k];
+			i = run->start + run->escaped;
+		}
+
+		i -= pos;
+	} else {
+		/* find ending delimiter */
+		while (1) {
+			while (i < size && data[i] != (uint8_t)end[0])
+				i++;
+
+			if (i >= size)
+				return 0;
+
+			if (!is_escaped(data, i) && !(i + delimsz > size)
+				&& memcmp(data + i, end, delimsz) == 0)
+				break;
+
+			i++;
+		}
 	}
 
 	/* prepare buffers */
@@ -827,8 +1333,13 @@ parse_math(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offs
 	/* if this is a $$ and MATH_EXPLICIT is not active,
 	 * guess whether displaymode should be enabled from the context */
 	i += delimsz;
-	if (delimsz == 2 && !(doc->ext_flags & HOEDOWN_EXT_MATH_EXPLICIT))
-		displaymode = is_empty_all(data - offset, offset) && is_empty_all(data + i, size - i);
+	if (delimsz == 2 && !(doc->ext_flags & HOEDOWN_EXT_MATH_EXPLICIT)) {
+		if (idx)
+			displaymode = text_before + offset <= pos &&
+				pos + i == run->start + run->size && run->text_after == idx->size;
+		else
+			displaymode = is_empty_all(data - offset, offset) && is_empty_all(data + i, size - i);
+	}
 
 	/* call callback */
 	if (doc->md.math(ob, &text, displaymode, &doc->data))
@@ -868,6 +1379,11 @@ load_file(const char* path, char* base_folder, size_t * size)
 	else
 		f = fopen(path, "rb");
 
+	if (!f) {
+		*size = 0;
+		return NULL;
+	}
+
 	fseek(f, 0, SEEK_END);
 	*size = ftell(f);
 	fseek(f, 0, SEEK_SET);
@@ -880,6 +1396,22 @@ load_file(const char* path, char* base_folder, size_t * size)
 	return string;
 }
 
+/* top_level • whether the current block sits directly in the document, outside containers and spans */
+static int
+top_level(const hoedown_document *doc)
+{
+	size_t i;
+
+	if (doc->include_depth || doc->work_bufs[BUFFER_SPAN].size)
+		return 0;
+
+	for (i = 0; i < doc->frames_size; ++i)
+		if (doc->frames[i].type != FRAME_RUN)
+			return 0;
+
+	return 1;
+}
+
 static size_t
 parse_include(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offset, size_t size)
 {
@@ -898,12 +1430,29 @@ parse_include(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t o
 		char * path = malloc((n+1)*sizeof(uint8_t));
 		path[n] = 0;
 		memcpy(path, data+9, n);
-		if (is_regular_file(path, doc->base_folder)){
+		if (is_regular_file(path, doc)){
 			size_t neu_size = 0;
 			char * buffer = load_file(path, doc->base_folder, &neu_size);
 
-			sub_render(doc, ob, (uint8_t*)buffer, neu_size, 0);
+			if (doc->profile_ob && doc->include_depth == 0)
+				doc->profile->entries[doc->profile->count - 1].type = HOEDOWN_PROFILE_INCLUDE;
+
+			if (doc->md.include && top_level(doc)) {
+				hoedown_buffer *work = newbuf(doc, BUFFER_BLOCK);
 
+				doc->include_depth++;
+				sub_render(doc, work, (uint8_t*)buffer, neu_size, 0);
+				doc->include_depth--;
+
+				if (!doc->md.include(ob, path, work, &doc->data))
+					hoedown_buffer_put(ob, work->data, work->size);
+				popbuf(doc, BUFFER_BLOCK);
+			} else {
+				doc->include_depth++;
+				sub_render(doc, ob, (uint8_t*)buffer, neu_size, 0);
+				doc->include_depth--;
+			}
+			free(buffer);
 		}
 		free(path);
 	}
@@ -919,28 +1468,28 @@ char_emphasis(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t o
 	size_t ret;
 
 	if (doc->ext_flags & HOEDOWN_EXT_NO_INTRA_EMPHASIS) {
-		if (offset > 0 && !_isspace(data[-1]) && data[-1] != '>' && data[-1] != '(')
+		if (offset > 0 && !hoedown_ismdspace(data[-1]) && data[-1] != '>' && data[-1] != '(')
 			return 0;
 	}
 
 	if (size > 2 && data[1] != c) {
 		/* spacing cannot follow an opening emphasis;
 		 * strikethrough and highlight only takes two characters '~~' */
-		if (c == '~' || c == '=' || _isspace(data[1]) || (ret = parse_emph1(ob, doc, data + 1, size - 1, c)) == 0)
+		if (c == '~' || c == '=' || hoedown_ismdspace(data[1]) || (ret = parse_emph1(ob, doc, data + 1, size - 1, c)) == 0)
 			return 0;
 
 		return ret + 1;
 	}
 
 	if (size > 3 && data[1] == c && data[2] != c) {
-		if (_isspace(data[2]) || (ret = parse_emph2(ob, doc, data + 2, size - 2, c)) == 0)
+		if (hoedown_ismdspace(data[2]) || (ret = parse_emph2(ob, doc, data + 2, size - 2, c)) == 0)
 			return 0;
 
 		return ret + 2;
 	}
 
 	if (size > 4 && data[1] == c && data[2] == c && data[3] != c) {
-		if (c == '~' || c == '=' || _isspace(data[3]) || (ret = parse_emph3(ob, doc, data + 3, size - 3, c)) == 0)
+		if (c == '~' || c == '=' || hoedown_ismdspace(data[3]) || (ret = parse_emph3(ob, doc, data + 3, size - 3, c)) == 0)
 			return 0;
 
 		return ret + 3;
@@ -970,21 +1519,43 @@ static size_t
 char_codespan(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offset, size_t size)
 {
 	hoedown_buffer work = { NULL, 0, 0, 0, NULL, NULL, NULL };
+	struct inline_index *idx;
 	size_t end, nb = 0, i, f_begin, f_end;
 
 	/* counting the number of backticks in the delimiter */
 	while (nb < size && data[nb] == '`')
 		nb++;
 
-	/* finding the next delimiter */
-	i = 0;
-	for (end = nb; end < size && i < nb; end++) {
-		if (data[end] == '`') i++;
-		else i = 0;
-	}
+	idx = find_inline_index(doc, data, size, DELIM_BACKTICK);
+	if (idx) {
+		/* the closer is the next run at least nb long */
+		const struct delim_run *run = idx->runs[DELIM_BACKTICK];
+		size_t pos = data - idx->data;
+		size_t k = find_delim_run(idx, DELIM_BACKTICK, pos);
+
+		if (pos == run[k].start)
+			k = run[k].next[0];
+		else
+			k = (k + 1 < idx->count[DELIM_BACKTICK]) ? k + 1 : DELIM_NONE;
+
+		while (k != DELIM_NONE && run[k].size < nb)
+			k = run[k].next[0];
+
+		if (k == DELIM_NONE)
+			return 0; /* no matching delimiter */
+
+		end = run[k].start - pos + nb;
+	} else {
+		/* finding the next delimiter */
+		i = 0;
+		for (end = nb; end < size && i < nb; end++) {
+			if (data[end] == '`') i++;
+			else i = 0;
+		}
 
-	if (i < nb && end >= size)
-		return 0; /* no matching delimiter */
+		if (i < nb && end >= size)
+			return 0; /* no matching delimiter */
+	}
 
 	/* trimming outside spaces */
 	f_begin = nb;
@@ -995,6 +1566,8 @@ char_codespan(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t o
 	while (f_end > nb && data[f_end-1] == ' ')
 		f_end--;
 
+	index_break(doc);
+
 	/* real code span */
 	if (f_begin < f_end) {
 		work.data = data + f_begin;
@@ -1061,7 +1634,6 @@ char_quote(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offs
 static size_t
 char_escape(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offset, size_t size)
 {
-	static const char *escape_chars = "\\`*_{}[]()#+-.!:|&<>^~=\"$";
 	hoedown_buffer work = { 0, 0, 0, 0, NULL, NULL, NULL };
 	size_t w;
 
@@ -1073,7 +1645,7 @@ char_escape(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t off
 			if (w) return w;
 		}
 
-		if (strchr(escape_chars, data[1]) == NULL)
+		if (!hoedown_isactive(data[1]))
 			return 0;
 
 		if (doc->md.normal_text) {
@@ -1105,7 +1677,7 @@ char_entity(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t off
 	if (end < size && data[end] == '#')
 		end++;
 
-	while (end < size && isalnum(data[end]))
+	while (end < size && hoedown_isalnum(data[end]))
 		end++;
 
 	if (end < size && data[end] == ';')
@@ -1191,30 +1763,29 @@ char_autolink_www(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size
 static size_t
 char_ref(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offset, size_t size)
 {
+	hoedown_buffer_small small;
+	hoedown_buffer *id;
+	reference *ref;
+	size_t i;
 
-	if (startsWith("(#", (char*)data)){
-		size_t i;
-		for (i=2; i < size; i++)
-		{
-			if (data[i]==')')
-				break;
-		}
-		char * ref_id = malloc((i-1)*sizeof(char));
-		ref_id[i-2] = 0;
-		memcpy(ref_id, data+2, i-2);
-		int count = 0;
-		if (find_ref(doc->floating_references, ref_id, &count))
-		{
-			if (doc->md.ref)
-				doc->md.ref(ob, ref_id, count);
-			return i+1;
-		} else {
-			if (doc->md.ref)
-				doc->md.ref(ob, ref_id, -1);
-			return i+1;
-		}
+	if (size < 2 || data[1] != '#')
+		return 0;
+
+	for (i = 2; i < size && data[i] != ')'; i++);
+
+	ref = find_label(doc, data + 2, i - 2);
+	if (ref) {
+		if (doc->md.ref)
+			doc->md.ref(ob, ref->id, ref->counter, &doc->data);
+	} else if (!stream_defer(ob, doc, STREAM_FLOAT, data + 2, i - 2, data, i < size ? i + 1 : size) && doc->md.ref) {
+		/* the renderer wants the label NUL-terminated */
+		id = hoedown_buffer_init_small(&small, 64);
+		hoedown_buffer_put(id, data + 2, i - 2);
+		doc->md.ref(ob, (char *)hoedown_buffer_cstr(id), -1, &doc->data);
+		hoedown_buffer_uninit(id);
 	}
-	return 0;
+
+	return i + 1;
 }
 
 static size_t
@@ -1345,8 +1916,12 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 
 		fr = find_footnote_ref(&doc->footnotes_found, id.data, id.size);
 
-		/* mark footnote used */
-		if (fr && !fr->is_used) {
+		/* a streaming render numbers the footnotes as the held output
+		 * is flushed, in reference order even when defined later */
+		if (stream_defer(ob, doc, STREAM_FOOTNOTE, id.data, id.size, data, i)) {
+			ret = 1;
+		} else if (fr && !fr->is_used) {
+			/* mark footnote used */
 			if(!add_footnote_ref(&doc->footnotes_used, fr))
 				goto cleanup;
 			fr->is_used = 1;
@@ -1364,7 +1939,7 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 
 	/* skip any amount of spacing */
 	/* (this is much more laxist than original markdown syntax) */
-	while (i < size && _isspace(data[i]))
+	while (i < size && hoedown_ismdspace(data[i]))
 		i++;
 
 	/* inline style link */
@@ -1374,7 +1949,7 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 		/* skipping initial spacing */
 		i++;
 
-		while (i < size && _isspace(data[i]))
+		while (i < size && hoedown_ismdspace(data[i]))
 			i++;
 
 		link_b = i;
@@ -1392,7 +1967,7 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 				if (nb_p == 0) break;
 				else nb_p--;
 				i++;
-			} else if (i >= 1 && _isspace(data[i-1]) && (data[i] == '\'' || data[i] == '"')) break;
+			} else if (i >= 1 && hoedown_ismdspace(data[i-1]) && (data[i] == '\'' || data[i] == '"')) break;
 			else i++;
 		}
 
@@ -1417,7 +1992,7 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 
 			/* skipping spacing after title */
 			title_e = i - 1;
-			while (title_e > title_b && _isspace(data[title_e]))
+			while (title_e > title_b && hoedown_ismdspace(data[title_e]))
 				title_e--;
 
 			/* checking for closing quote presence */
@@ -1428,7 +2003,7 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 		}
 
 		/* remove spacing at the end of the link */
-		while (link_e > link_b && _isspace(data[link_e - 1]))
+		while (link_e > link_b && hoedown_ismdspace(data[link_e - 1]))
 			link_e--;
 
 		/* remove optional angle brackets around the link */
@@ -1470,8 +2045,14 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 			hoedown_buffer_put(id, data + link_b, link_e - link_b);
 
 		lr = find_link_ref(doc->refs, id->data, id->size);
-		if (!lr)
+		if (!lr) {
+			if (stream_defer(ob, doc, STREAM_LINK, id->data, id->size,
+					data - is_img, i + 1 + is_img)) {
+				i++;
+				ret = 1;
+			}
 			goto cleanup;
+		}
 
 		/* keeping link and title from link_ref */
 		link = lr->link;
@@ -1553,7 +2134,7 @@ char_superscript(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 	} else {
 		sup_start = sup_len = 1;
 
-		while (sup_len < size && !_isspace(data[sup_len]))
+		while (sup_len < size && !hoedown_ismdspace(data[sup_len]))
 			sup_len++;
 	}
 
@@ -1674,12 +2255,12 @@ parse_codefence(uint8_t *data, size_t size, hoedown_buffer *lang, size_t *width,
 	if (i == 0)
 		return 0;
 
-	while (i < size && _isspace(data[i]))
+	while (i < size && hoedown_ismdspace(data[i]))
 		i++;
 
 	lang_start = i;
 
-	while (i < size && !_isspace(data[i]))
+	while (i < size && !hoedown_ismdspace(data[i]))
 		i++;
 
 	lang->data = data + lang_start;
@@ -1871,50 +2452,323 @@ prefix_float(uint8_t * data, size_t size)
 	        startsWith("@toc", txt));
 }
 
-/* parse_block • parsing of one block, returning next uint8_t to parse */
-static void parse_block(hoedown_buffer *ob, hoedown_document *doc,
-			uint8_t *data, size_t size, int position);
+/* add_source_line • records where a line of the preprocessed text comes from */
+static void
+add_source_line(hoedown_document *doc, size_t text, size_t source)
+{
+	if (doc->source_map_size >= doc->source_map_asize) {
+		doc->source_map_asize = doc->source_map_asize ? doc->source_map_asize * 2 : 64;
+		doc->source_map = hoedown_realloc(doc->source_map,
+			doc->source_map_asize * sizeof(struct source_line));
+	}
 
+	doc->source_map[doc->source_map_size].text = text;
+	doc->source_map[doc->source_map_size].source = source;
+	doc->source_map_size++;
+}
 
-/* parse_blockquote • handles parsing of a blockquote fragment */
-static size_t
-parse_blockquote(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size)
+/* source_position • finds the source offset of a top-level block, returns 0 if it is not top-level */
+static int
+source_position(hoedown_document *doc, const uint8_t *data, size_t *offset)
 {
-	size_t beg, end = 0, pre, work_size = 0;
-	uint8_t *work_data = 0;
-	hoedown_buffer *out = 0;
+	size_t lo = 0, hi = doc->source_map_size, mid, text;
 
-	out = newbuf(doc, BUFFER_BLOCK);
-	beg = 0;
-	while (beg < size) {
-		for (end = beg + 1; end < size && data[end - 1] != '\n'; end++);
+	if (!doc->source_text || data < doc->source_text ||
+		data >= doc->source_text + doc->source_text_size ||
+		doc->work_bufs[BUFFER_BLOCK].size || doc->work_bufs[BUFFER_SPAN].size)
+		return 0;
 
-		pre = prefix_quote(data + beg, end - beg);
+	/* last line starting before the block */
+	text = data - doc->source_text;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (doc->source_map[mid].text <= text) lo = mid;
+		else hi = mid;
+	}
 
-		if (pre)
-			beg += pre; /* skipping prefix */
+	if (lo >= doc->source_map_size || doc->source_map[lo].text > text)
+		return 0;
 
-		/* empty line followed by non-quote line */
-		else if (is_empty(data + beg, end - beg) &&
-				(end >= size || (prefix_quote(data + end, size - end) == 0 &&
-				!is_empty(data + end, size - end))))
-			break;
+	*offset = doc->source_map[lo].source + (text - doc->source_map[lo].text);
+	return 1;
+}
 
-		if (beg < end) { /* copy into the in-place working buffer */
-			/* hoedown_buffer_put(work, data + beg, end - beg); */
-			if (!work_data)
-				work_data = data + beg;
-			else if (data + beg != work_data + work_size)
-				memmove(work_data + work_size, data + beg, end - beg);
-			work_size += end - beg;
-		}
-		beg = end;
+/* parse_source_offset • reports the source offset of a top-level block */
+static void
+parse_source_offset(hoedown_buffer *ob, hoedown_document *doc, const uint8_t *data)
+{
+	size_t offset;
+
+	if (source_position(doc, data, &offset))
+		doc->md.source_offset(ob, offset, &doc->data);
+}
+
+/* profile_doc • the document whose renderer data is given, block callbacks always get &doc->data */
+static hoedown_document *
+profile_doc(const hoedown_renderer_data *data)
+{
+	return (hoedown_document *)((char *)data - offsetof(hoedown_document, data));
+}
+
+/* profile_rendered • charges a block callback started at start to the profiled block;
+ * the first callback writing to the top-level output gives the block its type */
+static void
+profile_rendered(hoedown_document *doc, hoedown_buffer *ob, hoedown_profile_block_type type, double start)
+{
+	hoedown_profile_entry *entry;
+
+	if (!doc->profile_ob)
+		return;
+
+	entry = &doc->profile->entries[doc->profile->count - 1];
+	entry->render_time += hoedown_profile_now() - start;
+	if (ob == doc->profile_ob && entry->type == HOEDOWN_PROFILE_OTHER)
+		entry->type = type;
+}
+
+static void
+profile_opn_equation(hoedown_buffer *ob, const char *ref, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.opn_equation(ob, ref, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_EQUATION, start);
+}
+
+static void
+profile_cls_equation(hoedown_buffer *ob, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.cls_equation(ob, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_EQUATION, start);
+}
+
+static void
+profile_open_float(hoedown_buffer *ob, float_args args, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.open_float(ob, args, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_FLOAT, start);
+}
+
+static void
+profile_close_float(hoedown_buffer *ob, float_args args, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.close_float(ob, args, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_FLOAT, start);
+}
+
+static void
+profile_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buffer *lang, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.blockcode(ob, text, lang, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_CODE, start);
+}
+
+static void
+profile_blockquote(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.blockquote(ob, content, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_QUOTE, start);
+}
+
+static void
+profile_header(hoedown_buffer *ob, const hoedown_buffer *content, int level, const hoedown_renderer_data *data, h_counter counter, int numbering)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.header(ob, content, level, data, counter, numbering);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_HEADER, start);
+}
+
+static void
+profile_hrule(hoedown_buffer *ob, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.hrule(ob, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_RULE, start);
+}
+
+static void
+profile_list(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_list_flags flags, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.list(ob, content, flags, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_LIST, start);
+}
+
+static void
+profile_listitem(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_list_flags flags, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.listitem(ob, content, flags, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_LIST, start);
+}
+
+static void
+profile_paragraph(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.paragraph(ob, content, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_PARAGRAPH, start);
+}
+
+static void
+profile_table(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data, hoedown_table_flags *flags, int columns)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.table(ob, content, data, flags, columns);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_TABLE, start);
+}
+
+static void
+profile_table_header(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.table_header(ob, content, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_TABLE, start);
+}
+
+static void
+profile_table_body(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.table_body(ob, content, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_TABLE, start);
+}
+
+static void
+profile_table_row(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.table_row(ob, content, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_TABLE, start);
+}
+
+static void
+profile_table_cell(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_table_flags flags, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.table_cell(ob, content, flags, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_TABLE, start);
+}
+
+static void
+profile_blockhtml(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	doc->profile_md.blockhtml(ob, text, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_HTML, start);
+}
+
+static int
+profile_eq_math(hoedown_buffer *ob, const hoedown_buffer *text, int displaymode, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	int ret = doc->profile_md.eq_math(ob, text, displaymode, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_EQUATION, start);
+	return ret;
+}
+
+static int
+profile_include(hoedown_buffer *ob, const char *path, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	hoedown_document *doc = profile_doc(data);
+	double start = hoedown_profile_now();
+	int ret = doc->profile_md.include(ob, path, content, data);
+	profile_rendered(doc, ob, HOEDOWN_PROFILE_INCLUDE, start);
+	return ret;
+}
+
+/* profile_wrap • times the block callbacks of the renderer, in doc->md */
+static void
+profile_wrap(hoedown_document *doc)
+{
+	hoedown_renderer *md = &doc->md;
+
+	doc->profile_md = doc->md;
+
+	if (md->opn_equation) md->opn_equation = profile_opn_equation;
+	if (md->cls_equation) md->cls_equation = profile_cls_equation;
+	if (md->open_float) md->open_float = profile_open_float;
+	if (md->close_float) md->close_float = profile_close_float;
+	if (md->blockcode) md->blockcode = profile_blockcode;
+	if (md->blockquote) md->blockquote = profile_blockquote;
+	if (md->header) md->header = profile_header;
+	if (md->hrule) md->hrule = profile_hrule;
+	if (md->list) md->list = profile_list;
+	if (md->listitem) md->listitem = profile_listitem;
+	if (md->paragraph) md->paragraph = profile_paragraph;
+	if (md->table) md->table = profile_table;
+	if (md->table_header) md->table_header = profile_table_header;
+	if (md->table_body) md->table_body = profile_table_body;
+	if (md->table_row) md->table_row = profile_table_row;
+	if (md->table_cell) md->table_cell = profile_table_cell;
+	if (md->blockhtml) md->blockhtml = profile_blockhtml;
+	if (md->eq_math) md->eq_math = profile_eq_math;
+	if (md->include) md->include = profile_include;
+}
+
+/* parse_block • parsing of a run of blocks, containers included */
+static void parse_block(hoedown_buffer *ob, hoedown_document *doc,
+			uint8_t *data, size_t size, int position);
+
+
+/* parse_blockquote • opens a blockquote, its contents are parsed by parse_block */
+static size_t
+parse_blockquote(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size)
+{
+	size_t beg, end = 0, pre, work_size = 0, quote;
+	uint8_t *work_data = 0;
+
+	beg = 0;
+	while (beg < size) {
+		for (end = beg + 1; end < size && data[end - 1] != '\n'; end++);
+
+		pre = prefix_quote(data + beg, end - beg);
+
+		if (pre)
+			beg += pre; /* skipping prefix */
+
+		/* empty line followed by non-quote line */
+		else if (is_empty(data + beg, end - beg) &&
+				(end >= size || (prefix_quote(data + end, size - end) == 0 &&
+				!is_empty(data + end, size - end))))
+			break;
+
+		if (beg < end) { /* copy into the in-place working buffer */
+			/* hoedown_buffer_put(work, data + beg, end - beg); */
+			if (!work_data)
+				work_data = data + beg;
+			else if (data + beg != work_data + work_size)
+				memmove(work_data + work_size, data + beg, end - beg);
+			work_size += end - beg;
+		}
+		beg = end;
 	}
 
-	parse_block(out, doc, work_data, work_size, -1);
-	if (doc->md.blockquote)
-		doc->md.blockquote(ob, out, &doc->data);
-	popbuf(doc, BUFFER_BLOCK);
+	quote = push_frame(doc, FRAME_QUOTE, ob);
+	doc->frames[quote].work = container_newbuf(doc, BUFFER_BLOCK);
+	push_run(doc, doc->frames[quote].work, work_data, work_size, -1);
 	return end;
 }
 
@@ -1956,6 +2810,7 @@ parse_paragraph(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 
 	if (!level) {
 		hoedown_buffer *tmp = newbuf(doc, BUFFER_BLOCK);
+		index_block(doc, HOEDOWN_INDEX_PARAGRAPH);
 		parse_inline(tmp, doc, work.data, work.size);
 		if (doc->md.paragraph)
 			doc->md.paragraph(ob, tmp, &doc->data);
@@ -1977,6 +2832,7 @@ parse_paragraph(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 
 			if (work.size > 0) {
 				hoedown_buffer *tmp = newbuf(doc, BUFFER_BLOCK);
+				index_block(doc, HOEDOWN_INDEX_PARAGRAPH);
 				parse_inline(tmp, doc, work.data, work.size);
 
 				if (doc->md.paragraph)
@@ -1990,6 +2846,8 @@ parse_paragraph(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 		}
 
 		header_work = newbuf(doc, BUFFER_SPAN);
+		single_pass_header(doc, level, work.data, work.size);
+		index_block(doc, HOEDOWN_INDEX_HEADER);
 		parse_inline(header_work, doc, work.data, work.size);
 		if (level == 1)
 		{
@@ -2050,10 +2908,8 @@ parse_fencedcode(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 	text.data = data + text_start;
 	text.size = line_start - text_start;
 
-	if (doc->md.blockcode) {
-        printf("xxxooo fun:%s() ob: %p, text: %p, lang: %p, data: %p\n", __FUNCTION__, ob, text.size ? &text : NULL, lang.size ? &lang : NULL, &doc->data);
-        doc->md.blockcode(ob, text.size ? &text : NULL, lang.size ? &lang : NULL, &doc->data);
-    }
+	if (doc->md.blockcode)
+		doc->md.blockcode(ob, text.size ? &text : NULL, lang.size ? &lang : NULL, &doc->data);
 
 	return i;
 }
@@ -2101,13 +2957,14 @@ parse_blockcode(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 
 
 
-/* parse_listitem • parsing of a single list item */
+/* parse_listitem • opens an item of the list frame at index list, */
 /*	assuming initial prefix is already removed */
 static size_t
-parse_listitem(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size, hoedown_list_flags *flags)
+parse_listitem(hoedown_document *doc, size_t list, uint8_t *data, size_t size)
 {
 	hoedown_buffer *work = 0, *inter = 0;
-	size_t beg = 0, end, pre, sublist = 0, orgpre = 0, i;
+	hoedown_list_flags list_flags = doc->frames[list].flags, *flags = &list_flags;
+	size_t beg = 0, end, pre, sublist = 0, orgpre = 0, i, blocks, item;
 	int in_empty = 0, has_inside_empty = 0, in_fence = 0;
 
 	/* keeping track of the first indentation prefix */
@@ -2134,8 +2991,8 @@ parse_listitem(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 		end++;
 
 	/* getting working buffers */
-	work = newbuf(doc, BUFFER_SPAN);
-	inter = newbuf(doc, BUFFER_SPAN);
+	work = container_newbuf(doc, BUFFER_SPAN);
+	inter = container_newbuf(doc, BUFFER_SPAN);
 
 	/* putting the first line into the working buffer */
     hoedown_buffer_put(work, data + beg, end - beg);
@@ -2218,55 +3075,44 @@ parse_listitem(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 	if (has_inside_empty)
 		*flags |= HOEDOWN_LI_BLOCK;
 
-	if (*flags & HOEDOWN_LI_BLOCK) {
-		/* intermediate render of block li */
-		if (sublist && sublist < work->size) {
-			parse_block(inter, doc, work->data, sublist, -1);
-			parse_block(inter, doc, work->data + sublist, work->size - sublist, -1);
-		}
-		else
-			parse_block(inter, doc, work->data, work->size, -1);
+	/* an @include in the first line may push frames, doc->frames moves */
+	doc->frames[list].flags = list_flags;
+
+	if (list_flags & HOEDOWN_LI_BLOCK) {
+		/* block li: the parts before and after the sublist are runs */
+		blocks = 0;
+		if (!sublist || sublist >= work->size)
+			sublist = work->size;
 	} else {
-		/* intermediate render of inline li */
-		if (sublist && sublist < work->size) {
-			parse_inline(inter, doc, work->data, sublist);
-			parse_block(inter, doc, work->data + sublist, work->size - sublist, -1);
-		}
-		else
-			parse_inline(inter, doc, work->data, work->size);
+		/* inline li: the first part is rendered now, the sublist is a run */
+		blocks = sublist && sublist < work->size ? sublist : work->size;
+		index_block(doc, HOEDOWN_INDEX_LIST);
+		parse_inline(inter, doc, work->data, blocks);
+		sublist = work->size;
 	}
 
-	/* render of li itself */
-	if (doc->md.listitem)
-		doc->md.listitem(ob, inter, *flags, &doc->data);
-
-	popbuf(doc, BUFFER_SPAN);
-	popbuf(doc, BUFFER_SPAN);
+	/* the li itself is rendered once its runs are parsed */
+	item = push_frame(doc, FRAME_ITEM, doc->frames[list].ob);
+	doc->frames[item].work = work;
+	doc->frames[item].inter = inter;
+	doc->frames[item].beg = blocks;
+	doc->frames[item].sublist = sublist;
 	return beg;
 }
 
 
-/* parse_list • parsing ordered or unordered list block */
+/* parse_list • opens an ordered or unordered list, its items are parsed */
+/*	by parse_block which also skips the list once its size is known */
 static size_t
 parse_list(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size, hoedown_list_flags flags)
 {
-	hoedown_buffer *work = 0;
-	size_t i = 0, j;
-
-	work = newbuf(doc, BUFFER_BLOCK);
-
-	while (i < size) {
-		j = parse_listitem(work, doc, data + i, size - i, &flags);
-		i += j;
-
-		if (!j || (flags & HOEDOWN_LI_END))
-			break;
-	}
+	size_t list = push_frame(doc, FRAME_LIST, ob);
 
-	if (doc->md.list)
-		doc->md.list(ob, work, flags, &doc->data);
-	popbuf(doc, BUFFER_BLOCK);
-	return i;
+	doc->frames[list].data = data;
+	doc->frames[list].size = size;
+	doc->frames[list].flags = flags;
+	doc->frames[list].work = container_newbuf(doc, BUFFER_BLOCK);
+	return 0;
 }
 
 uint8_t *
@@ -2325,6 +3171,8 @@ parse_atxheader(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 	if (title) {
 		hoedown_buffer *work = newbuf(doc, BUFFER_SPAN);
 
+		single_pass_header(doc, level, title, strlen((char*)title));
+		index_block(doc, HOEDOWN_INDEX_HEADER);
 		parse_inline(work, doc, title, strlen((char*)title));
 
 		if (doc->md.header)
@@ -2332,6 +3180,7 @@ parse_atxheader(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 			doc->md.header(ob, work, (int)level, &doc->data, doc->counter, doc->document_metadata->numbering);
 		}
 		popbuf(doc, BUFFER_SPAN);
+		free(title);
 	}
 
 	return skip;
@@ -2566,7 +3415,7 @@ parse_table_row(
 
 		cell_work = newbuf(doc, BUFFER_SPAN);
 
-		while (i < size && _isspace(data[i]))
+		while (i < size && hoedown_ismdspace(data[i]))
 			i++;
 
 		cell_start = i;
@@ -2584,9 +3433,10 @@ parse_table_row(
 
 		cell_end = i - 1;
 
-		while (cell_end > cell_start && _isspace(data[cell_end]))
+		while (cell_end > cell_start && hoedown_ismdspace(data[cell_end]))
 			cell_end--;
 
+		index_block(doc, HOEDOWN_INDEX_TABLE);
 		parse_inline(cell_work, doc, data + cell_start, 1 + cell_end - cell_start);
 		doc->md.table_cell(row_work, cell_work, col_data[col] | header_flag, &doc->data);
 
@@ -2626,7 +3476,7 @@ parse_table_header(
 
 	header_end = i;
 
-	while (header_end > 0 && _isspace(data[header_end - 1]))
+	while (header_end > 0 && hoedown_ismdspace(data[header_end - 1]))
 		header_end--;
 
 	if (data[0] == '|')
@@ -2777,19 +3627,12 @@ parse_abstract(
 	}
 
 
+	/* the keywords and the closing follow the contents, see resume_container */
 	if (doc->md.abstract)
 	{
 		doc->md.abstract(ob);
-		parse_block(ob, doc, data, skip, -1);
-		if (doc->md.keywords && doc->document_metadata->keywords)
-		{
-			hoedown_buffer * b = hoedown_buffer_new(1);
-			hoedown_buffer_puts(b, doc->document_metadata->keywords);
-			doc->md.keywords(ob,b,NULL);
-			hoedown_buffer_free(b);
-
-		}
-		doc->md.close(ob);
+		push_frame(doc, FRAME_ABSTRACT, ob);
+		push_run(doc, ob, data, skip, -1);
 	}
 	if (skip < size)
 	{
@@ -2811,14 +3654,16 @@ parse_caption(hoedown_document *doc,
 		i++;
 	}
 	if (i) {
-		hoedown_buffer * buf = hoedown_buffer_new(1);
+		hoedown_buffer_small small;
+		hoedown_buffer * buf = hoedown_buffer_init_small(&small, 64);
+		index_block(doc, HOEDOWN_INDEX_CAPTION);
 		parse_inline(buf, doc, data, i);
 		uint8_t * tmp = malloc(sizeof(uint8_t) * (buf->size+1));
 		tmp[buf->size] = 0;
 		memcpy(tmp, buf->data, buf->size);
 		// clean escape chars 
 		tmp = (uint8_t*)clean_string((char*)tmp, buf->size);
-		hoedown_buffer_free(buf);
+		hoedown_buffer_uninit(buf);
 		return tmp;
 	}
 	return NULL;
@@ -2833,7 +3678,7 @@ parse_fl(
     float_type type)
 {
 	size_t begin = 0;
-	size_t skip = 0;
+	size_t skip = 0, i;
 	float_args args = {};
 	args.type = type;
 	args.caption = NULL;
@@ -2856,6 +3701,7 @@ parse_fl(
 	{
 		if (startsWith("\n@caption(",(char*) data+skip+begin))
 		{
+			free(args.caption);
 			args.caption = (char*)parse_caption(doc, data+skip+begin+10, size-begin-skip-10);
 		}
 		skip ++;
@@ -2864,9 +3710,16 @@ parse_fl(
 
 	if (doc->md.open_float)
 	{
+		/* the frame owns args until close_float */
 		doc->md.open_float(ob, args, &doc->data);
-		parse_block(ob, doc, data+begin, skip, -1);
-		doc->md.close_float(ob, args, &doc->data);
+		i = push_frame(doc, FRAME_FLOAT, ob);
+		doc->frames[i].args = args;
+		push_run(doc, ob, data+begin, skip, -1);
+	}
+	else
+	{
+		free(args.id);
+		free(args.caption);
 	}
 	if (skip < size)
 	{
@@ -2905,13 +3758,16 @@ parse_eq(
 
 	if (doc->md.opn_equation && skip)
 	{
+		hoedown_buffer text = { NULL, 0, 0, 0, NULL, NULL, NULL };
 		doc->md.opn_equation(ob, args.id, &doc->data);
-		hoedown_buffer * text = hoedown_buffer_new(skip);
-		hoedown_buffer_put(text, data+begin, skip);
+		/* renderers only read the equation, no need for a copy */
+		text.data = data + begin;
+		text.size = skip;
 		if (doc->md.eq_math)
-			doc->md.eq_math(ob, text, 2, &doc->data);
+			doc->md.eq_math(ob, &text, 2, &doc->data);
 		doc->md.cls_equation(ob, &doc->data);
 	}
+	free(args.id);
 	if (skip < size)
 	{
 		skip += 4;
@@ -2927,6 +3783,10 @@ parse_float(
 	uint8_t *data,
 	size_t size)
 {
+	/* a single-pass render numbers the floats as it meets them */
+	if (doc->stream && doc->stream->single)
+		look_for_ref(doc, data, size, &doc->stream->floats);
+
 	if (startsWith("@abstract", (char*)data) && is_separator(data[9])) {
 		return parse_abstract(ob, doc, data+9,size-9)+9;
 	}
@@ -2944,8 +3804,8 @@ parse_float(
 	}
 	if (startsWith("@toc", (char*)data) && is_separator(data[4]))
 	{
-		if (doc->md.toc && doc->table_of_contents)
-			doc->md.toc(ob, doc->table_of_contents, doc->document_metadata->numbering);
+		if (doc->md.toc && !stream_defer(ob, doc, STREAM_TOC, data, 0, data, 4) && doc->table_of_contents)
+			doc->md.toc(ob, doc->table_of_contents, doc->document_metadata->numbering, &doc->data);
 		return 4;
 	}
 
@@ -2959,74 +3819,196 @@ parse_position(hoedown_buffer *ob, hoedown_document *doc){
 	}
 }
 
-/* parse_block • parsing of one block, returning next uint8_t to parse */
+/* parse_run_block • parsing of the next block of the run at index top */
 static void
-parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size, int position)
+parse_run_block(hoedown_document *doc, size_t top)
 {
-	size_t beg, end, i;
-	uint8_t *txt_data;
-	beg = 0;
+	struct block_frame *run = &doc->frames[top];
+	hoedown_buffer *ob = run->ob;
+	uint8_t *data = run->data, *txt_data;
+	size_t beg = run->beg, end, i, offset;
+	hoedown_profile_entry *entry;
+
+	if (run->position >= 0 && beg >= (size_t)run->position) {
+		run->position = -1;
+		parse_position(ob, doc);
+	}
+	txt_data = data + beg;
+	end = run->size - beg;
+
+	if (doc->md.source_offset && !is_empty(txt_data, end))
+		parse_source_offset(ob, doc, txt_data);
+
+	if (doc->profile && !doc->profile_ob && (!doc->stream || doc->stream->single) &&
+		!is_empty(txt_data, end) && source_position(doc, txt_data, &offset)) {
+		entry = hoedown_profile_add(doc->profile);
+		entry->source_begin = offset;
+		doc->profile_ob = ob;
+		run->profiled = 1;
+		run->output = ob->size;
+		run->start = hoedown_profile_now();
+	}
 
-	if (doc->work_bufs[BUFFER_SPAN].size +
-		doc->work_bufs[BUFFER_BLOCK].size > doc->max_nesting)
-		return;
+	/* containers push frames, run points nowhere past this line */
+	if (is_atxheader(doc, txt_data, end))
+		i = parse_atxheader(ob, doc, txt_data, end);
 
-	while (beg < size) {
-		if (position >= 0 && beg >= position) {
-			position = -1;
-			parse_position(ob, doc);
-		}
-		txt_data = data + beg;
-		end = size - beg;
+	else if (data[beg] == '<' && doc->md.blockhtml &&
+			(i = parse_htmlblock(ob, doc, txt_data, end, 1)) != 0)
+		;
+
+	else if ((i = is_empty(txt_data, end)) != 0)
+		;
+
+	else if (is_hrule(txt_data, end)) {
+		if (doc->md.hrule)
+			doc->md.hrule(ob, &doc->data);
+
+		for (i = 0; i < end && txt_data[i] != '\n'; i++);
+		i++;
+	}
+
+	else if ((doc->ext_flags & HOEDOWN_EXT_FENCED_CODE) != 0 &&
+		(i = parse_fencedcode(ob, doc, txt_data, end)) != 0)
+		;
 
-		if (is_atxheader(doc, txt_data, end))
-			beg += parse_atxheader(ob, doc, txt_data, end);
+	else if ((doc->ext_flags & HOEDOWN_EXT_TABLES) != 0 &&
+		(i = parse_table(ob, doc, txt_data, end)) != 0)
+		;
 
-		else if (data[beg] == '<' && doc->md.blockhtml &&
-				(i = parse_htmlblock(ob, doc, txt_data, end, 1)) != 0)
-			beg += i;
+	else if (prefix_quote(txt_data, end))
+		i = parse_blockquote(ob, doc, txt_data, end);
 
-		else if ((i = is_empty(txt_data, end)) != 0)
-			beg += i;
+	else if (!(doc->ext_flags & HOEDOWN_EXT_DISABLE_INDENTED_CODE) && prefix_code(txt_data, end))
+		i = parse_blockcode(ob, doc, txt_data, end);
 
-		else if (is_hrule(txt_data, end)) {
-			if (doc->md.hrule)
-				doc->md.hrule(ob, &doc->data);
+	else if (prefix_float(txt_data, end))
+		i = parse_float(ob, doc, txt_data, end);
 
-			while (beg < size && data[beg] != '\n')
-				beg++;
+	else if (prefix_uli(txt_data, end))
+		i = parse_list(ob, doc, txt_data, end, 0);
+
+	else if (prefix_oli(txt_data, end))
+		i = parse_list(ob, doc, txt_data, end, HOEDOWN_LIST_ORDERED);
+
+	else
+		i = parse_paragraph(ob, doc, txt_data, end);
+
+	doc->frames[top].beg += i;
+}
+
+/* resume_run • ends the profiling of the block just parsed, then parses the */
+/*	next block of the run or closes it */
+static void
+resume_run(hoedown_document *doc, size_t top)
+{
+	struct block_frame *run = &doc->frames[top];
+	hoedown_profile_entry *entry;
+
+	if (run->profiled) {
+		entry = &doc->profile->entries[doc->profile->count - 1];
+		entry->parse_time = hoedown_profile_now() - run->start - entry->render_time;
+		entry->output_size = run->ob->size - run->output;
+		doc->profile_ob = NULL;
+		run->profiled = 0;
+	}
+
+	if (run->beg < run->size) {
+		parse_run_block(doc, top);
+		return;
+	}
+
+	if (run->position > 0)
+		parse_position(run->ob, doc);
+	doc->frames_size--;
+}
+
+/* resume_container • the run of a container is over: parses the next part */
+/*	of an item or the next item of a list, or renders and closes the container */
+static void
+resume_container(hoedown_document *doc, size_t top)
+{
+	struct block_frame *frame = &doc->frames[top], *list;
+	size_t i, beg, end;
+
+	switch (frame->type) {
+	case FRAME_QUOTE:
+		if (doc->md.blockquote)
+			doc->md.blockquote(frame->ob, frame->work, &doc->data);
+		container_popbuf(doc, BUFFER_BLOCK);
+		break;
+
+	case FRAME_LIST:
+		if (frame->beg < frame->size && !(frame->flags & HOEDOWN_LI_END) &&
+			(i = parse_listitem(doc, top, frame->data + frame->beg, frame->size - frame->beg)) != 0) {
+			doc->frames[top].beg += i;
+			return;
+		}
 
-			beg++;
+		if (doc->md.list)
+			doc->md.list(frame->ob, frame->work, frame->flags, &doc->data);
+		container_popbuf(doc, BUFFER_BLOCK);
+
+		/* the run below skips the list now that its size is known */
+		doc->frames[top - 1].beg += frame->beg;
+		break;
+
+	case FRAME_ITEM:
+		if (frame->beg < frame->work->size) {
+			beg = frame->beg;
+			end = beg < frame->sublist ? frame->sublist : frame->work->size;
+			frame->beg = end;
+			push_run(doc, frame->inter, frame->work->data + beg, end - beg, -1);
+			return;
 		}
 
-		else if ((doc->ext_flags & HOEDOWN_EXT_FENCED_CODE) != 0 &&
-			(i = parse_fencedcode(ob, doc, txt_data, end)) != 0)
-			beg += i;
+		list = &doc->frames[top - 1];
+		if (doc->md.listitem)
+			doc->md.listitem(list->work, frame->inter, list->flags, &doc->data);
+		container_popbuf(doc, BUFFER_SPAN);
+		container_popbuf(doc, BUFFER_SPAN);
+		break;
 
-		else if ((doc->ext_flags & HOEDOWN_EXT_TABLES) != 0 &&
-			(i = parse_table(ob, doc, txt_data, end)) != 0)
-			beg += i;
+	case FRAME_FLOAT:
+		doc->md.close_float(frame->ob, frame->args, &doc->data);
+		free(frame->args.id);
+		free(frame->args.caption);
+		break;
 
-		else if (prefix_quote(txt_data, end))
-			beg += parse_blockquote(ob, doc, txt_data, end);
+	case FRAME_ABSTRACT:
+		if (doc->md.keywords && doc->document_metadata->keywords)
+		{
+			hoedown_buffer_small small;
+			hoedown_buffer * b = hoedown_buffer_init_small(&small, 64);
+			hoedown_buffer_puts(b, doc->document_metadata->keywords);
+			doc->md.keywords(frame->ob, b, &doc->data);
+			hoedown_buffer_uninit(b);
+		}
+		doc->md.close(frame->ob);
+		break;
 
-		else if (!(doc->ext_flags & HOEDOWN_EXT_DISABLE_INDENTED_CODE) && prefix_code(txt_data, end))
-			beg += parse_blockcode(ob, doc, txt_data, end);
+	default:
+		break;
+	}
 
-		else if (prefix_float(txt_data, end))
-			beg += parse_float(ob, doc, txt_data, end);
+	doc->frames_size--;
+}
 
-		else if (prefix_uli(txt_data, end))
-			beg += parse_list(ob, doc, txt_data, end, 0);
+/* parse_block • parsing of a run of blocks; containers do not recurse but */
+/*	push their contents on doc->frames, parsed here innermost first */
+static void
+parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size, int position)
+{
+	size_t base = doc->frames_size, top;
 
-		else if (prefix_oli(txt_data, end))
-			beg += parse_list(ob, doc, txt_data, end, HOEDOWN_LIST_ORDERED);
+	push_run(doc, ob, data, size, position);
 
+	while (doc->frames_size > base) {
+		top = doc->frames_size - 1;
+		if (doc->frames[top].type == FRAME_RUN)
+			resume_run(doc, top);
 		else
-			beg += parse_paragraph(ob, doc, txt_data, end);
-	}
-	if (position > 0) {
-		parse_position(ob, doc);
+			resume_container(doc, top);
 	}
 }
 
@@ -3035,11 +4017,11 @@ parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t siz
 /*********************
  * REFERENCE PARSING *
  *********************/
-void load_notes(const uint8_t * text, size_t size,  char* base_folder, struct footnote_list *list);
+void load_notes(const uint8_t * text, size_t size, hoedown_document *doc, struct footnote_list *list);
 
 /* is_footnote • returns whether a line is a footnote definition or not */
 static int
-is_footnote(const uint8_t *data, size_t beg, size_t end, size_t *last, char* base_folder, struct footnote_list *list)
+is_footnote(const uint8_t *data, size_t beg, size_t end, size_t *last, hoedown_document *doc, struct footnote_list *list)
 {
 	if (startsWith("@bib(", (char*)data+beg))
 		{
@@ -3058,10 +4040,10 @@ is_footnote(const uint8_t *data, size_t beg, size_t end, size_t *last, char* bas
 				char * path = malloc((n+1)*sizeof(char));
 				path[n] = 0;
 				strncpy(path, (char*)data+beg+5, n);
-				if (is_regular_file(path, base_folder)){
+				if (is_regular_file(path, doc)){
 					size_t size = 0;
-					char * bib = load_file(path, base_folder, &size);
-					load_notes((uint8_t*)bib, size, base_folder, list);
+					char * bib = load_file(path, doc->base_folder, &size);
+					load_notes((uint8_t*)bib, size, doc, list);
 					free(bib);
 				}
 				free(path);
@@ -3292,7 +4274,7 @@ is_ref(const uint8_t *data, size_t beg, size_t end, size_t *last, struct link_re
 
 
 void
-load_notes(const uint8_t * data, size_t size,  char* base_folder, struct footnote_list *list)
+load_notes(const uint8_t * data, size_t size, hoedown_document *doc, struct footnote_list *list)
 {
 	static const uint8_t UTF8_BOM[] = {0xEF, 0xBB, 0xBF};
 	size_t beg, end;
@@ -3304,7 +4286,7 @@ load_notes(const uint8_t * data, size_t size,  char* base_folder, struct footnot
 
 	while (beg < size) /* iterating over lines */
 	{
-		if (is_footnote(data, beg, size, &end, base_folder, list))
+		if (is_footnote(data, beg, size, &end, doc, list))
 			beg = end;
 		else { /* skipping to the next line */
 			end = beg;
@@ -3375,8 +4357,14 @@ hoedown_document_new(
 	doc->base_folder = (base_folder != NULL) ? strdup (base_folder) : NULL;
 
 	doc->counter = (h_counter){0, 0, 0};
+	doc->counter_start = doc->counter;
+	doc->float_counter = (html_counter){0, 0, 0, 0};
 
 	doc->floating_references = NULL;
+	doc->external_references = NULL;
+	doc->labels = NULL;
+	doc->labels_size = 0;
+	doc->labels_valid = 0;
 	doc->document_metadata = NULL;
 	doc->table_of_contents = NULL;
 	doc->data.opaque = renderer->opaque;
@@ -3384,6 +4372,27 @@ hoedown_document_new(
 
 	hoedown_stack_init(&doc->work_bufs[BUFFER_BLOCK], 4);
 	hoedown_stack_init(&doc->work_bufs[BUFFER_SPAN], 8);
+	hoedown_stack_init(&doc->inline_indexes, 8);
+	doc->frames = NULL;
+	doc->frames_size = 0;
+	doc->frames_asize = 0;
+	doc->container_bufs = 0;
+
+	doc->source_text = NULL;
+	doc->source_text_size = 0;
+	doc->source_map = NULL;
+	doc->source_map_size = 0;
+	doc->source_map_asize = 0;
+	doc->index = NULL;
+	doc->profile = NULL;
+	doc->profile_ob = NULL;
+	doc->dependency = NULL;
+	doc->dependency_opaque = NULL;
+	doc->include_depth = 0;
+	doc->stream = NULL;
+	doc->stream_limit = 0;
+	hoedown_buffer_init(&doc->held, 64, hoedown_realloc, free, NULL);
+	hoedown_buffer_init(&doc->source, 64, hoedown_realloc, free, NULL);
 
 	memset(doc->active_char, 0x0, 256);
 
@@ -3457,20 +4466,14 @@ skip_yaml(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t
 	return skip;
 }
 
-void
-sub_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position)
+/* strip_definitions • copies data into text without the link references
+ * and footnote definitions, which are recorded; returns how many were found */
+static size_t
+strip_definitions(hoedown_document *doc, hoedown_buffer *text, const uint8_t *data, size_t size, int map_source)
 {
 	static const uint8_t UTF8_BOM[] = {0xEF, 0xBB, 0xBF};
 
-	hoedown_buffer *text;
-	size_t beg, end;
-	text = hoedown_buffer_new(64);
-
-	/* Preallocate enough space for our buffer to avoid expanding while copying */
-	hoedown_buffer_grow(text, size);
-	/* first pass: looking for references, copying everything else */
-	beg = 0;
-
+	size_t beg = 0, end, found = 0;
 	int footnotes_enabled = doc->ext_flags & HOEDOWN_EXT_FOOTNOTES;
 
 	/* Skip a possible UTF-8 BOM, even though the Unicode standard
@@ -3479,15 +4482,20 @@ sub_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_
 		beg += 3;
 
 	while (beg < size) /* iterating over lines */
-		if (footnotes_enabled && is_footnote(data, beg, size, &end, doc->base_folder, &doc->footnotes_found))
+		if (footnotes_enabled && is_footnote(data, beg, size, &end, doc, &doc->footnotes_found)) {
 			beg = end;
-		else if (is_ref(data, beg, size, &end, doc->refs))
+			found++;
+		} else if (is_ref(data, beg, size, &end, doc->refs)) {
 			beg = end;
-		else { /* skipping to the next line */
+			found++;
+		} else { /* skipping to the next line */
 			end = beg;
 			while (end < size && data[end] != '\n' && data[end] != '\r')
 				end++;
 
+			if (map_source)
+				add_source_line(doc, text->size, beg);
+
 			/* adding the line body if present */
 			if (end > beg)
 				expand_tabs(text, data + beg, end - beg);
@@ -3502,8 +4510,39 @@ sub_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_
 			beg = end;
 		}
 
-	/* pre-grow the output buffer to minimize allocations */
-	hoedown_buffer_grow(ob, text->size + (text->size >> 1));
+	return found;
+}
+
+void
+sub_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position)
+{
+	hoedown_buffer *text;
+
+	/* includes render while the top-level copy is in use */
+	if (doc->include_depth) {
+		text = hoedown_buffer_new(64);
+	} else {
+		text = &doc->source;
+		text->size = 0;
+	}
+
+	/* Preallocate enough space for our buffer to avoid expanding while copying */
+	hoedown_buffer_grow(text, size);
+
+	/* source offsets are only tracked for the top-level document */
+	int map_source = (doc->md.source_offset || doc->profile) &&
+		!doc->work_bufs[BUFFER_BLOCK].size && !doc->work_bufs[BUFFER_SPAN].size;
+
+	if (map_source)
+		doc->source_map_size = 0;
+
+	/* first pass: looking for references, copying everything else */
+	strip_definitions(doc, text, data, size, map_source);
+
+	/* pre-grow the output buffer to minimize allocations, unless it borrows
+	 * storage the output may well fit in */
+	if (!hoedown_buffer_fixed(ob))
+		hoedown_buffer_grow(ob, text->size + (text->size >> 1));
 
 	/* second pass: actual rendering */
 	if (doc->md.doc_header)
@@ -3515,9 +4554,23 @@ sub_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_
 		if (text->data[text->size - 1] != '\n' &&  text->data[text->size - 1] != '\r')
 			hoedown_buffer_putc(text, '\n');
 
+		/* block parsers compare prefixes with strncmp */
+		hoedown_buffer_grow(text, text->size + 1);
+		text->data[text->size] = '\0';
+
+		if (map_source) {
+			doc->source_text = text->data;
+			doc->source_text_size = text->size;
+		}
+
 		parse_block(ob, doc, text->data+skip, text->size-skip, position-skip);
+
+		if (map_source)
+			doc->source_text = NULL;
 	}
-	hoedown_buffer_free(text);
+
+	if (text != &doc->source)
+		hoedown_buffer_free(text);
 }
 
 int parse_keyword(char * keyword, metadata * meta,  const uint8_t *data, size_t size)
@@ -3555,15 +4608,16 @@ int parse_keyword(char * keyword, metadata * meta,  const uint8_t *data, size_t
 		meta->style = word;
 	} else if (!strcmp(keyword, "affiliation")) {
 		meta->affiliation = word;
-	} else if (!strcmp(keyword, "numbering")) {
-		meta->numbering = !strcmp(word, "true");
-	} else if (!strcmp(keyword, "paper")) {
-		meta->paper_size = string_to_paper(word);
-	} else if (!strcmp(keyword, "class")) {
-		meta->doc_class = string_to_class(word);
-	} else if (!strcmp(keyword, "font-size")) {
-		meta->font_size = atoi(word);
-	}else {
+	} else {
+		if (!strcmp(keyword, "numbering")) {
+			meta->numbering = !strcmp(word, "true");
+		} else if (!strcmp(keyword, "paper")) {
+			meta->paper_size = string_to_paper(word);
+		} else if (!strcmp(keyword, "class")) {
+			meta->doc_class = string_to_class(word);
+		} else if (!strcmp(keyword, "font-size")) {
+			meta->font_size = atoi(word);
+		}
 		free(word);
 	}
 
@@ -3575,10 +4629,9 @@ append(reference * head, reference * next)
 {
 	if (!head)
 		return;
-	if (head->next)
-		append(head->next, next);
-	else
-		head->next = next;
+	while (head->next)
+		head = head->next;
+	head->next = next;
 }
 
 reference *
@@ -3597,11 +4650,10 @@ add_reference(char * id, int counter, float_type type, reference * ref)
 	return next;
 }
 
-metadata *
-parse_yaml(const uint8_t *data, size_t size)
+/* read_yaml • fills meta with the defaults, then with the front matter of data */
+static void
+read_yaml(metadata *meta, const uint8_t *data, size_t size)
 {
-	metadata * meta = malloc(sizeof(metadata));
-
 	meta->keywords = NULL;
 	meta->authors = NULL;
 	meta->style = NULL;
@@ -3631,49 +4683,56 @@ parse_yaml(const uint8_t *data, size_t size)
             i+=j+3;
 		}
 	}
-	return meta;
 }
 
-void
-render_metadata(hoedown_document *doc, hoedown_buffer *ob, metadata * meta)
+metadata *
+parse_yaml(const uint8_t *data, size_t size)
 {
+	metadata * meta = malloc(sizeof(metadata));
+
+	read_yaml(meta, data, size);
+	return meta;
+}
+
+/* load_metadata • reads the front matter into the metadata of doc, which
+ * the first render allocates and the next ones reuse */
+static metadata *
+load_metadata(hoedown_document *doc, const uint8_t *data, size_t size)
+{
+	if (!doc->document_metadata)
+		doc->document_metadata = malloc(sizeof(metadata));
+
+	read_yaml(doc->document_metadata, data, size);
+	doc->data.meta = doc->document_metadata;
+	return doc->document_metadata;
+}
+
+void
+render_metadata(hoedown_document *doc, hoedown_buffer *ob, metadata * meta)
+{
+
+	hoedown_buffer_small small;
 
 	if (meta->title != NULL && doc->md.title)
 	{
-		hoedown_buffer * b = hoedown_buffer_new(1);
+		hoedown_buffer * b = hoedown_buffer_init_small(&small, 64);
 		hoedown_buffer_puts(b, meta->title);
 		doc->md.title(ob,b, meta);
-		hoedown_buffer_free(b);
+		hoedown_buffer_uninit(b);
 	}
 	if (meta->authors != NULL && doc->md.authors)
 	{
-		hoedown_buffer * b = hoedown_buffer_new(1);
-
 		doc->md.authors(ob,meta->authors);
-		hoedown_buffer_free(b);
 	}
 	if (meta->affiliation != NULL && doc->md.affiliation)
 	{
-		hoedown_buffer * b = hoedown_buffer_new(1);
+		hoedown_buffer * b = hoedown_buffer_init_small(&small, 64);
 		hoedown_buffer_puts(b, meta->affiliation);
-		doc->md.affiliation(ob,b,NULL);
-		hoedown_buffer_free(b);
+		doc->md.affiliation(ob, b, &doc->data);
+		hoedown_buffer_uninit(b);
 	}
 
 }
-int find_ref(reference * refs, char*id, int *counter)
-{
-	if (!refs)
-		return 0;
-
-	if (strcmp(refs->id, id) == 0)
-	{
-
-		*counter = refs->counter;
-		return 1;
-	}
-	return find_ref(refs->next, id, counter);
-}
 
 void
 check_for_ref(hoedown_document *doc, const uint8_t *data, size_t size, html_counter * counter, float_type type)
@@ -3716,6 +4775,7 @@ check_for_ref(hoedown_document *doc, const uint8_t *data, size_t size, html_coun
 				memset(id, 0, i);
 				memcpy(id, data+1, i-1);
 				doc->floating_references = add_reference(id, c, type, doc->floating_references);
+				doc->labels_valid = 0;
 			}
 		}
 	}
@@ -3745,7 +4805,7 @@ look_for_ref(hoedown_document *doc, const uint8_t *data, size_t size, html_count
 }
 
 char*
-load_text(uint8_t *data, size_t size, char* base_folder, size_t * new_size)
+load_text(uint8_t *data, size_t size, hoedown_document *doc, size_t * new_size)
 {
 	/* @include(path) */
 	size_t i = 9;
@@ -3763,9 +4823,9 @@ load_text(uint8_t *data, size_t size, char* base_folder, size_t * new_size)
 		char * path = malloc((n+1)*sizeof(uint8_t));
 		path[n] = 0;
 		memcpy(path, data+9, n);
-		if (is_regular_file(path, base_folder)){
+		if (is_regular_file(path, doc)){
 
-			char * buffer = load_file(path, base_folder, new_size);
+			char * buffer = load_file(path, doc->base_folder, new_size);
 			free(path);
 			return buffer;
 		}
@@ -3789,7 +4849,7 @@ find_references(hoedown_document *doc, const uint8_t *data, size_t size, html_co
 		else if (startsWith("@include(", (char*) data+i))
 		{
 			size_t text_size;
-			char * text = load_text((uint8_t*)data+i, size-i, doc->base_folder, &text_size);
+			char * text = load_text((uint8_t*)data+i, size-i, doc, &text_size);
 			if (text_size && text)
 			{
 				find_references(doc,(const uint8_t*) text, text_size, counter);
@@ -3846,9 +4906,7 @@ generate_toc(hoedown_document * doc, const uint8_t * data, size_t size, toc* par
 				} else if (i > 0 && is_headerline((uint8_t*)data+i, size-i)){
 					size_t j = i - 1;
 					int somechar = 0;
-					while (data[j - 1] != '\n') {
-						if (j == 0)
-							break;
+					while (j > 0 && data[j - 1] != '\n') {
 						if (!is_separator(data[j -1]))
 							somechar = 1;
 						j --;
@@ -3883,7 +4941,7 @@ generate_toc(hoedown_document * doc, const uint8_t * data, size_t size, toc* par
 		if (!code_block && data[i] == '@' && startsWith("@include(", (char*)data+i))
 		{
 			size_t text_size;
-			char * text = load_text((uint8_t*)data+i, size-i, doc->base_folder, &text_size);
+			char * text = load_text((uint8_t*)data+i, size-i, doc, &text_size);
 			if (text_size && text)
 			{
 
@@ -3892,6 +4950,8 @@ generate_toc(hoedown_document * doc, const uint8_t * data, size_t size, toc* par
 				{
 					root = t;
 				}
+				/* continue after the headers of the included file */
+				for (current = t; current && current->sibling; current = current->sibling);
 				free(text);
 			}
 		}
@@ -3900,16 +4960,358 @@ generate_toc(hoedown_document * doc, const uint8_t * data, size_t size, toc* par
 }
 
 
+/* stream_is_env • returns whether a line opens an environment closed by "@/" */
+static int
+stream_is_env(const uint8_t *data, size_t size)
+{
+	static const char *envs[] = {"@abstract", "@figure", "@table", "@listing", "@equation"};
+	size_t i, n;
+
+	for (i = 0; i < sizeof(envs) / sizeof(envs[0]); ++i) {
+		n = strlen(envs[i]);
+		if (size >= n && memcmp(data, envs[i], n) == 0 && (size == n || is_separator(data[n])))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* stream_is_footnote • returns whether a line starts a footnote definition */
+static int
+stream_is_footnote(hoedown_document *doc, const uint8_t *data, size_t size)
+{
+	size_t i = 0;
+
+	if (!(doc->ext_flags & HOEDOWN_EXT_FOOTNOTES))
+		return 0;
+
+	while (i < 3 && i < size && data[i] == ' ')
+		i++;
+	if (i + 1 >= size || data[i] != '[' || data[i + 1] != '^')
+		return 0;
+
+	for (i += 2; i < size && data[i] != ']' && data[i] != '\n'; i++);
+	return i + 1 < size && data[i] == ']' && data[i + 1] == ':';
+}
+
+/* stream_html_tag • returns the block tag a line opens, if any */
+static const char *
+stream_html_tag(const uint8_t *data, size_t size)
+{
+	size_t i = 1;
+
+	if (size < 2 || data[0] != '<')
+		return NULL;
+
+	while (i < size && hoedown_isalnum(data[i]))
+		i++;
+
+	return i > 1 ? hoedown_find_block_tag((const char *)data + 1, (unsigned int)(i - 1)) : NULL;
+}
+
+/* stream_closes_tag • returns whether a line contains the closing tag */
+static int
+stream_closes_tag(const uint8_t *data, size_t size, const char *tag)
+{
+	size_t n = strlen(tag), i;
+
+	for (i = 0; i + n + 2 <= size; ++i)
+		if (data[i] == '<' && data[i + 1] == '/' && strncasecmp((const char *)data + i + 2, tag, n) == 0)
+			return 1;
+
+	return 0;
+}
+
+/* stream_scan • classifies the complete lines of the input not seen yet,
+ * recording the last point where a top-level block starts */
+static void
+stream_scan(hoedown_document *doc)
+{
+	struct stream_state *stream = doc->stream;
+	uint8_t *data = stream->input->data;
+	size_t size = stream->input->size;
+	size_t beg = stream->scanned, end, width;
+	uint8_t chr;
+	int blank;
+
+	while (beg < size) {
+		end = beg;
+		while (end < size && data[end] != '\n')
+			end++;
+
+		if (end >= size)
+			break;
+
+		blank = is_empty(data + beg, size - beg) != 0;
+
+		if (stream->in_yaml) {
+			if (startsWith("---", (char *)data + beg))
+				stream->in_yaml = 0;
+		} else if (stream->fence) {
+			if (is_codefence(data + beg, end - beg + 1, &width, &chr) &&
+			    chr == stream->fence && width >= stream->fence_width)
+				stream->fence = 0;
+		} else if (stream->in_env) {
+			if (startsWith("@/", (char *)data + beg))
+				stream->in_env = 0;
+		} else if (stream->html_tag) {
+			if (stream_closes_tag(data + beg, end - beg, stream->html_tag))
+				stream->html_tag = NULL;
+		} else if (stream->in_footnote && (blank || data[beg] == ' ')) {
+			/* the blank and indented lines of a footnote definition */
+			beg = end + 1;
+			continue;
+		} else if ((stream->in_footnote = stream_is_footnote(doc, data + beg, end - beg)) ||
+			   is_ref(data + beg, 0, size - beg, NULL, NULL)) {
+			/* definitions are stripped before the blocks are parsed: no
+			 * block starts at one, the blocks around it are parsed as if
+			 * it were not there */
+			beg = end + 1;
+			continue;
+		} else {
+			if (stream->blank && !blank && data[beg] != ' ' && data[beg] != '\t' && data[beg] != '>' &&
+			    !prefix_uli(data + beg, end - beg + 1) && !prefix_oli(data + beg, end - beg + 1))
+				stream->cut = beg;
+
+			if (beg == 0 && !stream->started && startsWith("---", (char *)data) && is_separator(data[3]))
+				stream->in_yaml = 1;
+			else if (is_codefence(data + beg, end - beg + 1, &width, &chr)) {
+				stream->fence = chr;
+				stream->fence_width = width;
+			} else if (stream_is_env(data + beg, end - beg))
+				stream->in_env = 1;
+			else if ((stream->html_tag = stream_html_tag(data + beg, end - beg)) != NULL &&
+				 stream_closes_tag(data + beg, end - beg, stream->html_tag))
+				stream->html_tag = NULL;
+		}
+
+		stream->blank = blank;
+		beg = end + 1;
+	}
+
+	stream->scanned = beg;
+}
+
+/* stream_render_blocks • renders complete top-level blocks into the held output */
+static void
+stream_render_blocks(hoedown_document *doc, const uint8_t *data, size_t size)
+{
+	struct stream_state *stream = doc->stream;
+	hoedown_buffer *ob = stream->output;
+	hoedown_buffer *text = hoedown_buffer_new(64);
+	html_counter before = stream->floats;
+	size_t skip = 0;
+
+	find_references(doc, data, size, &stream->floats);
+	stream->defined += (stream->floats.figure - before.figure) + (stream->floats.equation - before.equation) +
+		(stream->floats.listing - before.listing) + (stream->floats.table - before.table);
+
+	hoedown_buffer_grow(text, size);
+	stream->defined += strip_definitions(doc, text, data, size, 0);
+
+	if (!stream->started) {
+		metadata *meta = load_metadata(doc, size ? data : (const uint8_t *)"", size);
+
+		if (doc->md.head)
+			doc->md.head(ob, meta, doc->extensions);
+		if (doc->md.begin)
+			doc->md.begin(ob, &doc->data);
+		render_metadata(doc, ob, meta);
+
+		if (doc->md.inner)
+			doc->md.inner(ob, &doc->data);
+		if (doc->md.doc_header)
+			doc->md.doc_header(ob, 0, &doc->data);
+
+		if (text->size)
+			skip = skip_yaml(doc, ob, text->data, text->size);
+		stream->started = 1;
+	}
+
+	if (text->size > skip) {
+		if (text->data[text->size - 1] != '\n')
+			hoedown_buffer_putc(text, '\n');
+
+		/* block parsers compare prefixes with strncmp */
+		hoedown_buffer_grow(text, text->size + 1);
+		text->data[text->size] = '\0';
+
+		parse_block(ob, doc, text->data + skip, text->size - skip, -1);
+	}
+
+	hoedown_buffer_free(text);
+}
+
+/* stream_resolved • returns whether the reference of a placeholder is defined now */
+static int
+stream_resolved(hoedown_document *doc, struct stream_placeholder *ph)
+{
+	switch (ph->type) {
+	case STREAM_LINK:
+		return find_link_ref(doc->refs, ph->id->data, ph->id->size) != NULL;
+	case STREAM_FOOTNOTE:
+		return find_footnote_ref(&doc->footnotes_found, ph->id->data, ph->id->size) != NULL;
+	case STREAM_FLOAT:
+		return find_label(doc, ph->id->data, ph->id->size) != NULL;
+	case STREAM_TOC:
+		return 0;
+	}
+
+	return 1;
+}
+
+static void
+stream_free_placeholders(struct stream_state *stream)
+{
+	size_t i;
+
+	for (i = 0; i < stream->count; ++i) {
+		hoedown_buffer_free(stream->placeholders[i].id);
+		hoedown_buffer_free(stream->placeholders[i].raw);
+	}
+
+	stream->count = 0;
+}
+
+/* stream_flush • moves the held output to ob up to the first placeholder
+ * still undefined, rendering the resolved ones; final renders them all,
+ * and so does a held output over the stream limit. Otherwise the last
+ * byte stays held, renderers look at the output size to separate blocks */
+static void
+stream_flush(hoedown_document *doc, hoedown_buffer *ob, int final)
+{
+	struct stream_state *stream = doc->stream;
+	hoedown_buffer *out = stream->output;
+	struct stream_placeholder *ph;
+	size_t i = 0, end, mark, j, n;
+	int force = final || (doc->stream_limit && out->size > doc->stream_limit);
+
+	/* nothing new was defined since the output got stuck */
+	if (!force && stream->blocked && stream->defined == stream->blocked_defined)
+		return;
+
+	stream->blocked = 0;
+	end = final || !out->size ? out->size : out->size - 1;
+
+	while (i < end) {
+		mark = i;
+		while (i < end && out->data[i] != STREAM_MARK)
+			i++;
+
+		if (i > mark)
+			hoedown_buffer_put(ob, out->data + mark, i - mark);
+
+		if (i >= end)
+			break;
+
+		/* a mark of the source */
+		if (i + 1 < out->size && out->data[i + 1] == STREAM_MARK) {
+			if (!final && i + 1 >= end)
+				break;
+			hoedown_buffer_putc(ob, STREAM_MARK);
+			i += 2;
+			continue;
+		}
+
+		for (j = i + 1, n = 0; j < out->size && out->data[j] >= '0' && out->data[j] <= '9'; j++)
+			n = n * 10 + (out->data[j] - '0');
+
+		if (j == i + 1 || j >= out->size || out->data[j] != STREAM_MARK ||
+		    n >= stream->count || !stream->placeholders[n].raw) {
+			hoedown_buffer_putc(ob, out->data[i++]);
+			continue;
+		}
+
+		if (!final && j >= end)
+			break;
+
+		ph = &stream->placeholders[n];
+		if (!force && !stream_resolved(doc, ph)) {
+			stream->blocked = 1;
+			stream->blocked_defined = stream->defined;
+			break;
+		}
+
+		stream->resolving = 1;
+		if (ph->type == STREAM_TOC) {
+			if (doc->table_of_contents)
+				doc->md.toc(ob, doc->table_of_contents, doc->document_metadata->numbering, &doc->data);
+		} else
+			parse_inline(ob, doc, ph->raw->data, ph->raw->size);
+		stream->resolving = 0;
+
+		hoedown_buffer_free(ph->raw);
+		ph->raw = NULL;
+		i = j + 1;
+	}
+
+	if (i) {
+		memmove(out->data, out->data + i, out->size - i);
+		out->size -= i;
+	}
+
+	if (!out->size || !memchr(out->data, STREAM_MARK, out->size))
+		stream_free_placeholders(stream);
+}
+
+/* stream_unmark • halves the doubled source marks of ob from the given offset */
+static void
+stream_unmark(hoedown_buffer *ob, size_t from)
+{
+	size_t i, o;
+
+	for (i = o = from; i < ob->size; ++i, ++o) {
+		ob->data[o] = ob->data[i];
+		if (ob->data[i] == STREAM_MARK && i + 1 < ob->size && ob->data[i + 1] == STREAM_MARK)
+			i++;
+	}
+
+	ob->size = o;
+}
+
 metadata* document_metadata(const uint8_t *data, size_t size)
 {
 	return parse_yaml(data, size);
 }
 
-void
-hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position)
+/* render_reset • forget the header numbers, labels, table of contents and metadata of a previous render */
+static void
+render_reset(hoedown_document *doc)
 {
+	doc->counter = doc->counter_start;
+
+	free_references(doc->floating_references);
+	free(doc->floating_references);
+	doc->floating_references = NULL;
+	doc->labels_valid = 0;
 
+	free_toc(doc->table_of_contents);
+	doc->table_of_contents = NULL;
+
+	/* the metadata itself is kept for the next render */
+	if (doc->document_metadata)
+		clear_meta(doc->document_metadata);
+	doc->data.meta = NULL;
+}
+
+/* render_document • renders a whole document; single leaves out the pre-scans
+ * of the floats and headers and backpatches what refers to them */
+static void
+render_document(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position, int single)
+{
+
+	struct stream_state *stream = NULL;
 	int footnotes_enabled;
+	double start = 0;
+	size_t begin = ob->size;
+	uint8_t *mark;
+
+	render_reset(doc);
+
+	if (doc->profile) {
+		hoedown_profile_reset(doc->profile);
+		start = hoedown_profile_now();
+	}
 
 	/* reset the references table */
 	memset(&doc->refs, 0x0, REF_TABLE_SIZE * sizeof(void *));
@@ -3921,15 +5323,24 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 		memset(&doc->footnotes_found, 0x0, sizeof(doc->footnotes_found));
 		memset(&doc->footnotes_used, 0x0, sizeof(doc->footnotes_used));
 	}
-	html_counter counter = {0,0,0,0};
-	find_references(doc, data, size, &counter);
-
+	/* the placeholders could not be told from the marks of the source */
+	if (single && memchr(data, STREAM_MARK, size))
+		single = 0;
+
+	if (single) {
+		stream = hoedown_calloc(1, sizeof(struct stream_state));
+		stream->output = hoedown_buffer_new(1024);
+		stream->floats = doc->float_counter;
+		stream->single = 1;
+		doc->stream = stream;
+	} else {
+		html_counter counter = doc->float_counter;
+		find_references(doc, data, size, &counter);
 
-	doc->table_of_contents = generate_toc(doc, data, size, NULL);
+		doc->table_of_contents = generate_toc(doc, data, size, NULL);
+	}
 
-	metadata * meta = parse_yaml(data, size);
-	doc->document_metadata = meta;
-	doc->data.meta = meta;
+	metadata * meta = load_metadata(doc, data, size);
 
 	if (doc->md.head)
 		doc->md.head(ob, meta, doc->extensions);
@@ -3940,6 +5351,9 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 	if (doc->md.inner)
 		doc->md.inner(ob, &doc->data);
 
+	if (doc->profile)
+		doc->profile->prepare_time = hoedown_profile_now() - start;
+
 	sub_render(doc, ob, data, size, position);
 	/* footnotes */
 	if (footnotes_enabled)
@@ -3949,6 +5363,23 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 		doc->md.doc_footer(ob, 0, &doc->data);
 	if (doc->md.end)
 		doc->md.end(ob, doc->extensions, &doc->data);
+
+	/* every header and label is known now: the output from the first
+	 * placeholder on is rendered again with the placeholders filled in */
+	if (stream) {
+		if (stream->count && (mark = memchr(ob->data + begin, STREAM_MARK, ob->size - begin)) != NULL) {
+			hoedown_buffer_put(stream->output, mark, ob->data + ob->size - mark);
+			ob->size = mark - ob->data;
+			stream_flush(doc, ob, 1);
+		}
+
+		stream_free_placeholders(stream);
+		free(stream->placeholders);
+		hoedown_buffer_free(stream->output);
+		free(stream);
+		doc->stream = NULL;
+	}
+
 	/* clean-up */
 
 	free_link_refs(doc->refs);
@@ -3957,10 +5388,233 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 		free_footnote_list(&doc->footnotes_used, 0);
 	}
 
+	if (doc->profile) {
+		doc->profile->total_time = hoedown_profile_now() - start;
+		hoedown_profile_finish(doc->profile, data, size);
+	}
+
 	assert(doc->work_bufs[BUFFER_SPAN].size == 0);
 	assert(doc->work_bufs[BUFFER_BLOCK].size == 0);
 }
 
+void
+hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position)
+{
+	render_document(doc, ob, data, size, position, 0);
+}
+
+void
+hoedown_document_render_single_pass(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position)
+{
+	render_document(doc, ob, data, size, position, 1);
+}
+
+size_t
+hoedown_document_render_to(hoedown_document *doc, uint8_t *out, size_t out_size, const uint8_t *data, size_t size, int position)
+{
+	hoedown_buffer ob;
+
+	hoedown_buffer_reset(&doc->held);
+
+	/* past out_size, the output moves to the heap and grows from there */
+	hoedown_buffer_init_fixed(&ob, out, out_size, size / 2 + 64);
+	hoedown_document_render(doc, &ob, data, size, position);
+
+	if (ob.data == out)
+		return ob.size;
+
+	if (ob.size <= out_size) {
+		memcpy(out, ob.data, ob.size);
+		hoedown_buffer_uninit(&ob);
+		return ob.size;
+	}
+
+	/* kept for hoedown_document_render_resume */
+	doc->held = ob;
+	return ob.size;
+}
+
+size_t
+hoedown_document_render_resume(hoedown_document *doc, uint8_t *out, size_t out_size)
+{
+	size_t size = doc->held.size;
+
+	if (size > out_size)
+		return size;
+
+	if (size)
+		memcpy(out, doc->held.data, size);
+	hoedown_buffer_reset(&doc->held);
+
+	return size;
+}
+
+void
+hoedown_document_stream_begin(hoedown_document *doc)
+{
+	struct stream_state *stream;
+
+	render_reset(doc);
+
+	/* reset the references table */
+	memset(&doc->refs, 0x0, REF_TABLE_SIZE * sizeof(void *));
+
+	/* reset the footnotes lists */
+	if (doc->ext_flags & HOEDOWN_EXT_FOOTNOTES) {
+		memset(&doc->footnotes_found, 0x0, sizeof(doc->footnotes_found));
+		memset(&doc->footnotes_used, 0x0, sizeof(doc->footnotes_used));
+	}
+
+	stream = hoedown_calloc(1, sizeof(struct stream_state));
+	stream->input = hoedown_buffer_new(1024);
+	stream->output = hoedown_buffer_new(1024);
+	stream->floats = doc->float_counter;
+
+	doc->stream = stream;
+}
+
+void
+hoedown_document_stream_feed(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size)
+{
+	struct stream_state *stream = doc->stream;
+	hoedown_buffer *input = stream->input;
+	const uint8_t *mark;
+	size_t cut;
+
+	/* the marks of the source are doubled, see stream_placeholder */
+	while ((mark = size ? memchr(data, STREAM_MARK, size) : NULL) != NULL) {
+		hoedown_buffer_put(input, data, mark - data + 1);
+		hoedown_buffer_putc(input, STREAM_MARK);
+		size -= mark - data + 1;
+		data = mark + 1;
+	}
+	hoedown_buffer_put(input, data, size);
+	stream_scan(doc);
+
+	if (stream->cut) {
+		cut = stream->cut;
+		stream_render_blocks(doc, input->data, cut);
+
+		memmove(input->data, input->data + cut, input->size - cut);
+		input->size -= cut;
+		stream->scanned -= cut;
+		stream->cut = 0;
+	}
+
+	stream_flush(doc, ob, 0);
+}
+
+void
+hoedown_document_stream_end(hoedown_document *doc, hoedown_buffer *ob)
+{
+	struct stream_state *stream = doc->stream;
+	int footnotes_enabled = doc->ext_flags & HOEDOWN_EXT_FOOTNOTES;
+
+	if (stream->input->size || !stream->started)
+		stream_render_blocks(doc, stream->input->data, stream->input->size);
+
+	stream_flush(doc, ob, 1);
+
+	stream->resolving = 1;
+
+	/* footnotes, their source marks are doubled too */
+	if (footnotes_enabled) {
+		size_t from = ob->size;
+
+		parse_footnote_list(ob, doc, &doc->footnotes_used);
+		stream_unmark(ob, from);
+	}
+
+	if (doc->md.doc_footer)
+		doc->md.doc_footer(ob, 0, &doc->data);
+	if (doc->md.end)
+		doc->md.end(ob, doc->extensions, &doc->data);
+
+	/* clean-up */
+	free_link_refs(doc->refs);
+	if (footnotes_enabled) {
+		free_footnote_list(&doc->footnotes_found, 1);
+		free_footnote_list(&doc->footnotes_used, 0);
+	}
+
+	stream_free_placeholders(stream);
+	free(stream->placeholders);
+	hoedown_buffer_free(stream->input);
+	hoedown_buffer_free(stream->output);
+	free(stream);
+	doc->stream = NULL;
+
+	assert(doc->work_bufs[BUFFER_SPAN].size == 0);
+	assert(doc->work_bufs[BUFFER_BLOCK].size == 0);
+}
+
+void
+hoedown_document_set_stream_limit(hoedown_document *doc, size_t size)
+{
+	doc->stream_limit = size;
+}
+
+void
+hoedown_document_set_numbering(hoedown_document *doc, const doc_numbering *numbering)
+{
+	doc->counter = numbering->headers;
+	doc->counter_start = numbering->headers;
+	doc->float_counter = numbering->floats;
+	doc->external_references = numbering->labels;
+	doc->labels_valid = 0;
+}
+
+void
+hoedown_document_scan(hoedown_document *doc, const uint8_t *data, size_t size, doc_scan *scan)
+{
+	reference *found = doc->floating_references;
+	html_counter counter = {0,0,0,0};
+
+	doc->floating_references = NULL;
+	find_references(doc, data, size, &counter);
+
+	scan->labels = doc->floating_references;
+	scan->floats = counter;
+	scan->headers = generate_toc(doc, data, size, NULL);
+
+	doc->floating_references = found;
+	doc->labels_valid = 0;
+}
+
+void
+hoedown_document_scan_free(doc_scan *scan)
+{
+	free_references(scan->labels);
+	free(scan->labels);
+	free_toc(scan->headers);
+	scan->labels = NULL;
+	scan->headers = NULL;
+}
+
+void
+hoedown_document_set_dependency(hoedown_document *doc, void (*dependency)(const char *path, void *opaque), void *opaque)
+{
+	doc->dependency = dependency;
+	doc->dependency_opaque = opaque;
+}
+
+void
+hoedown_document_set_index(hoedown_document *doc, hoedown_index *index)
+{
+	doc->index = index;
+}
+
+void
+hoedown_document_set_profile(hoedown_document *doc, hoedown_profile *profile)
+{
+	if (profile && !doc->profile)
+		profile_wrap(doc);
+	else if (!profile && doc->profile)
+		doc->md = doc->profile_md;
+
+	doc->profile = profile;
+}
+
 void
 hoedown_document_render_inline(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position)
 {
@@ -4010,11 +5664,16 @@ hoedown_document_render_inline(hoedown_document *doc, hoedown_buffer *ob, const
 void
 free_references(reference * ref)
 {
-	if (ref)
+	reference * next;
+
+	if (!ref)
+		return;
+	free(ref->id);
+	for (next = ref->next; next; next = ref)
 	{
-		free(ref->id);
-		free_references(ref->next);
-		free(ref->next);
+		ref = next->next;
+		free(next->id);
+		free(next);
 	}
 }
 
@@ -4029,11 +5688,10 @@ free_toc(toc * ToC)
 	}
 }
 
-void
-free_meta(metadata * meta)
+/* clear_meta • frees the strings of meta and forgets them */
+static void
+clear_meta(metadata * meta)
 {
-	if (!meta)
-		return;
 	if (meta->affiliation)
 		free(meta->affiliation);
 	if (meta->keywords)
@@ -4043,6 +5701,16 @@ free_meta(metadata * meta)
 	if (meta->title)
 		free(meta->title);
 	free_strings(meta->authors);
+	meta->affiliation = meta->keywords = meta->style = meta->title = NULL;
+	meta->authors = NULL;
+}
+
+void
+free_meta(metadata * meta)
+{
+	if (!meta)
+		return;
+	clear_meta(meta);
 	free(meta);
 }
 
@@ -4057,9 +5725,24 @@ hoedown_document_free(hoedown_document *doc)
 	for (i = 0; i < (size_t)doc->work_bufs[BUFFER_BLOCK].asize; ++i)
 		hoedown_buffer_free(doc->work_bufs[BUFFER_BLOCK].item[i]);
 
+	for (i = 0; i < (size_t)doc->inline_indexes.asize; ++i) {
+		struct inline_index *idx = doc->inline_indexes.item[i];
+		if (!idx) continue;
+		free(idx->runs[DELIM_BACKTICK]);
+		free(idx->runs[DELIM_DOLLAR]);
+		free(idx);
+	}
+
 	hoedown_stack_uninit(&doc->work_bufs[BUFFER_SPAN]);
 	hoedown_stack_uninit(&doc->work_bufs[BUFFER_BLOCK]);
+	hoedown_stack_uninit(&doc->inline_indexes);
+	free(doc->frames);
+	free(doc->source_map);
 	free_references(doc->floating_references);
+	free(doc->floating_references);
+	free(doc->labels);
+	hoedown_buffer_uninit(&doc->held);
+	hoedown_buffer_uninit(&doc->source);
 	free_toc(doc->table_of_contents);
 	free_meta(doc->document_metadata);
 	if (doc->base_folder)
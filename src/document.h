@@ -7,6 +7,8 @@
 #include "autolink.h"
 #include "utils.h"
 #include "constants.h"
+#include "index.h"
+#include "profile.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -161,6 +163,22 @@ struct
 	void * sibling;
 }typedef toc;
 
+/* doc_numbering: numbers a render starts from, and labels defined outside the document */
+struct
+{
+	h_counter headers;
+	html_counter floats;
+	reference * labels;
+}typedef doc_numbering;
+
+/* doc_scan: what a document contributes to the numbering, floats and labels counted from zero */
+struct
+{
+	reference * labels;
+	html_counter floats;
+	toc * headers;
+}typedef doc_scan;
+
 
 /* hoedown_renderer - functions for rendering parsed data */
 struct hoedown_renderer {
@@ -200,7 +218,7 @@ struct hoedown_renderer {
 	void (*footnotes)(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data);
 	void (*footnote_def)(hoedown_buffer *ob, const hoedown_buffer *content, unsigned int num, const hoedown_renderer_data *data);
 	void (*blockhtml)(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data);
-	void (*toc)(hoedown_buffer *ob, toc* ToC, int numbering);
+	void (*toc)(hoedown_buffer *ob, toc* ToC, int numbering, const hoedown_renderer_data *data);
 
 	/* span level callbacks - NULL or return 0 prints the span verbatim */
 	int (*autolink)(hoedown_buffer *ob, const hoedown_buffer *link, hoedown_autolink_type type, const hoedown_renderer_data *data);
@@ -219,7 +237,7 @@ struct hoedown_renderer {
 	int (*footnote_ref)(hoedown_buffer *ob, int num, const hoedown_renderer_data *data);
 	int (*math)(hoedown_buffer *ob, const hoedown_buffer *text, int displaymode, const hoedown_renderer_data *data);
 	int (*eq_math)(hoedown_buffer *ob, const hoedown_buffer *text, int displaymode, const hoedown_renderer_data *data);
-	int (*ref)(hoedown_buffer *ob, char * id, int count);
+	int (*ref)(hoedown_buffer *ob, char * id, int count, const hoedown_renderer_data *data);
 	int (*raw_html)(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data);
 
 	/* low level callbacks - NULL copies input directly into the output */
@@ -232,6 +250,12 @@ struct hoedown_renderer {
 	
 	/* position reference */
 	void (*position)(hoedown_buffer *ob);
+
+	/* source offset of the next top-level block */
+	void (*source_offset)(hoedown_buffer *ob, size_t offset, const hoedown_renderer_data *data);
+
+	/* top-level @include, content is the rendered file; return 0 to insert content in place */
+	int (*include)(hoedown_buffer *ob, const char *path, const hoedown_buffer *content, const hoedown_renderer_data *data);
 };
 typedef struct hoedown_renderer hoedown_renderer;
 
@@ -254,9 +278,73 @@ hoedown_document *hoedown_document_new(
 /* hoedown_document_render: render regular Markdown using the document processor */
 void hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position);
 
+/* hoedown_document_render_single_pass: like hoedown_document_render, without
+ * the pre-scans of the whole document (includes too) for the floats and the
+ * headers: the table of contents and the (#id) references to floats further
+ * down are written as placeholders, filled in once the document is rendered.
+ * Floats are numbered and headers listed as they are rendered, so those in
+ * raw HTML blocks or mid-line are left out. A source holding an ESC byte is
+ * rendered with the pre-scans */
+void hoedown_document_render_single_pass(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position);
+
+/* hoedown_document_render_to: render into the out_size bytes at out, without
+ * allocating the output, and return the size of the rendering. When it is
+ * larger than out_size, the contents of out are undefined and the rendering
+ * is kept by the document, until hoedown_document_render_resume or the next
+ * hoedown_document_render_to */
+size_t hoedown_document_render_to(hoedown_document *doc, uint8_t *out, size_t out_size, const uint8_t *data, size_t size, int position);
+
+/* hoedown_document_render_resume: copy the rendering kept by the last
+ * hoedown_document_render_to into the out_size bytes at out, and return its
+ * size; nothing is copied when it is still larger than out_size */
+size_t hoedown_document_render_resume(hoedown_document *doc, uint8_t *out, size_t out_size);
+
 /* hoedown_document_render_inline: render inline Markdown using the document processor */
 void hoedown_document_render_inline(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size, int position);
 
+/* hoedown_document_stream_begin: start rendering a document fed in chunks;
+ * there is no table of contents, and a shortcut [text] reference only
+ * resolves against the definitions that come before it */
+void hoedown_document_stream_begin(hoedown_document *doc);
+
+/* hoedown_document_stream_feed: feed the next chunk of the document and append
+ * to ob the output of the blocks it completes. Output following a reference
+ * not defined yet is held back until the definition comes or the stream ends */
+void hoedown_document_stream_feed(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size);
+
+/* hoedown_document_stream_end: render what is left of the document into ob */
+void hoedown_document_stream_end(hoedown_document *doc, hoedown_buffer *ob);
+
+/* hoedown_document_set_stream_limit: bound the output a streaming render holds
+ * back for forward references; past size bytes, pending references are
+ * rendered as undefined. Zero (the default) holds it until the end */
+void hoedown_document_set_stream_limit(hoedown_document *doc, size_t size);
+
+/* hoedown_document_set_numbering: start the following renders from the given
+ * header and float numbers; (#id) references missing from the document are
+ * looked up in numbering->labels, which must outlive the renders. The float
+ * counters of the renderer state have to be set accordingly by the caller */
+void hoedown_document_set_numbering(hoedown_document *doc, const doc_numbering *numbering);
+
+/* hoedown_document_scan: collect the headers, floats and labels of a document without rendering it */
+void hoedown_document_scan(hoedown_document *doc, const uint8_t *data, size_t size, doc_scan *scan);
+
+/* hoedown_document_scan_free: deallocate the lists filled by hoedown_document_scan */
+void hoedown_document_scan_free(doc_scan *scan);
+
+/* hoedown_document_set_dependency: report the path of every file the following
+ * renders look for (includes, bibliographies), even missing ones; a path can
+ * be reported several times per render. NULL to stop */
+void hoedown_document_set_dependency(hoedown_document *doc, void (*dependency)(const char *path, void *opaque), void *opaque);
+
+/* hoedown_document_set_index: feed the terms of the following renders into index, NULL to stop */
+void hoedown_document_set_index(hoedown_document *doc, hoedown_index *index);
+
+/* hoedown_document_set_profile: record into profile the cost of each top-level
+ * block of the following renders, each render resetting it; NULL to stop.
+ * Streaming renders are not profiled */
+void hoedown_document_set_profile(hoedown_document *doc, hoedown_profile *profile);
+
 /* hoedown_document_free: deallocate a document processor instance */
 void hoedown_document_free(hoedown_document *doc);
 
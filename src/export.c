@@ -0,0 +1,453 @@
+#include "export.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "charclass.h"
+#include "utils.h"
+
+#ifndef _MSC_VER
+#include <strings.h>
+#else
+#define strncasecmp	_strnicmp
+#define strcasecmp	_stricmp
+#endif
+
+#define ASSET_READ_UNIT 1024
+
+/* export_mime_types: images inlined as data: URIs, by file extension */
+static const char *export_mime_types[][2] = {
+	{"png", "image/png"},
+	{"jpg", "image/jpeg"},
+	{"jpeg", "image/jpeg"},
+	{"gif", "image/gif"},
+	{"svg", "image/svg+xml"},
+	{"webp", "image/webp"},
+	{"bmp", "image/bmp"}
+};
+
+static const char base64_chars[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/********************
+ * HELPER FUNCTIONS *
+ ********************/
+
+static void
+base64_encode(hoedown_buffer *ob, const uint8_t *data, size_t size)
+{
+	size_t i;
+	uint8_t *out;
+
+	hoedown_buffer_grow(ob, ob->size + (size + 2) / 3 * 4);
+	out = ob->data + ob->size;
+
+	for (i = 0; i + 2 < size; i += 3) {
+		*out++ = base64_chars[data[i] >> 2];
+		*out++ = base64_chars[((data[i] & 0x03) << 4) | (data[i + 1] >> 4)];
+		*out++ = base64_chars[((data[i + 1] & 0x0f) << 2) | (data[i + 2] >> 6)];
+		*out++ = base64_chars[data[i + 2] & 0x3f];
+	}
+
+	if (i < size) {
+		*out++ = base64_chars[data[i] >> 2];
+		if (i + 1 < size) {
+			*out++ = base64_chars[((data[i] & 0x03) << 4) | (data[i + 1] >> 4)];
+			*out++ = base64_chars[(data[i + 1] & 0x0f) << 2];
+		} else {
+			*out++ = base64_chars[(data[i] & 0x03) << 4];
+			*out++ = '=';
+		}
+		*out++ = '=';
+	}
+
+	ob->size = out - ob->data;
+}
+
+/* drop_encodings: free the contents of an asset, keeping its entry */
+static void
+drop_encodings(scidown_asset_cache *cache, scidown_asset *asset)
+{
+	if (asset->text) {
+		cache->bytes -= asset->text->asize;
+		hoedown_buffer_free(asset->text);
+	}
+	if (asset->base64) {
+		cache->bytes -= asset->base64->asize;
+		hoedown_buffer_free(asset->base64);
+	}
+	asset->text = asset->base64 = NULL;
+}
+
+/* evict: unlink the least recently used assets other than keep until the
+ * cache is within its limit */
+static void
+evict(scidown_asset_cache *cache, const scidown_asset *keep)
+{
+	scidown_asset **slot, **oldest, *asset;
+	size_t i;
+
+	while (cache->bytes > cache->limit) {
+		oldest = NULL;
+		for (i = 0; i < SCIDOWN_ASSET_TABLE_SIZE; ++i)
+			for (slot = &cache->table[i]; *slot; slot = &(*slot)->next)
+				if (*slot != keep && (!oldest || (*slot)->used < (*oldest)->used))
+					oldest = slot;
+
+		if (!oldest)
+			return;
+
+		asset = *oldest;
+		*oldest = asset->next;
+		drop_encodings(cache, asset);
+		free(asset->path);
+		free(asset);
+	}
+}
+
+/* file_mtime_nsec: sub-second part of the modification time */
+static long
+file_mtime_nsec(const struct stat *st)
+{
+#if defined(__APPLE__)
+	return (long)st->st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+	return 0;
+#else
+	return (long)st->st_mtim.tv_nsec;
+#endif
+}
+
+/* read_file: the contents of a regular file, NULL when it cannot be read */
+static hoedown_buffer *
+read_file(const char *path)
+{
+	hoedown_buffer *data;
+	FILE *f = fopen(path, "rb");
+
+	if (!f)
+		return NULL;
+
+	data = hoedown_buffer_new(ASSET_READ_UNIT);
+	if (hoedown_buffer_putf(data, f) != 0) {
+		hoedown_buffer_free(data);
+		data = NULL;
+	}
+
+	fclose(f);
+	return data;
+}
+
+/* is_tag: whether the tag at data[0] == '<' is an opening tag named name */
+static int
+is_tag(const uint8_t *data, size_t size, const char *name)
+{
+	size_t n = strlen(name);
+
+	return size > n + 1 && strncasecmp((const char *)data + 1, name, n) == 0 &&
+		(hoedown_isspace(data[n + 1]) || data[n + 1] == '/' || data[n + 1] == '>');
+}
+
+/* tag_attribute: find the value of an attribute in a tag, quotes excluded;
+ * returns 0 when the tag has no such attribute with a value */
+static int
+tag_attribute(const uint8_t *tag, size_t size, const char *name, size_t *value, size_t *value_size)
+{
+	size_t i = 1, n = strlen(name), attr;
+	uint8_t quote;
+
+	while (i < size && !hoedown_isspace(tag[i]))
+		i++;
+
+	while (i < size - 1) {
+		if (hoedown_isspace(tag[i]) || tag[i] == '/') {
+			i++;
+			continue;
+		}
+
+		attr = i;
+		while (i < size - 1 && !hoedown_isspace(tag[i]) && tag[i] != '/' && tag[i] != '=')
+			i++;
+
+		if (tag[i] != '=')
+			continue;
+
+		i++;
+		quote = tag[i] == '"' || tag[i] == '\'' ? tag[i] : 0;
+		if (quote)
+			i++;
+
+		*value = i;
+		while (i < size - 1 && (quote ? tag[i] != quote : !hoedown_isspace(tag[i])))
+			i++;
+		*value_size = i - *value;
+		if (quote)
+			i++;
+
+		if (i - attr > n && strncasecmp((const char *)tag + attr, name, n) == 0 && tag[attr + n] == '=')
+			return 1;
+	}
+
+	return 0;
+}
+
+/* hex_value: value of a hexadecimal digit, -1 for other bytes */
+static int
+hex_value(uint8_t c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c = hoedown_tolower(c);
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+/* local_path: the file an URL of the output refers to, relative to folder;
+ * 0 for URLs with a scheme or a host, which are not inlined */
+static int
+local_path(hoedown_buffer *path, const uint8_t *url, size_t size, const char *folder)
+{
+	size_t i;
+	uint8_t c;
+
+	for (i = 0; i < size && url[i] != '/' && url[i] != '?' && url[i] != '#'; ++i)
+		if (url[i] == ':')
+			return 0;
+
+	if (!size || url[0] == '#' || url[0] == '?' || (size > 1 && url[0] == '/' && url[1] == '/'))
+		return 0;
+
+	hoedown_buffer_reset(path);
+	if (folder && url[0] != '/') {
+		hoedown_buffer_puts(path, folder);
+		hoedown_buffer_putc(path, '/');
+	}
+
+	/* undo the escaping of the renderer */
+	for (i = 0; i < size && url[i] != '?' && url[i] != '#'; ++i) {
+		c = url[i];
+		if (c == '&' && size - i >= 5 && memcmp(url + i, "&amp;", 5) == 0) {
+			i += 4;
+		} else if (c == '%' && i + 2 < size && hex_value(url[i + 1]) >= 0 && hex_value(url[i + 2]) >= 0) {
+			c = (uint8_t)(hex_value(url[i + 1]) << 4 | hex_value(url[i + 2]));
+			i += 2;
+		}
+
+		if (!c)
+			return 0;
+		hoedown_buffer_putc(path, c);
+	}
+
+	hoedown_buffer_putc(path, '\0');
+	return 1;
+}
+
+/* closes_style: whether a style-sheet contains "</style", which would end
+ * the element it is inlined in */
+static int
+closes_style(const hoedown_buffer *css)
+{
+	size_t i;
+
+	for (i = 0; i + 7 <= css->size; ++i)
+		if (css->data[i] == '<' && css->data[i + 1] == '/' &&
+			strncasecmp((const char *)css->data + i + 2, "style", 5) == 0)
+			return 1;
+
+	return 0;
+}
+
+static const char *
+image_mime_type(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	size_t i;
+
+	if (!ext || strchr(ext, '/'))
+		return NULL;
+
+	for (i = 0; i < sizeof(export_mime_types) / sizeof(export_mime_types[0]); ++i)
+		if (strcasecmp(ext + 1, export_mime_types[i][0]) == 0)
+			return export_mime_types[i][1];
+
+	return NULL;
+}
+
+/* export_stylesheet: a <style> element for a <link rel="stylesheet">, 0
+ * when the style-sheet is not found */
+static int
+export_stylesheet(hoedown_buffer *ob, const uint8_t *tag, size_t size, hoedown_buffer *path,
+	scidown_asset_cache *cache, const char *base_folder, const char *style_folder)
+{
+	const hoedown_buffer *css = NULL;
+	size_t rel, rel_size, href, href_size;
+
+	if (!tag_attribute(tag, size, "rel", &rel, &rel_size) || rel_size != 10 ||
+		strncasecmp((const char *)tag + rel, "stylesheet", 10) != 0 ||
+		!tag_attribute(tag, size, "href", &href, &href_size))
+		return 0;
+
+	if (local_path(path, tag + href, href_size, base_folder))
+		css = scidown_asset_cache_get(cache, (const char *)path->data, SCIDOWN_ASSET_TEXT);
+	if (!css && style_folder && tag[href] != '/' && local_path(path, tag + href, href_size, style_folder))
+		css = scidown_asset_cache_get(cache, (const char *)path->data, SCIDOWN_ASSET_TEXT);
+
+	if (!css || closes_style(css))
+		return 0;
+
+	HOEDOWN_BUFPUTSL(ob, "<style>\n");
+	hoedown_buffer_put(ob, css->data, css->size);
+	HOEDOWN_BUFPUTSL(ob, "</style>");
+	return 1;
+}
+
+/* export_image: an <img> with its source as a data: URI, 0 when the image is not found */
+static int
+export_image(hoedown_buffer *ob, const uint8_t *tag, size_t size, hoedown_buffer *path,
+	scidown_asset_cache *cache, const char *base_folder)
+{
+	const hoedown_buffer *image;
+	const char *mime;
+	size_t src, src_size;
+
+	if (!tag_attribute(tag, size, "src", &src, &src_size) ||
+		!local_path(path, tag + src, src_size, base_folder) ||
+		!(mime = image_mime_type((const char *)path->data)) ||
+		!(image = scidown_asset_cache_get(cache, (const char *)path->data, SCIDOWN_ASSET_BASE64)))
+		return 0;
+
+	hoedown_buffer_put(ob, tag, src);
+	hoedown_buffer_printf(ob, "data:%s;base64,", mime);
+	hoedown_buffer_put(ob, image->data, image->size);
+	hoedown_buffer_put(ob, tag + src + src_size, size - src - src_size);
+	return 1;
+}
+
+
+/**********************
+ * EXPORTED FUNCTIONS *
+ **********************/
+
+scidown_asset_cache *
+scidown_asset_cache_new(void)
+{
+	scidown_asset_cache *cache = hoedown_calloc(1, sizeof(scidown_asset_cache));
+
+	cache->limit = SCIDOWN_ASSET_CACHE_LIMIT;
+	return cache;
+}
+
+const hoedown_buffer *
+scidown_asset_cache_get(scidown_asset_cache *cache, const char *path, scidown_asset_encoding encoding)
+{
+	scidown_asset **slot = &cache->table[scidown_hash((const uint8_t *)path, strlen(path)) % SCIDOWN_ASSET_TABLE_SIZE];
+	scidown_asset *asset;
+	hoedown_buffer *data, **encoded;
+	struct stat st;
+
+	for (asset = *slot; asset && strcmp(asset->path, path) != 0; asset = asset->next);
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		return NULL;
+
+	if (asset && ((long)st.st_mtime != asset->mtime || file_mtime_nsec(&st) != asset->mtime_nsec ||
+		(long)st.st_size != asset->file_size))
+		drop_encodings(cache, asset);
+
+	if (!asset) {
+		asset = hoedown_calloc(1, sizeof(scidown_asset));
+		asset->path = strdup(path);
+		asset->next = *slot;
+		*slot = asset;
+	}
+
+	asset->mtime = (long)st.st_mtime;
+	asset->mtime_nsec = file_mtime_nsec(&st);
+	asset->file_size = (long)st.st_size;
+	asset->used = ++cache->tick;
+
+	encoded = encoding == SCIDOWN_ASSET_BASE64 ? &asset->base64 : &asset->text;
+	if (*encoded) {
+		cache->hits++;
+		return *encoded;
+	}
+
+	cache->misses++;
+	if (!(data = read_file(path)))
+		return NULL;
+
+	if (encoding == SCIDOWN_ASSET_BASE64) {
+		*encoded = hoedown_buffer_new(ASSET_READ_UNIT);
+		base64_encode(*encoded, data->data, data->size);
+		hoedown_buffer_free(data);
+	} else {
+		*encoded = data;
+	}
+
+	cache->bytes += (*encoded)->asize;
+	evict(cache, asset);
+	return *encoded;
+}
+
+void
+scidown_asset_cache_free(scidown_asset_cache *cache)
+{
+	scidown_asset *asset, *next;
+	size_t i;
+
+	for (i = 0; i < SCIDOWN_ASSET_TABLE_SIZE; ++i) {
+		for (asset = cache->table[i]; asset; asset = next) {
+			next = asset->next;
+			drop_encodings(cache, asset);
+			free(asset->path);
+			free(asset);
+		}
+	}
+
+	free(cache);
+}
+
+void
+scidown_html_export(hoedown_buffer *ob, const uint8_t *data, size_t size, scidown_asset_cache *cache,
+	const char *base_folder, const char *style_folder)
+{
+	hoedown_buffer *path = hoedown_buffer_new(64);
+	size_t i = 0, mark, end;
+	int done;
+
+	while (i < size) {
+		mark = i;
+		while (i < size && data[i] != '<')
+			i++;
+
+		if (i > mark)
+			hoedown_buffer_put(ob, data + mark, i - mark);
+
+		if (i >= size)
+			break;
+
+		end = scidown_tag_end(data + i, size - i);
+		if (!end) {
+			hoedown_buffer_put(ob, data + i, size - i);
+			break;
+		}
+
+		done = 0;
+		if (is_tag(data + i, end, "link"))
+			done = export_stylesheet(ob, data + i, end, path, cache, base_folder, style_folder);
+		else if (is_tag(data + i, end, "img"))
+			done = export_image(ob, data + i, end, path, cache, base_folder);
+
+		if (!done)
+			hoedown_buffer_put(ob, data + i, end);
+
+		i += end;
+	}
+
+	hoedown_buffer_free(path);
+}
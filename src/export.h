@@ -0,0 +1,90 @@
+/* export.h - self-contained HTML with inlined style-sheets and images */
+
+#ifndef SCIDOWN_EXPORT_H
+#define SCIDOWN_EXPORT_H
+
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*************
+ * CONSTANTS *
+ *************/
+
+typedef enum scidown_asset_encoding {
+	SCIDOWN_ASSET_TEXT,	/* the file as is */
+	SCIDOWN_ASSET_BASE64
+} scidown_asset_encoding;
+
+
+/*********
+ * TYPES *
+ *********/
+
+/* scidown_asset: a file read for inlining, valid while its mtime and size match */
+struct scidown_asset {
+	char *path;
+	long mtime;
+	long mtime_nsec;	/* files rewritten within a second differ here */
+	long file_size;
+	unsigned long used;	/* cache tick of the last lookup */
+
+	hoedown_buffer *text;	/* filled on first use of each encoding */
+	hoedown_buffer *base64;
+
+	struct scidown_asset *next;
+};
+typedef struct scidown_asset scidown_asset;
+
+#define SCIDOWN_ASSET_TABLE_SIZE 64
+#define SCIDOWN_ASSET_CACHE_LIMIT (32 << 20)
+
+/* scidown_asset_cache: assets by path, kept across exports; the least
+ * recently used are dropped when they hold more than limit bytes. Not
+ * thread-safe */
+struct scidown_asset_cache {
+	scidown_asset *table[SCIDOWN_ASSET_TABLE_SIZE];
+
+	size_t bytes;	/* held by the encoded assets */
+	size_t limit;	/* SCIDOWN_ASSET_CACHE_LIMIT unless changed */
+	unsigned long tick;
+
+	size_t hits;	/* lookups served without reading the file */
+	size_t misses;
+};
+typedef struct scidown_asset_cache scidown_asset_cache;
+
+
+/*************
+ * FUNCTIONS *
+ *************/
+
+/* scidown_asset_cache_new: allocate an empty cache */
+scidown_asset_cache *scidown_asset_cache_new(void) __attribute__ ((malloc));
+
+/* scidown_asset_cache_get: contents of the file at path in the given encoding,
+ * read again only when its mtime or size changed; NULL when it is not a
+ * readable regular file. The buffer belongs to the cache and stays valid
+ * until the next lookup */
+const hoedown_buffer *scidown_asset_cache_get(scidown_asset_cache *cache, const char *path, scidown_asset_encoding encoding);
+
+/* scidown_asset_cache_free: deallocate a cache and its assets */
+void scidown_asset_cache_free(scidown_asset_cache *cache);
+
+/* scidown_html_export: copy rendered HTML to ob with every local style-sheet
+ * <link> replaced by a <style> element and the src of every local image
+ * replaced by a data: URI. Relative paths are looked up in base_folder (the
+ * working directory when NULL), style-sheets also in style_folder; references
+ * that are not found, or not local, are kept as they are */
+void scidown_html_export(hoedown_buffer *ob, const uint8_t *data, size_t size, scidown_asset_cache *cache,
+	const char *base_folder, const char *style_folder);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** SCIDOWN_EXPORT_H **/
@@ -3,14 +3,16 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 
 #include "escape.h"
+#include "charclass.h"
 
 #include "charter/src/parser.h"
 #include "charter/src/renderer.h"
 
 #define USE_XHTML(opt) (opt->flags & SCIDOWN_RENDER_USE_XHTML)
+#define COMPACT(opt) (opt->flags & SCIDOWN_RENDER_COMPACT)
+#define DIR_AUTO(opt) (COMPACT(opt) ? "" : " dir=\"auto\"")
 #define MAX_FILE_SIZE 1000000
 
 scidown_render_tag
@@ -40,7 +42,7 @@ hoedown_html_is_tag(const uint8_t *data, size_t size, const char *tagname)
 	if (i == size)
 		return SCIDOWN_RENDER_TAG_NONE;
 
-	if (isspace(data[i]) || data[i] == '>')
+	if (hoedown_isspace(data[i]) || data[i] == '>')
 		return closed ? SCIDOWN_RENDER_TAG_CLOSE : SCIDOWN_RENDER_TAG_OPEN;
 
 	return SCIDOWN_RENDER_TAG_NONE;
@@ -56,6 +58,31 @@ static void escape_href(hoedown_buffer *ob, const uint8_t *source, size_t length
 	hoedown_escape_href(ob, source, length);
 }
 
+/* put_newline: the cosmetic newline around blocks, left out of compact output */
+static void
+put_newline(hoedown_buffer *ob, const hoedown_html_renderer_state *state)
+{
+	if (!COMPACT(state))
+		hoedown_buffer_putc(ob, '\n');
+}
+
+/* block_newline: the newline separating a block from the output before it */
+static void
+block_newline(hoedown_buffer *ob, const hoedown_html_renderer_state *state)
+{
+	if (ob->size && !COMPACT(state))
+		hoedown_buffer_putc(ob, '\n');
+}
+
+static void
+inventory_add(const hoedown_renderer_data *data, hoedown_html_inventory_type type, const void *name, size_t size)
+{
+	hoedown_html_renderer_state *state = data->opaque;
+
+	if (state->inventory)
+		hoedown_html_inventory_add(state->inventory, type, name, size);
+}
+
 /********************
  * GENERIC RENDERER *
  ********************/
@@ -72,6 +99,18 @@ rndr_autolink(hoedown_buffer *ob, const hoedown_buffer *link, hoedown_autolink_t
 		HOEDOWN_BUFPUTSL(ob, "mailto:");
 	escape_href(ob, link->data, link->size);
 
+	if (state->inventory) {
+		if (type == HOEDOWN_AUTOLINK_EMAIL && hoedown_buffer_prefix(link, "mailto:") != 0) {
+			hoedown_buffer *href = hoedown_buffer_new(link->size + 7);
+			HOEDOWN_BUFPUTSL(href, "mailto:");
+			hoedown_buffer_put(href, link->data, link->size);
+			hoedown_html_inventory_add(state->inventory, HOEDOWN_HTML_LINK_AUTOLINK, href->data, href->size);
+			hoedown_buffer_free(href);
+		} else {
+			hoedown_html_inventory_add(state->inventory, HOEDOWN_HTML_LINK_AUTOLINK, link->data, link->size);
+		}
+	}
+
 	if (state->link_attributes) {
 		hoedown_buffer_putc(ob, '\"');
 		state->link_attributes(ob, link, data);
@@ -99,21 +138,20 @@ rndr_autolink(hoedown_buffer *ob, const hoedown_buffer *link, hoedown_autolink_t
 static void
 rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buffer *lang, const hoedown_renderer_data *data)
 {
-    printf("xxxooo fun:%s() ob: %p, text: %p, lang: %p\n", __FUNCTION__, ob, text, lang);
-	if (ob->size) hoedown_buffer_putc(ob, '\n');
 	hoedown_html_renderer_state *state = data->opaque;
+	block_newline(ob, state);
 	if (lang && (state->flags & SCIDOWN_RENDER_CHARTER) != 0 && hoedown_buffer_eqs(lang, "charter") != 0){
 		if (text) {
 
 			char * copy = malloc((text->size + 1)*sizeof(char));
-			memset(copy, 0, text->size+1);
 			memcpy(copy, text->data, text->size);
+			copy[text->size] = 0;
 
 			chart * c =  parse_chart(copy);
 			char * svg = chart_to_svg(c);
 
-			int n = strlen(svg);
-			hoedown_buffer_printf(ob, svg, n);
+			/* the chart is not a format string, its % are output as is */
+			hoedown_buffer_puts(ob, svg);
 
 			free(copy);
 			chart_free(c);
@@ -126,14 +164,12 @@ rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buf
 	if (lang &&  (state->flags & SCIDOWN_RENDER_GNUPLOT) != 0 && hoedown_buffer_eqs(lang, "gnuplot"))
 	{
 		if (text && text->size) {
-			char * copy = malloc((text->size + 1)*sizeof(char));
-			memset(copy, 0, text->size+1);
-			memcpy(copy, text->data, text->size);
-			hoedown_buffer * b = hoedown_buffer_new(1);
-			hoedown_buffer_printf(b, "gnuplot -e 'set term svg size 300,200;\n%s'", copy);
+			hoedown_buffer_small small;
+			hoedown_buffer * b = hoedown_buffer_init_small(&small, 64);
+			hoedown_buffer_printf(b, "gnuplot -e 'set term svg size 300,200;\n%.*s'", (int)text->size, text->data);
 
-			FILE *p = popen((char*)b->data, "r");
-			hoedown_buffer_free(b);
+			FILE *p = popen(hoedown_buffer_cstr(b), "r");
+			hoedown_buffer_uninit(b);
 			char *buffer = (char *)malloc(MAX_FILE_SIZE);
 			if (buffer) {
                 size_t i;
@@ -151,7 +187,7 @@ rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buf
                 }
                 if (i)
                 {
-                    hoedown_buffer_printf(ob, buffer, i);
+                    hoedown_buffer_put(ob, (uint8_t *)buffer, i);
                 }
                 free(buffer);
 			}
@@ -179,16 +215,21 @@ rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buf
 	if (text)
 		escape_html(ob, text->data, text->size);
 
-	HOEDOWN_BUFPUTSL(ob, "</code></pre>\n");
+	HOEDOWN_BUFPUTSL(ob, "</code></pre>");
+	put_newline(ob, state);
 }
 
 static void
 rndr_blockquote(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
 {
-	if (ob->size) hoedown_buffer_putc(ob, '\n');
-	HOEDOWN_BUFPUTSL(ob, "<blockquote>\n");
+	hoedown_html_renderer_state *state = data->opaque;
+
+	block_newline(ob, state);
+	HOEDOWN_BUFPUTSL(ob, "<blockquote>");
+	put_newline(ob, state);
 	if (content) hoedown_buffer_put(ob, content->data, content->size);
-	HOEDOWN_BUFPUTSL(ob, "</blockquote>\n");
+	HOEDOWN_BUFPUTSL(ob, "</blockquote>");
+	put_newline(ob, state);
 }
 
 static int
@@ -278,24 +319,33 @@ static int
 rndr_linebreak(hoedown_buffer *ob, const hoedown_renderer_data *data)
 {
 	hoedown_html_renderer_state *state = data->opaque;
-	hoedown_buffer_puts(ob, USE_XHTML(state) ? "<br/>\n" : "<br>\n");
+	hoedown_buffer_puts(ob, USE_XHTML(state) ? "<br/>" : "<br>");
+	put_newline(ob, state);
 	return 1;
 }
 
 static void
 rndr_header(hoedown_buffer *ob, const hoedown_buffer *content, int level, const hoedown_renderer_data *data, h_counter counter, int numbering)
 {
-	if (ob->size)
-		hoedown_buffer_putc(ob, '\n');
+	hoedown_html_renderer_state *state = data->opaque;
+	char id[64];
+	int id_size = 0;
+
+	block_newline(ob, state);
 
 	if (level > 3) {
-		hoedown_buffer_printf(ob, "<h%d id=\"toc_%d.%d.%d.%d\">", level+1, counter.chapter, counter.section, counter.subsection, level);
+		id_size = snprintf(id, sizeof(id), "toc_%d.%d.%d.%d", counter.chapter, counter.section, counter.subsection, level);
 	} else if (counter.subsection) {
-		hoedown_buffer_printf(ob, "<h%d id=\"toc_%d.%d.%d\">", level+1, counter.chapter, counter.section, counter.subsection);
+		id_size = snprintf(id, sizeof(id), "toc_%d.%d.%d", counter.chapter, counter.section, counter.subsection);
 	} else if (counter.section) {
-		hoedown_buffer_printf(ob, "<h%d id=\"toc_%d.%d\">", level+1, counter.chapter, counter.section);
+		id_size = snprintf(id, sizeof(id), "toc_%d.%d", counter.chapter, counter.section);
 	} else if (counter.chapter) {
-		hoedown_buffer_printf(ob, "<h%d id=\"toc_%d\">", level+1, counter.chapter);
+		id_size = snprintf(id, sizeof(id), "toc_%d", counter.chapter);
+	}
+
+	if (id_size > 0) {
+		hoedown_buffer_printf(ob, "<h%d id=\"%s\">", level+1, id);
+		inventory_add(data, HOEDOWN_HTML_ANCHOR_HEADER, id, id_size);
 	}
 
 	if (numbering && level <= 3)
@@ -311,7 +361,8 @@ rndr_header(hoedown_buffer *ob, const hoedown_buffer *content, int level, const
 
 
 	if (content) hoedown_buffer_put(ob, content->data, content->size);
-	hoedown_buffer_printf(ob, "</h%d>\n", level+1);
+	hoedown_buffer_printf(ob, "</h%d>", level+1);
+	put_newline(ob, state);
 }
 
 static int
@@ -321,8 +372,10 @@ rndr_link(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_buffe
 
 	HOEDOWN_BUFPUTSL(ob, "<a href=\"");
 
-	if (link && link->size)
+	if (link && link->size) {
 		escape_href(ob, link->data, link->size);
+		inventory_add(data, HOEDOWN_HTML_LINK, link->data, link->size);
+	}
 
 	if (title && title->size) {
 		HOEDOWN_BUFPUTSL(ob, "\" title=\"");
@@ -345,10 +398,14 @@ rndr_link(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_buffe
 static void
 rndr_list(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_list_flags flags, const hoedown_renderer_data *data)
 {
-	if (ob->size) hoedown_buffer_putc(ob, '\n');
-	hoedown_buffer_puts(ob, (flags & HOEDOWN_LIST_ORDERED ? "<ol dir=\"auto\">\n" : "<ul dir=\"auto\">\n"));
+	hoedown_html_renderer_state *state = data->opaque;
+
+	block_newline(ob, state);
+	hoedown_buffer_printf(ob, "<%s%s>", flags & HOEDOWN_LIST_ORDERED ? "ol" : "ul", DIR_AUTO(state));
+	put_newline(ob, state);
 	if (content) hoedown_buffer_put(ob, content->data, content->size);
-	hoedown_buffer_put(ob, (const uint8_t *)(flags & HOEDOWN_LIST_ORDERED ? "</ol>\n" : "</ul>\n"), 6);
+	hoedown_buffer_put(ob, (const uint8_t *)(flags & HOEDOWN_LIST_ORDERED ? "</ol>" : "</ul>"), 5);
+	put_newline(ob, state);
 }
 
 static void
@@ -368,7 +425,8 @@ rndr_listitem(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_list_fl
 			size--;
 
 		hoedown_buffer_put(ob, content->data, size);
-        HOEDOWN_BUFPUTSL(ob, "</li>\n");
+        HOEDOWN_BUFPUTSL(ob, "</li>");
+		put_newline(ob, data->opaque);
     }
 }
 
@@ -378,12 +436,12 @@ rndr_paragraph(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_
 	hoedown_html_renderer_state *state = data->opaque;
 	size_t i = 0;
 
-	if (ob->size) hoedown_buffer_putc(ob, '\n');
+	block_newline(ob, state);
 
 	if (!content || !content->size)
 		return;
 
-	while (i < content->size && isspace(content->data[i])) i++;
+	while (i < content->size && hoedown_isspace(content->data[i])) i++;
 
 	if (i == content->size)
 		return;
@@ -412,12 +470,14 @@ rndr_paragraph(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_
 	} else {
 		hoedown_buffer_put(ob, content->data + i, content->size - i);
 	}
-	HOEDOWN_BUFPUTSL(ob, "</p>\n");
+	HOEDOWN_BUFPUTSL(ob, "</p>");
+	put_newline(ob, state);
 }
 
 static void
 rndr_raw_block(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
 {
+	hoedown_html_renderer_state *state = data->opaque;
 	size_t org, sz;
 
 	if (!text)
@@ -435,11 +495,13 @@ rndr_raw_block(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_ren
 	if (org >= sz)
 		return;
 
-	if (ob->size)
-		hoedown_buffer_putc(ob, '\n');
+	block_newline(ob, state);
 
-	hoedown_buffer_put(ob, text->data + org, sz - org);
-	hoedown_buffer_putc(ob, '\n');
+	if (state->flags & SCIDOWN_RENDER_SANITIZE)
+		hoedown_html_sanitize(ob, text->data + org, sz - org);
+	else
+		hoedown_buffer_put(ob, text->data + org, sz - org);
+	put_newline(ob, state);
 }
 
 static int
@@ -457,15 +519,18 @@ rndr_hrule(hoedown_buffer *ob, const hoedown_renderer_data *data)
 {
 
 	hoedown_html_renderer_state *state = data->opaque;
-	if (ob->size) hoedown_buffer_putc(ob, '\n');
+	block_newline(ob, state);
 	if (data->meta->doc_class == CLASS_BEAMER) {
-		hoedown_buffer_puts(ob, "</div></div>\n");
+		hoedown_buffer_puts(ob, "</div></div>");
+		put_newline(ob, state);
 		if (data->meta->paper_size == B169)
 			hoedown_buffer_puts(ob, "<div class=\"slide slide_169\"><div class=\"slide_body\">");
 		else
 			hoedown_buffer_puts(ob, "<div class=\"slide\"><div class=\"slide_body\">");
-	} else
-		hoedown_buffer_puts(ob, USE_XHTML(state) ? "<hr/>\n" : "<hr>\n");
+	} else {
+		hoedown_buffer_puts(ob, USE_XHTML(state) ? "<hr/>" : "<hr>");
+		put_newline(ob, state);
+	}
 }
 
 static int
@@ -478,6 +543,7 @@ rndr_image(hoedown_buffer *ob, const hoedown_buffer *link, const hoedown_buffer
 
 	HOEDOWN_BUFPUTSL(ob, "<img src=\"");
 	escape_href(ob, link->data, link->size);
+	inventory_add(data, HOEDOWN_HTML_LINK_IMAGE, link->data, link->size);
 	HOEDOWN_BUFPUTSL(ob, "\" alt=\"");
 
 	if (alt && alt->size)
@@ -507,6 +573,11 @@ rndr_raw_html(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_rend
 	if ((state->flags & SCIDOWN_RENDER_SKIP_HTML) != 0)
 		return 1;
 
+	if ((state->flags & SCIDOWN_RENDER_SANITIZE) != 0) {
+		hoedown_html_sanitize(ob, text->data, text->size);
+		return 1;
+	}
+
 	hoedown_buffer_put(ob, text->data, text->size);
 	return 1;
 }
@@ -514,36 +585,52 @@ rndr_raw_html(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_rend
 static void
 rndr_table(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data, hoedown_table_flags *flags, int cols)
 {
-    if (ob->size) hoedown_buffer_putc(ob, '\n');
-	HOEDOWN_BUFPUTSL(ob, "<table dir=\"auto\">\n");
-    hoedown_buffer_put(ob, content->data, content->size);
-    HOEDOWN_BUFPUTSL(ob, "</table>\n");
+	hoedown_html_renderer_state *state = data->opaque;
+
+	block_newline(ob, state);
+	hoedown_buffer_printf(ob, "<table%s>", DIR_AUTO(state));
+	put_newline(ob, state);
+	hoedown_buffer_put(ob, content->data, content->size);
+	HOEDOWN_BUFPUTSL(ob, "</table>");
+	put_newline(ob, state);
 }
 
 static void
 rndr_table_header(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
 {
-    if (ob->size) hoedown_buffer_putc(ob, '\n');
-    HOEDOWN_BUFPUTSL(ob, "<thead>\n");
-    hoedown_buffer_put(ob, content->data, content->size);
-    HOEDOWN_BUFPUTSL(ob, "</thead>\n");
+	hoedown_html_renderer_state *state = data->opaque;
+
+	block_newline(ob, state);
+	HOEDOWN_BUFPUTSL(ob, "<thead>");
+	put_newline(ob, state);
+	hoedown_buffer_put(ob, content->data, content->size);
+	HOEDOWN_BUFPUTSL(ob, "</thead>");
+	put_newline(ob, state);
 }
 
 static void
 rndr_table_body(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
 {
-    if (ob->size) hoedown_buffer_putc(ob, '\n');
-    HOEDOWN_BUFPUTSL(ob, "<tbody>\n");
-    hoedown_buffer_put(ob, content->data, content->size);
-    HOEDOWN_BUFPUTSL(ob, "</tbody>\n");
+	hoedown_html_renderer_state *state = data->opaque;
+
+	block_newline(ob, state);
+	HOEDOWN_BUFPUTSL(ob, "<tbody>");
+	put_newline(ob, state);
+	hoedown_buffer_put(ob, content->data, content->size);
+	HOEDOWN_BUFPUTSL(ob, "</tbody>");
+	put_newline(ob, state);
 }
 
 static void
 rndr_tablerow(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
 {
-	HOEDOWN_BUFPUTSL(ob, "<tr>\n");
+	hoedown_html_renderer_state *state = data->opaque;
+
+	HOEDOWN_BUFPUTSL(ob, "<tr>");
+	put_newline(ob, state);
 	if (content) hoedown_buffer_put(ob, content->data, content->size);
-	HOEDOWN_BUFPUTSL(ob, "</tr>\n");
+	HOEDOWN_BUFPUTSL(ob, "</tr>");
+	put_newline(ob, state);
 }
 
 static void
@@ -576,10 +663,11 @@ rndr_tablecell(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_table_
 		hoedown_buffer_put(ob, content->data, content->size);
 
 	if (flags & HOEDOWN_TABLE_HEADER) {
-		HOEDOWN_BUFPUTSL(ob, "</th>\n");
+		HOEDOWN_BUFPUTSL(ob, "</th>");
 	} else {
-		HOEDOWN_BUFPUTSL(ob, "</td>\n");
+		HOEDOWN_BUFPUTSL(ob, "</td>");
 	}
+	put_newline(ob, data->opaque);
 }
 
 static int
@@ -604,21 +692,23 @@ rndr_footnotes(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_
 {
 	hoedown_html_renderer_state *state = data->opaque;
 
-	if (ob->size) hoedown_buffer_putc(ob, '\n');
-	HOEDOWN_BUFPUTSL(ob, "<div class=\"footnotes\">\n");
-	hoedown_buffer_puts(ob, USE_XHTML(state) ? "<hr/>\n" : "<hr>\n");
-	HOEDOWN_BUFPUTSL(ob, "<ol>\n");
+	block_newline(ob, state);
+	hoedown_buffer_puts(ob, COMPACT(state) ? "<div class=\"footnotes\">" : "<div class=\"footnotes\">\n");
+	hoedown_buffer_puts(ob, USE_XHTML(state) ? "<hr/>" : "<hr>");
+	hoedown_buffer_puts(ob, COMPACT(state) ? "<ol>" : "\n<ol>\n");
 
 	if (content) hoedown_buffer_put(ob, content->data, content->size);
 
-	HOEDOWN_BUFPUTSL(ob, "\n</ol>\n</div>\n");
+	hoedown_buffer_puts(ob, COMPACT(state) ? "</ol></div>" : "\n</ol>\n</div>\n");
 }
 
 static void
 rndr_footnote_def(hoedown_buffer *ob, const hoedown_buffer *content, unsigned int num, const hoedown_renderer_data *data)
 {
+	hoedown_html_renderer_state *state = data->opaque;
 	size_t i = 0;
 	int pfound = 0;
+	char id[32];
 
 	/* insert anchor at the end of first paragraph block */
 	if (content) {
@@ -633,22 +723,29 @@ rndr_footnote_def(hoedown_buffer *ob, const hoedown_buffer *content, unsigned in
 		}
 	}
 
-	hoedown_buffer_printf(ob, "\n<li id=\"fn%d\">\n", num);
+	hoedown_buffer_printf(ob, COMPACT(state) ? "<li id=\"fn%d\">" : "\n<li id=\"fn%d\">\n", num);
+	inventory_add(data, HOEDOWN_HTML_ANCHOR_FOOTNOTE, id, snprintf(id, sizeof(id), "fn%u", num));
 	if (pfound) {
 		hoedown_buffer_put(ob, content->data, i);
 		hoedown_buffer_printf(ob, "&nbsp;<a href=\"#fnref%d\" rev=\"footnote\">&#8617;</a>", num);
+		inventory_add(data, HOEDOWN_HTML_LINK_FOOTNOTE, id, snprintf(id, sizeof(id), "#fnref%u", num));
 		hoedown_buffer_put(ob, content->data + i, content->size - i);
 	} else if (content) {
 		hoedown_buffer_put(ob, content->data, content->size);
 	}
-	HOEDOWN_BUFPUTSL(ob, "</li>\n");
+	HOEDOWN_BUFPUTSL(ob, "</li>");
+	put_newline(ob, state);
 }
 
 static int
 rndr_footnote_ref(hoedown_buffer *ob, int num, const hoedown_renderer_data *data)
 {
+	char id[32];
+
 	if (num >= 0) {
 		hoedown_buffer_printf(ob, "<sup id=\"fnref%d\"><a href=\"#fn%d\" rel=\"footnote\">%d</a></sup>", num, num, num);
+		inventory_add(data, HOEDOWN_HTML_ANCHOR_FOOTNOTE, id, snprintf(id, sizeof(id), "fnref%d", num));
+		inventory_add(data, HOEDOWN_HTML_LINK_FOOTNOTE, id, snprintf(id, sizeof(id), "#fn%d", num));
 	} else {
 		hoedown_buffer_printf(ob, "<sup>?</sup>");
 	}
@@ -728,7 +825,8 @@ rndr_affiliation(hoedown_buffer *ob, const hoedown_buffer *content,  const hoedo
 {
 	hoedown_buffer_puts(ob, "<div class=\"affiliation\">");
 	escape_html(ob, content->data, content->size);
-	hoedown_buffer_puts(ob, "</div>\n");
+	hoedown_buffer_puts(ob, "</div>");
+	put_newline(ob, data->opaque);
 }
 
 static void
@@ -737,7 +835,8 @@ rndr_keywords(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_r
 	hoedown_buffer_puts(ob, "<div class=\"keywords\">");
 	hoedown_buffer_puts(ob, "<b>Keywords: </b>");
 	escape_html(ob, content->data, content->size);
-	hoedown_buffer_puts(ob, "</div>\n");
+	hoedown_buffer_puts(ob, "</div>");
+	put_newline(ob, data->opaque);
 }
 
 static void
@@ -745,13 +844,18 @@ rndr_begin(hoedown_buffer *ob,  const hoedown_renderer_data *data)
 {
 	if (data->meta->doc_class == CLASS_BEAMER) {
 		if (data->meta->title || data->meta->authors || data->meta->affiliation) {
+			hoedown_buffer_puts(ob, "<div class=\"document\">");
+			put_newline(ob, data->opaque);
 			if (data->meta->paper_size == B169)
-				hoedown_buffer_puts(ob, "<div class=\"document\">\n<div class=\"header slide slide_169\"><div class=\"slide_body\">");
+				hoedown_buffer_puts(ob, "<div class=\"header slide slide_169\"><div class=\"slide_body\">");
 			else
-				hoedown_buffer_puts(ob, "<div class=\"document\">\n<div class=\"header slide\"><div class=\"slide_body\">");
+				hoedown_buffer_puts(ob, "<div class=\"header slide\"><div class=\"slide_body\">");
 		}
-	} else
-		hoedown_buffer_puts(ob, "<div class=\"document\">\n<div class=\"header\">");
+	} else {
+		hoedown_buffer_puts(ob, "<div class=\"document\">");
+		put_newline(ob, data->opaque);
+		hoedown_buffer_puts(ob, "<div class=\"header\">");
+	}
 }
 
 static void
@@ -775,15 +879,18 @@ rndr_inner(hoedown_buffer *ob, const hoedown_renderer_data *data)
 static void
 rndr_end(hoedown_buffer *ob, ext_definition * extension, const hoedown_renderer_data *data)
 {
+	hoedown_html_renderer_state *state = data->opaque;
+
 	if (data->meta->doc_class == CLASS_BEAMER) {
-		hoedown_buffer_puts(ob, "</div></div>\n");
+		hoedown_buffer_puts(ob, "</div></div>");
+		put_newline(ob, state);
 	}
-	hoedown_buffer_puts(ob, "</div>\n</div>\n");
+	hoedown_buffer_puts(ob, COMPACT(state) ? "</div></div>" : "</div>\n</div>\n");
 	if (extension && extension->extra_closing)
 	{
 		hoedown_buffer_puts(ob, extension->extra_closing);
 	}
-	hoedown_buffer_puts(ob, "</body>\n</html>\n");
+	hoedown_buffer_puts(ob, COMPACT(state) ? "</body></html>\n" : "</body>\n</html>\n");
 }
 
 static void
@@ -804,8 +911,18 @@ rndr_close(hoedown_buffer *ob){
 	hoedown_buffer_puts(ob, "\n</div>\n");
 }
 
-static int rndr_ref (hoedown_buffer *ob, char * id, int count)
+static int rndr_ref (hoedown_buffer *ob, char * id, int count, const hoedown_renderer_data *data)
 {
+	hoedown_html_renderer_state *state = data->opaque;
+
+	if (state->inventory) {
+		hoedown_buffer *href = hoedown_buffer_new(strlen(id) + 1);
+		hoedown_buffer_putc(href, '#');
+		hoedown_buffer_puts(href, id);
+		hoedown_html_inventory_add(state->inventory, HOEDOWN_HTML_LINK_REF, href->data, href->size);
+		hoedown_buffer_free(href);
+	}
+
 	if (count < 0 )	{
 		hoedown_buffer_printf(ob, "<a href=\"#%s\">(\?\?)</a>", id);
 	}else {
@@ -819,12 +936,14 @@ static void rndr_open_equation(hoedown_buffer *ob, const char * ref, const hoedo
 	if (ref){
 		hoedown_buffer_puts(ob,"<div id=\"");
 		hoedown_buffer_puts(ob, ref);
-		hoedown_buffer_puts(ob, "\" class=\"equation\">\n");
+		hoedown_buffer_puts(ob, "\" class=\"equation\">");
+		inventory_add(data, HOEDOWN_HTML_ANCHOR_EQUATION, ref, strlen(ref));
 	}
 	else {
-		hoedown_buffer_puts(ob, "<div class=\"equation\">\n");
+		hoedown_buffer_puts(ob, "<div class=\"equation\">");
 	}
 	hoedown_html_renderer_state *state = data->opaque;
+	put_newline(ob, state);
 	state->counter.equation ++;
 	hoedown_buffer_printf(ob, "<table class=\"eq_table\"><tr><td class=\"eq_code\">");
 }
@@ -832,7 +951,8 @@ static void rndr_open_equation(hoedown_buffer *ob, const char * ref, const hoedo
 static void rndr_close_equation(hoedown_buffer *ob, const hoedown_renderer_data *data)
 {
 	hoedown_html_renderer_state *state = data->opaque;
-	hoedown_buffer_printf(ob, "</td><td class=\"counter\">\\[(%d)\\]</td></tr></table></div>\n", state->counter.equation);
+	hoedown_buffer_printf(ob, "</td><td class=\"counter\">\\[(%d)\\]</td></tr></table></div>", state->counter.equation);
+	put_newline(ob, state);
 }
 
 static void rndr_open_float(hoedown_buffer *ob, float_args args, const hoedown_renderer_data *data)
@@ -840,10 +960,13 @@ static void rndr_open_float(hoedown_buffer *ob, float_args args, const hoedown_r
 	if (args.id){
 		hoedown_buffer_puts(ob,"<figure id=\"");
 		hoedown_buffer_puts(ob, args.id);
-		hoedown_buffer_puts(ob, "\">\n");
+		hoedown_buffer_puts(ob, "\">");
+		put_newline(ob, data->opaque);
+		inventory_add(data, HOEDOWN_HTML_ANCHOR_FLOAT, args.id, strlen(args.id));
 		return;
 	}
-	hoedown_buffer_puts(ob, "<figure>\n");
+	hoedown_buffer_puts(ob, "<figure>");
+	put_newline(ob, data->opaque);
 }
 
 static void rnrd_close_float(hoedown_buffer *ob, float_args args, const hoedown_renderer_data *data)
@@ -870,23 +993,29 @@ static void rnrd_close_float(hoedown_buffer *ob, float_args args, const hoedown_
 			break;
 		}
 		hoedown_buffer_puts(ob, args.caption);
-		hoedown_buffer_puts(ob, "</figcaption>\n");
+		hoedown_buffer_puts(ob, "</figcaption>");
+		put_newline(ob, state);
 	}
-	hoedown_buffer_puts(ob, "</figure>\n");
+	hoedown_buffer_puts(ob, "</figure>");
+	put_newline(ob, state);
 }
 
 static void
-rndr_toc_entry(hoedown_buffer *ob, toc * tree, int * chapter, int * section, int * subsection, int numbering)
+rndr_toc_entry(hoedown_buffer *ob, toc * tree, int * chapter, int * section, int * subsection, int numbering, const hoedown_html_renderer_state *state)
 {
 	if (!tree)
 		return;
 	if (tree->nesting == 1) {
-		if ((*chapter))
-			hoedown_buffer_puts(ob, "</ul>\n");
+		if ((*chapter)) {
+			hoedown_buffer_puts(ob, "</ul>");
+			put_newline(ob, state);
+		}
 		(*chapter) ++;
 
-		if ((*section))
-			hoedown_buffer_puts(ob, "</ul>\n");
+		if ((*section)) {
+			hoedown_buffer_puts(ob, "</ul>");
+			put_newline(ob, state);
+		}
 
 		(*section) = 0;
 		(*subsection) = 0;
@@ -894,17 +1023,25 @@ rndr_toc_entry(hoedown_buffer *ob, toc * tree, int * chapter, int * section, int
 		hoedown_buffer_printf(ob, "<li><a href=\"#toc_%d\">", (*chapter));
 		if (numbering)
 			hoedown_buffer_printf(ob, "%d. ", (*chapter));
-		hoedown_buffer_printf(ob, "%s</a></li>\n<ul dir=\"auto\">\n", tree->text);
+		hoedown_buffer_printf(ob, "%s</a></li>", tree->text);
+		put_newline(ob, state);
+		hoedown_buffer_printf(ob, "<ul%s>", DIR_AUTO(state));
+		put_newline(ob, state);
 	} else if (tree->nesting == 2)
 	{
-		if ((*section))
-			hoedown_buffer_puts(ob, "</ul>\n");
+		if ((*section)) {
+			hoedown_buffer_puts(ob, "</ul>");
+			put_newline(ob, state);
+		}
 		(*section) ++;
 		(*subsection) = 0;
 		hoedown_buffer_printf(ob, "<li><a href=\"#toc_%d.%d\">", (*chapter), (*section));
 		if (numbering)
 			hoedown_buffer_printf(ob, "%d.%d. ", (*chapter), (*section));
-		hoedown_buffer_printf(ob, "%s</a></li>\n<ul dir=\"auto\">\n", tree->text);
+		hoedown_buffer_printf(ob, "%s</a></li>", tree->text);
+		put_newline(ob, state);
+		hoedown_buffer_printf(ob, "<ul%s>", DIR_AUTO(state));
+		put_newline(ob, state);
 	} else if (tree->nesting == 3)
 	{
 		(*subsection) ++;
@@ -913,18 +1050,24 @@ rndr_toc_entry(hoedown_buffer *ob, toc * tree, int * chapter, int * section, int
 		if (numbering)
 			hoedown_buffer_printf(ob, "%d.%d.%d. ",
 			                      (*chapter), (*section), (*subsection));
-		hoedown_buffer_printf(ob, "%s</a></li>\n",tree->text);
+		hoedown_buffer_printf(ob, "%s</a></li>",tree->text);
+		put_newline(ob, state);
 	}
-	rndr_toc_entry(ob, tree->sibling, chapter, section, subsection, numbering);
+	rndr_toc_entry(ob, tree->sibling, chapter, section, subsection, numbering, state);
 }
 
 static void
-rndr_toc(hoedown_buffer *ob, toc * tree, int numbering)
+rndr_toc(hoedown_buffer *ob, toc * tree, int numbering, const hoedown_renderer_data *data)
 {
-	hoedown_buffer_puts(ob, "<div class=\"toc_container\">\n<h2 class=\"toc_header\">Table of Contents</h2>\n<ul class=\"toc_list\">\n");
+	hoedown_html_renderer_state *state = data->opaque;
+
+	hoedown_buffer_puts(ob, COMPACT(state) ?
+		"<div class=\"toc_container\"><h2 class=\"toc_header\">Table of Contents</h2><ul class=\"toc_list\">" :
+		"<div class=\"toc_container\">\n<h2 class=\"toc_header\">Table of Contents</h2>\n<ul class=\"toc_list\">\n");
 	int cpt=0, sct=0, sbs=0;
-	rndr_toc_entry(ob, tree, &cpt, &sct, &sbs, numbering);
-	hoedown_buffer_puts(ob, "</ul></div>\n");
+	rndr_toc_entry(ob, tree, &cpt, &sct, &sbs, numbering, state);
+	hoedown_buffer_puts(ob, "</ul></div>");
+	put_newline(ob, state);
 }
 
 static void
@@ -1057,6 +1200,9 @@ hoedown_html_toc_renderer_new(int nesting_level, localization local)
 
 		NULL,
 		toc_finalize,
+		NULL,
+
+		NULL,
 		NULL
 	};
 
@@ -1146,6 +1292,9 @@ hoedown_html_renderer_new(scidown_render_flags render_flags, int nesting_level,
 		NULL,
 		NULL,
 		rndr_position,
+
+		NULL,
+		NULL,
 	};
 
 	hoedown_html_renderer_state *state;
@@ -1177,6 +1326,17 @@ hoedown_html_renderer_new(scidown_render_flags render_flags, int nesting_level,
 	return renderer;
 }
 
+void
+hoedown_html_renderer_reset(hoedown_renderer *renderer)
+{
+	hoedown_html_renderer_state *state = renderer->opaque;
+
+	memset(&state->counter, 0, sizeof(state->counter));
+	state->toc_data.header_count = 0;
+	state->toc_data.current_level = 0;
+	state->toc_data.level_offset = 0;
+}
+
 void
 hoedown_html_renderer_free(hoedown_renderer *renderer)
 {
@@ -13,7 +13,55 @@ extern "C" {
 #endif
 
 
+/*************
+ * CONSTANTS *
+ *************/
+
+/* hoedown_html_inventory_type: what emitted an inventory entry; anchors
+ * are stored as ids, links as the raw href (internal ones start with '#') */
+typedef enum hoedown_html_inventory_type {
+	HOEDOWN_HTML_ANCHOR_HEADER,
+	HOEDOWN_HTML_ANCHOR_FLOAT,
+	HOEDOWN_HTML_ANCHOR_EQUATION,
+	HOEDOWN_HTML_ANCHOR_FOOTNOTE,
+	HOEDOWN_HTML_LINK,
+	HOEDOWN_HTML_LINK_AUTOLINK,
+	HOEDOWN_HTML_LINK_IMAGE,
+	HOEDOWN_HTML_LINK_REF,
+	HOEDOWN_HTML_LINK_FOOTNOTE
+} hoedown_html_inventory_type;
+
+#define HOEDOWN_HTML_IS_ANCHOR(type) ((type) < HOEDOWN_HTML_LINK)
+
+
+/*********
+ * TYPES *
+ *********/
+
+/* hoedown_html_inventory_entry: one anchor or link, its name is
+ * names->data[offset .. offset + size) */
+struct hoedown_html_inventory_entry {
+	hoedown_html_inventory_type type;
+	uint32_t hash;	/* scidown_hash of the name, stable across documents */
+	size_t offset;
+	size_t size;
+};
+typedef struct hoedown_html_inventory_entry hoedown_html_inventory_entry;
 
+/* hoedown_html_inventory: every anchor and link emitted by a render, in output order;
+ * anchors are also indexed by hash in an open addressed table of entry indices + 1 */
+struct hoedown_html_inventory {
+	hoedown_buffer *names;
+
+	hoedown_html_inventory_entry *entries;
+	size_t count;
+	size_t asize;
+
+	size_t *anchors;
+	size_t anchor_count;
+	size_t anchor_slots;
+};
+typedef struct hoedown_html_inventory hoedown_html_inventory;
 
 struct hoedown_html_renderer_state {
 	void *opaque;
@@ -29,6 +77,9 @@ struct hoedown_html_renderer_state {
 	html_counter counter;
 	localization localization;
 
+	/* optional, filled while rendering when not NULL */
+	hoedown_html_inventory *inventory;
+
 	/* extra callbacks */
 	void (*link_attributes)(hoedown_buffer *ob, const hoedown_buffer *url, const hoedown_renderer_data *data);
 };
@@ -42,9 +93,30 @@ typedef struct hoedown_html_renderer_state hoedown_html_renderer_state;
 /* hoedown_html_smartypants: process an HTML snippet using SmartyPants for smart punctuation */
 void hoedown_html_smartypants(hoedown_buffer *ob, const uint8_t *data, size_t size);
 
+/* hoedown_html_sanitize: write an HTML fragment with only the allow-listed
+ * tags and attributes, and URLs with a safe scheme; other tags are dropped,
+ * with their contents for script, style and the like. Comments are dropped
+ * and a '<' opening no tag is escaped */
+void hoedown_html_sanitize(hoedown_buffer *ob, const uint8_t *data, size_t size);
+
 /* hoedown_html_is_tag: checks if data starts with a specific tag, returns the tag type or NONE */
 scidown_render_tag hoedown_html_is_tag(const uint8_t *data, size_t size, const char *tagname);
 
+/* hoedown_html_inventory_new: allocate an empty inventory, attach it through the renderer state */
+hoedown_html_inventory *hoedown_html_inventory_new(void) __attribute__ ((malloc));
+
+/* hoedown_html_inventory_add: record an anchor or a link */
+void hoedown_html_inventory_add(hoedown_html_inventory *inventory, hoedown_html_inventory_type type, const uint8_t *data, size_t size);
+
+/* hoedown_html_inventory_find_anchor: look up the anchor an internal link
+ * points to, a leading '#' is ignored; returns NULL if there is none */
+const hoedown_html_inventory_entry *hoedown_html_inventory_find_anchor(const hoedown_html_inventory *inventory, const uint8_t *data, size_t size);
+
+/* hoedown_html_inventory_reset: forget every entry */
+void hoedown_html_inventory_reset(hoedown_html_inventory *inventory);
+
+/* hoedown_html_inventory_free: deallocate an inventory */
+void hoedown_html_inventory_free(hoedown_html_inventory *inventory);
 
 /* hoedown_html_renderer_new: allocates a regular HTML renderer */
 hoedown_renderer *hoedown_html_renderer_new(
@@ -59,6 +131,9 @@ hoedown_renderer *hoedown_html_toc_renderer_new(
 	localization local
 ) __attribute__ ((malloc));
 
+/* hoedown_html_renderer_reset: forget the float and header numbers of a previous render */
+void hoedown_html_renderer_reset(hoedown_renderer *renderer);
+
 /* hoedown_html_renderer_free: deallocate an HTML renderer */
 void hoedown_html_renderer_free(hoedown_renderer *renderer);
 
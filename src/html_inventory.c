@@ -0,0 +1,142 @@
+#include "html.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define INVENTORY_NAMES_UNIT 256
+#define INVENTORY_INITIAL_SIZE 32
+#define INVENTORY_INITIAL_SLOTS 64
+
+
+/********************
+ * HELPER FUNCTIONS *
+ ********************/
+
+/* anchor_slot: slot holding the anchor named data, or the empty slot where it goes */
+static size_t
+anchor_slot(const hoedown_html_inventory *inventory, uint32_t hash, const uint8_t *data, size_t size)
+{
+	const hoedown_html_inventory_entry *entry;
+	size_t mask = inventory->anchor_slots - 1;
+	size_t slot = hash & mask;
+
+	while (inventory->anchors[slot]) {
+		entry = &inventory->entries[inventory->anchors[slot] - 1];
+
+		if (entry->hash == hash && entry->size == size &&
+			memcmp(inventory->names->data + entry->offset, data, size) == 0)
+			break;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+/* index_anchor: index the last entry, the first anchor of a name is kept */
+static void
+index_anchor(hoedown_html_inventory *inventory)
+{
+	const hoedown_html_inventory_entry *entry;
+	size_t *old = inventory->anchors, old_slots = inventory->anchor_slots, i, slot;
+
+	if ((inventory->anchor_count + 1) * 2 > inventory->anchor_slots) {
+		inventory->anchor_slots = old_slots ? old_slots * 2 : INVENTORY_INITIAL_SLOTS;
+		inventory->anchors = hoedown_calloc(inventory->anchor_slots, sizeof(size_t));
+
+		for (i = 0; i < old_slots; ++i) {
+			if (!old[i])
+				continue;
+			entry = &inventory->entries[old[i] - 1];
+			slot = entry->hash & (inventory->anchor_slots - 1);
+			while (inventory->anchors[slot])
+				slot = (slot + 1) & (inventory->anchor_slots - 1);
+			inventory->anchors[slot] = old[i];
+		}
+
+		free(old);
+	}
+
+	entry = &inventory->entries[inventory->count - 1];
+	slot = anchor_slot(inventory, entry->hash, inventory->names->data + entry->offset, entry->size);
+
+	if (!inventory->anchors[slot]) {
+		inventory->anchors[slot] = inventory->count;
+		inventory->anchor_count++;
+	}
+}
+
+
+/**********************
+ * EXPORTED FUNCTIONS *
+ **********************/
+
+hoedown_html_inventory *
+hoedown_html_inventory_new(void)
+{
+	hoedown_html_inventory *inventory = hoedown_calloc(1, sizeof(hoedown_html_inventory));
+
+	inventory->names = hoedown_buffer_new(INVENTORY_NAMES_UNIT);
+
+	return inventory;
+}
+
+void
+hoedown_html_inventory_add(hoedown_html_inventory *inventory, hoedown_html_inventory_type type, const uint8_t *data, size_t size)
+{
+	hoedown_html_inventory_entry *entry;
+
+	if (inventory->count >= inventory->asize) {
+		inventory->asize = inventory->asize ? inventory->asize * 2 : INVENTORY_INITIAL_SIZE;
+		inventory->entries = hoedown_realloc(inventory->entries, inventory->asize * sizeof(hoedown_html_inventory_entry));
+	}
+
+	entry = &inventory->entries[inventory->count++];
+	entry->type = type;
+	entry->hash = scidown_hash(data, size);
+	entry->offset = inventory->names->size;
+	entry->size = size;
+
+	hoedown_buffer_put(inventory->names, data, size);
+
+	if (HOEDOWN_HTML_IS_ANCHOR(type))
+		index_anchor(inventory);
+}
+
+const hoedown_html_inventory_entry *
+hoedown_html_inventory_find_anchor(const hoedown_html_inventory *inventory, const uint8_t *data, size_t size)
+{
+	size_t slot;
+
+	if (size && data[0] == '#') {
+		data++;
+		size--;
+	}
+
+	if (!inventory->anchor_count)
+		return NULL;
+
+	slot = anchor_slot(inventory, scidown_hash(data, size), data, size);
+
+	return inventory->anchors[slot] ? &inventory->entries[inventory->anchors[slot] - 1] : NULL;
+}
+
+void
+hoedown_html_inventory_reset(hoedown_html_inventory *inventory)
+{
+	inventory->names->size = 0;
+	inventory->count = 0;
+
+	if (inventory->anchor_count)
+		memset(inventory->anchors, 0, inventory->anchor_slots * sizeof(size_t));
+	inventory->anchor_count = 0;
+}
+
+void
+hoedown_html_inventory_free(hoedown_html_inventory *inventory)
+{
+	hoedown_buffer_free(inventory->names);
+	free(inventory->entries);
+	free(inventory->anchors);
+	free(inventory);
+}
@@ -0,0 +1,360 @@
+/* ANSI-C code for html_safe_tags.gperf, in the layout of gperf 3.0.3 output */
+/* Command-line: gperf -L ANSI-C -N hoedown_find_safe_tag -c -C -E -S 1 --ignore-case -m100 -k'1,2,$' html_safe_tags.gperf  */
+/* Computed positions: -k'1-2,$' */
+
+#if !((' ' == 32) && ('!' == 33) && ('"' == 34) && ('#' == 35) \
+      && ('%' == 37) && ('&' == 38) && ('\'' == 39) && ('(' == 40) \
+      && (')' == 41) && ('*' == 42) && ('+' == 43) && (',' == 44) \
+      && ('-' == 45) && ('.' == 46) && ('/' == 47) && ('0' == 48) \
+      && ('1' == 49) && ('2' == 50) && ('3' == 51) && ('4' == 52) \
+      && ('5' == 53) && ('6' == 54) && ('7' == 55) && ('8' == 56) \
+      && ('9' == 57) && (':' == 58) && (';' == 59) && ('<' == 60) \
+      && ('=' == 61) && ('>' == 62) && ('?' == 63) && ('A' == 65) \
+      && ('B' == 66) && ('C' == 67) && ('D' == 68) && ('E' == 69) \
+      && ('F' == 70) && ('G' == 71) && ('H' == 72) && ('I' == 73) \
+      && ('J' == 74) && ('K' == 75) && ('L' == 76) && ('M' == 77) \
+      && ('N' == 78) && ('O' == 79) && ('P' == 80) && ('Q' == 81) \
+      && ('R' == 82) && ('S' == 83) && ('T' == 84) && ('U' == 85) \
+      && ('V' == 86) && ('W' == 87) && ('X' == 88) && ('Y' == 89) \
+      && ('Z' == 90) && ('[' == 91) && ('\\' == 92) && (']' == 93) \
+      && ('^' == 94) && ('_' == 95) && ('a' == 97) && ('b' == 98) \
+      && ('c' == 99) && ('d' == 100) && ('e' == 101) && ('f' == 102) \
+      && ('g' == 103) && ('h' == 104) && ('i' == 105) && ('j' == 106) \
+      && ('k' == 107) && ('l' == 108) && ('m' == 109) && ('n' == 110) \
+      && ('o' == 111) && ('p' == 112) && ('q' == 113) && ('r' == 114) \
+      && ('s' == 115) && ('t' == 116) && ('u' == 117) && ('v' == 118) \
+      && ('w' == 119) && ('x' == 120) && ('y' == 121) && ('z' == 122) \
+      && ('{' == 123) && ('|' == 124) && ('}' == 125) && ('~' == 126))
+/* The character set is not based on ISO-646.  */
+#error "gperf generated tables don't work with this execution character set. Please report a bug to <bug-gnu-gperf@gnu.org>."
+#endif
+
+/* maximum key range = 98, duplicates = 0 */
+
+#ifndef GPERF_DOWNCASE
+#define GPERF_DOWNCASE 1
+static unsigned char gperf_downcase[256] =
+  {
+      0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,
+     30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  43,  44,
+     45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,
+     60,  61,  62,  63,  64,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106,
+    107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121,
+    122,  91,  92,  93,  94,  95,  96,  97,  98,  99, 100, 101, 102, 103, 104,
+    105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119,
+    120, 121, 122, 123, 124, 125, 126, 127, 128, 129, 130, 131, 132, 133, 134,
+    135, 136, 137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147, 148, 149,
+    150, 151, 152, 153, 154, 155, 156, 157, 158, 159, 160, 161, 162, 163, 164,
+    165, 166, 167, 168, 169, 170, 171, 172, 173, 174, 175, 176, 177, 178, 179,
+    180, 181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194,
+    195, 196, 197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209,
+    210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223, 224,
+    225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237, 238, 239,
+    240, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254,
+    255
+  };
+#endif
+
+#ifndef GPERF_CASE_STRNCMP
+#define GPERF_CASE_STRNCMP 1
+static int
+gperf_case_strncmp (register const char *s1, register const char *s2, register unsigned int n)
+{
+  for (; n > 0;)
+    {
+      unsigned char c1 = gperf_downcase[(unsigned char)*s1++];
+      unsigned char c2 = gperf_downcase[(unsigned char)*s2++];
+      if (c1 != 0 && c1 == c2)
+        {
+          n--;
+          continue;
+        }
+      return (int)c1 - (int)c2;
+    }
+  return 0;
+}
+#endif
+
+#ifdef __GNUC__
+__inline
+#else
+#ifdef __cplusplus
+inline
+#endif
+#endif
+static unsigned int
+hash (register const char *str, register unsigned int len)
+{
+  static const unsigned char asso_values[] =
+    {
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99,  4,
+      31, 28, 20, 12, 15, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 32, 23, 28, 10, 11,
+       5, 12, 18,  2, 99,  5, 27, 22, 13, 32,
+      30, 26, 33,  1,  4,  0, 10, 14, 99,  3,
+      99, 99, 99, 99, 99, 99, 99, 32, 23, 28,
+      10, 11,  5, 12, 18,  2, 99,  5, 27, 22,
+      13, 32, 30, 26, 33,  1,  4,  0, 10, 14,
+      99,  3, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99
+    };
+  register int hval = (int)len;
+
+  switch (hval)
+    {
+      default:
+        hval += asso_values[(unsigned char)str[1]];
+      /*FALLTHROUGH*/
+      case 1:
+        hval += asso_values[(unsigned char)str[0]];
+        break;
+    }
+  return hval + asso_values[(unsigned char)str[len - 1]];
+}
+
+#ifdef __GNUC__
+__inline
+#ifdef __GNUC_STDC_INLINE__
+__attribute__ ((__gnu_inline__))
+#endif
+#endif
+const char *
+hoedown_find_safe_tag (register const char *str, register unsigned int len)
+{
+  enum
+    {
+      TOTAL_KEYWORDS = 64,
+      MIN_WORD_LENGTH = 1,
+      MAX_WORD_LENGTH = 10,
+      MIN_HASH_VALUE = 1,
+      MAX_HASH_VALUE = 98
+    };
+
+  if (len <= MAX_WORD_LENGTH && len >= MIN_WORD_LENGTH)
+    {
+      register int key = hash (str, len);
+
+      if (key <= MAX_HASH_VALUE && key >= MIN_HASH_VALUE)
+        {
+          register const char *resword;
+
+          switch (key - 1)
+            {
+              case 0:
+                resword = "u";
+                goto compare;
+              case 2:
+                resword = "s";
+                goto compare;
+              case 4:
+                resword = "i";
+                goto compare;
+              case 10:
+                resword = "summary";
+                goto compare;
+              case 13:
+                resword = "tt";
+                goto compare;
+              case 17:
+                resword = "tfoot";
+                goto compare;
+              case 18:
+                resword = "ins";
+                goto compare;
+              case 19:
+                resword = "dt";
+                goto compare;
+              case 20:
+                resword = "time";
+                goto compare;
+              case 21:
+                resword = "strike";
+                goto compare;
+              case 22:
+                resword = "strong";
+                goto compare;
+              case 23:
+                resword = "figure";
+                goto compare;
+              case 24:
+                resword = "div";
+                goto compare;
+              case 25:
+                resword = "td";
+                goto compare;
+              case 26:
+                resword = "sub";
+                goto compare;
+              case 27:
+                resword = "h1";
+                goto compare;
+              case 28:
+                resword = "details";
+                goto compare;
+              case 29:
+                resword = "figcaption";
+                goto compare;
+              case 30:
+                resword = "dfn";
+                goto compare;
+              case 31:
+                resword = "dd";
+                goto compare;
+              case 32:
+                resword = "li";
+                goto compare;
+              case 33:
+                resword = "sup";
+                goto compare;
+              case 34:
+                resword = "tbody";
+                goto compare;
+              case 36:
+                resword = "thead";
+                goto compare;
+              case 37:
+                resword = "bdi";
+                goto compare;
+              case 38:
+                resword = "img";
+                goto compare;
+              case 39:
+                resword = "ruby";
+                goto compare;
+              case 40:
+                resword = "kbd";
+                goto compare;
+              case 41:
+                resword = "th";
+                goto compare;
+              case 42:
+                resword = "rt";
+                goto compare;
+              case 43:
+                resword = "h5";
+                goto compare;
+              case 44:
+                resword = "cite";
+                goto compare;
+              case 46:
+                resword = "b";
+                goto compare;
+              case 47:
+                resword = "span";
+                goto compare;
+              case 49:
+                resword = "h6";
+                goto compare;
+              case 50:
+                resword = "del";
+                goto compare;
+              case 51:
+                resword = "table";
+                goto compare;
+              case 52:
+                resword = "q";
+                goto compare;
+              case 54:
+                resword = "small";
+                goto compare;
+              case 55:
+                resword = "ul";
+                goto compare;
+              case 56:
+                resword = "em";
+                goto compare;
+              case 59:
+                resword = "h4";
+                goto compare;
+              case 60:
+                resword = "p";
+                goto compare;
+              case 62:
+                resword = "mark";
+                goto compare;
+              case 64:
+                resword = "a";
+                goto compare;
+              case 65:
+                resword = "dl";
+                goto compare;
+              case 66:
+                resword = "samp";
+                goto compare;
+              case 67:
+                resword = "bdo";
+                goto compare;
+              case 70:
+                resword = "blockquote";
+                goto compare;
+              case 71:
+                resword = "tr";
+                goto compare;
+              case 72:
+                resword = "wbr";
+                goto compare;
+              case 74:
+                resword = "code";
+                goto compare;
+              case 75:
+                resword = "h3";
+                goto compare;
+              case 76:
+                resword = "pre";
+                goto compare;
+              case 77:
+                resword = "var";
+                goto compare;
+              case 79:
+                resword = "caption";
+                goto compare;
+              case 81:
+                resword = "h2";
+                goto compare;
+              case 85:
+                resword = "hr";
+                goto compare;
+              case 87:
+                resword = "ol";
+                goto compare;
+              case 89:
+                resword = "col";
+                goto compare;
+              case 90:
+                resword = "br";
+                goto compare;
+              case 91:
+                resword = "abbr";
+                goto compare;
+              case 94:
+                resword = "rp";
+                goto compare;
+              case 97:
+                resword = "colgroup";
+                goto compare;
+            }
+          return 0;
+        compare:
+          if ((((unsigned char)*str ^ (unsigned char)*resword) & ~32) == 0 && !gperf_case_strncmp (str, resword, len) && resword[len] == '\0')
+            return resword;
+        }
+    }
+  return 0;
+}
@@ -0,0 +1,250 @@
+#include "html.h"
+#include "autolink.h"
+#include "charclass.h"
+
+#include <string.h>
+
+#ifndef _MSC_VER
+#include <strings.h>
+#else
+#define strncasecmp	_strnicmp
+#endif
+
+/* generated from html_safe_tags.gperf and html_safe_attributes.gperf */
+const char *hoedown_find_safe_tag(const char *str, unsigned int len);
+const char *hoedown_find_safe_attribute(const char *str, unsigned int len);
+
+/* elements dropped together with their contents */
+static const char *sanitize_dropped_tags[] = {
+	"script", "style", "textarea", "title", "xmp", "iframe", "noembed",
+	"noframes", "noscript", "template", "object", "svg", "math"
+};
+
+
+/********************
+ * HELPER FUNCTIONS *
+ ********************/
+
+static int
+is_name_char(uint8_t c)
+{
+	return hoedown_isalnum(c) || c == '-' || c == '_' || c == ':' || c == '.';
+}
+
+/* markup_end: offset past a comment, a declaration or a processing
+ * instruction at data[0] == '<'; 0 when it is not closed */
+static size_t
+markup_end(const uint8_t *data, size_t size)
+{
+	size_t i;
+
+	if (size >= 4 && memcmp(data, "<!--", 4) == 0) {
+		for (i = 4; i + 2 < size; ++i)
+			if (data[i] == '-' && data[i + 1] == '-' && data[i + 2] == '>')
+				return i + 3;
+		return 0;
+	}
+
+	for (i = 2; i < size; ++i)
+		if (data[i] == '>')
+			return i + 1;
+
+	return 0;
+}
+
+/* is_dropped_tag: whether the contents of an element go with it */
+static int
+is_dropped_tag(const uint8_t *name, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(sanitize_dropped_tags) / sizeof(sanitize_dropped_tags[0]); ++i)
+		if (strlen(sanitize_dropped_tags[i]) == size &&
+			strncasecmp((const char *)name, sanitize_dropped_tags[i], size) == 0)
+			return 1;
+
+	return 0;
+}
+
+/* skip_element: offset past the closing tag of the element named name,
+ * or size when it is not closed */
+static size_t
+skip_element(const uint8_t *data, size_t size, const uint8_t *name, size_t name_size)
+{
+	size_t i, end;
+
+	for (i = 0; i + name_size + 2 <= size; ++i) {
+		if (data[i] != '<' || data[i + 1] != '/' ||
+			strncasecmp((const char *)data + i + 2, (const char *)name, name_size) != 0 ||
+			(i + name_size + 2 < size && is_name_char(data[i + name_size + 2])))
+			continue;
+
+		end = scidown_tag_end(data + i, size - i);
+		return end ? i + end : size;
+	}
+
+	return size;
+}
+
+static int
+is_url_attribute(const uint8_t *name, size_t size)
+{
+	return (size == 4 && strncasecmp((const char *)name, "href", 4) == 0) ||
+		(size == 3 && strncasecmp((const char *)name, "src", 3) == 0) ||
+		(size == 4 && strncasecmp((const char *)name, "cite", 4) == 0);
+}
+
+/* is_safe_url: a safe scheme, or a relative URL with neither a scheme
+ * nor a character reference before its path */
+static int
+is_safe_url(const uint8_t *url, size_t size)
+{
+	size_t i;
+
+	if (hoedown_autolink_is_safe(url, size))
+		return 1;
+
+	for (i = 0; i < size && url[i] != '/' && url[i] != '?' && url[i] != '#'; ++i)
+		if (!hoedown_isalnum(url[i]) && !strchr("-._~%", url[i]))
+			return 0;
+
+	return 1;
+}
+
+/* sanitize_tag: write the tag data[0 .. size) with only the allowed
+ * attributes, the tag name being data[name .. name + name_size) */
+static void
+sanitize_tag(hoedown_buffer *ob, const uint8_t *data, size_t size, size_t name, size_t name_size, int closing)
+{
+	size_t i = name + name_size, attr, attr_size, value, value_size;
+	int self_closing = 0;
+
+	HOEDOWN_BUFPUTSL(ob, "<");
+	if (closing)
+		hoedown_buffer_putc(ob, '/');
+	hoedown_buffer_put(ob, data + name, name_size);
+
+	while (!closing && i < size - 1) {
+		if (hoedown_isspace(data[i]) || data[i] == '/') {
+			self_closing = data[i] == '/';
+			i++;
+			continue;
+		}
+
+		self_closing = 0;
+		attr = i;
+		while (i < size - 1 && !hoedown_isspace(data[i]) && data[i] != '/' && data[i] != '=')
+			i++;
+		attr_size = i - attr;
+
+		while (i < size - 1 && hoedown_isspace(data[i]))
+			i++;
+
+		value = value_size = 0;
+		if (i < size - 1 && data[i] == '=') {
+			i++;
+			while (i < size - 1 && hoedown_isspace(data[i]))
+				i++;
+
+			value = i;
+			if (data[i] == '"' || data[i] == '\'') {
+				i++;
+				while (i < size - 1 && data[i] != data[value])
+					i++;
+
+				/* an unclosed value would take the '>' along */
+				if (i >= size - 1)
+					break;
+				i++;
+			} else {
+				while (i < size - 1 && !hoedown_isspace(data[i]))
+					i++;
+			}
+			value_size = i - value;
+		}
+
+		if (!attr_size || !hoedown_find_safe_attribute((const char *)data + attr, (unsigned int)attr_size))
+			continue;
+
+		if (value_size) {
+			/* the URL without its quotes */
+			int quoted = data[value] == '"' || data[value] == '\'';
+			const uint8_t *url = data + value + quoted;
+			size_t url_size = value_size - 2 * quoted;
+
+			if (is_url_attribute(data + attr, attr_size) && !is_safe_url(url, url_size))
+				continue;
+			if (!quoted && memchr(url, '"', url_size))
+				continue;
+
+			hoedown_buffer_putc(ob, ' ');
+			hoedown_buffer_put(ob, data + attr, attr_size);
+			hoedown_buffer_putc(ob, '=');
+			if (!quoted)
+				hoedown_buffer_putc(ob, '"');
+			hoedown_buffer_put(ob, data + value, value_size);
+			if (!quoted)
+				hoedown_buffer_putc(ob, '"');
+		} else {
+			hoedown_buffer_putc(ob, ' ');
+			hoedown_buffer_put(ob, data + attr, attr_size);
+		}
+	}
+
+	if (self_closing)
+		HOEDOWN_BUFPUTSL(ob, " /");
+	hoedown_buffer_putc(ob, '>');
+}
+
+
+/**********************
+ * EXPORTED FUNCTIONS *
+ **********************/
+
+void
+hoedown_html_sanitize(hoedown_buffer *ob, const uint8_t *data, size_t size)
+{
+	size_t i = 0, mark, end, name, name_size;
+	int closing;
+
+	while (i < size) {
+		mark = i;
+		while (i < size && data[i] != '<')
+			i++;
+
+		if (i > mark)
+			hoedown_buffer_put(ob, data + mark, i - mark);
+
+		if (i >= size)
+			break;
+
+		/* comments, declarations and processing instructions */
+		if (i + 1 < size && (data[i + 1] == '!' || data[i + 1] == '?')) {
+			end = markup_end(data + i, size - i);
+			if (end) {
+				i += end;
+				continue;
+			}
+		}
+
+		closing = i + 1 < size && data[i + 1] == '/';
+		name = closing + 1;
+		end = i + name < size && hoedown_isalpha(data[i + name]) ? scidown_tag_end(data + i, size - i) : 0;
+
+		/* not a tag, a literal '<' */
+		if (!end) {
+			HOEDOWN_BUFPUTSL(ob, "&lt;");
+			i++;
+			continue;
+		}
+
+		for (name_size = 0; name + name_size < end && is_name_char(data[i + name + name_size]); name_size++);
+
+		if (hoedown_find_safe_tag((const char *)data + i + name, (unsigned int)name_size))
+			sanitize_tag(ob, data + i, end, name, name_size, closing);
+		else if (!closing && data[i + end - 2] != '/' && is_dropped_tag(data + i + name, name_size))
+			end += skip_element(data + i + end, size - i - end, data + i + name, name_size);
+
+		i += end;
+	}
+}
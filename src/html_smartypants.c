@@ -3,7 +3,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
+
+#include "charclass.h"
 
 #ifdef _MSC_VER
 #define snprintf _snprintf
@@ -63,7 +64,7 @@ static const uint8_t smartypants_cb_chars[UINT8_MAX+1] = {
 static int
 word_boundary(uint8_t c)
 {
-	return c == 0 || isspace(c) || ispunct(c);
+	return c == 0 || hoedown_isspace(c) || hoedown_ispunct(c);
 }
 
 /*
@@ -116,7 +117,7 @@ smartypants_squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t pr
 				   const uint8_t *squote_text, size_t squote_size)
 {
 	if (size >= 2) {
-		uint8_t t1 = tolower(text[1]);
+		uint8_t t1 = hoedown_tolower(text[1]);
 		size_t next_squote_len = squote_len(text+1, size-1);
 
 		/* convert '' to &ldquo; or &rdquo; */
@@ -135,7 +136,7 @@ smartypants_squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t pr
 
 		/* you're, you'll, you've */
 		if (size >= 3) {
-			uint8_t t2 = tolower(text[2]);
+			uint8_t t2 = hoedown_tolower(text[2]);
 
 			if (((t1 == 'r' && t2 == 'e') ||
 				(t1 == 'l' && t2 == 'l') ||
@@ -166,8 +167,8 @@ static size_t
 smartypants_cb__parens(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	if (size >= 3) {
-		uint8_t t1 = tolower(text[1]);
-		uint8_t t2 = tolower(text[2]);
+		uint8_t t1 = hoedown_tolower(text[1]);
+		uint8_t t2 = hoedown_tolower(text[2]);
 
 		if (t1 == 'c' && t2 == ')') {
 			HOEDOWN_BUFPUTSL(ob, "&copy;");
@@ -274,7 +275,7 @@ smartypants_cb__number(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_
 
 		if (text[0] == '1' && text[1] == '/' && text[2] == '4') {
 			if (size == 3 || word_boundary(text[3]) ||
-				(size >= 5 && tolower(text[3]) == 't' && tolower(text[4]) == 'h')) {
+				(size >= 5 && hoedown_tolower(text[3]) == 't' && hoedown_tolower(text[4]) == 'h')) {
 				HOEDOWN_BUFPUTSL(ob, "&frac14;");
 				return 2;
 			}
@@ -282,7 +283,7 @@ smartypants_cb__number(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_
 
 		if (text[0] == '3' && text[1] == '/' && text[2] == '4') {
 			if (size == 3 || word_boundary(text[3]) ||
-				(size >= 6 && tolower(text[3]) == 't' && tolower(text[4]) == 'h' && tolower(text[5]) == 's')) {
+				(size >= 6 && hoedown_tolower(text[3]) == 't' && hoedown_tolower(text[4]) == 'h' && hoedown_tolower(text[5]) == 's')) {
 				HOEDOWN_BUFPUTSL(ob, "&frac34;");
 				return 2;
 			}
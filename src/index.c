@@ -0,0 +1,272 @@
+#include "index.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "charclass.h"
+#include "utils.h"
+
+#define INDEX_INITIAL_BUCKETS 256
+
+/* index_term: a distinct term and its encoded postings */
+struct index_term {
+	struct index_term *next;	/* hash chain */
+	uint32_t hash;
+
+	size_t count;
+	size_t last_position;
+	size_t last_block;
+	hoedown_buffer postings;
+
+	size_t size;
+	uint8_t data[HOEDOWN_INDEX_MAX_TERM];
+};
+
+struct hoedown_index {
+	struct index_term **buckets;
+	size_t bucket_count;
+	size_t term_count;
+
+	hoedown_buffer blocks;
+	size_t block_count;
+	size_t heading;		/* 1 + block number of the last header, 0 if none */
+	size_t position;
+
+	/* term being accumulated, it may continue in the next chunk of text */
+	uint8_t pending[HOEDOWN_INDEX_MAX_TERM];
+	size_t pending_size;
+	int pending_overflow;
+};
+
+
+/********************
+ * HELPER FUNCTIONS *
+ ********************/
+
+static void
+put_varint(hoedown_buffer *ob, size_t value)
+{
+	uint8_t bytes[10];
+	size_t n = 0;
+
+	do {
+		bytes[n] = value & 0x7F;
+		value >>= 7;
+		if (value) bytes[n] |= 0x80;
+		n++;
+	} while (value);
+
+	hoedown_buffer_put(ob, bytes, n);
+}
+
+static void
+grow_buckets(hoedown_index *index)
+{
+	size_t new_count = index->bucket_count * 2, i;
+	struct index_term **buckets = hoedown_calloc(new_count, sizeof(struct index_term *));
+	struct index_term *term, *next;
+
+	for (i = 0; i < index->bucket_count; ++i) {
+		for (term = index->buckets[i]; term; term = next) {
+			next = term->next;
+			term->next = buckets[term->hash & (new_count - 1)];
+			buckets[term->hash & (new_count - 1)] = term;
+		}
+	}
+
+	free(index->buckets);
+	index->buckets = buckets;
+	index->bucket_count = new_count;
+}
+
+/* add_term: records an occurrence of the pending term */
+static void
+add_term(hoedown_index *index)
+{
+	const uint8_t *data = index->pending;
+	size_t size = index->pending_size;
+	uint32_t hash = scidown_hash(data, size);
+	struct index_term *term;
+	size_t block;
+
+	if (!index->block_count)
+		hoedown_index_begin_block(index, HOEDOWN_INDEX_PARAGRAPH);
+
+	block = index->block_count - 1;
+
+	for (term = index->buckets[hash & (index->bucket_count - 1)]; term; term = term->next)
+		if (term->hash == hash && term->size == size && memcmp(term->data, data, size) == 0)
+			break;
+
+	if (!term) {
+		if (index->term_count >= index->bucket_count * 2)
+			grow_buckets(index);
+
+		term = hoedown_calloc(1, sizeof(struct index_term));
+		hoedown_buffer_init(&term->postings, 16, hoedown_realloc, free, NULL);
+		term->hash = hash;
+		term->size = size;
+		memcpy(term->data, data, size);
+
+		term->next = index->buckets[hash & (index->bucket_count - 1)];
+		index->buckets[hash & (index->bucket_count - 1)] = term;
+		index->term_count++;
+	}
+
+	put_varint(&term->postings, index->position - term->last_position);
+	put_varint(&term->postings, block - term->last_block);
+	term->last_position = index->position;
+	term->last_block = block;
+	term->count++;
+
+	index->position++;
+}
+
+/* flush_term: ends the pending term, if any */
+static void
+flush_term(hoedown_index *index)
+{
+	if (index->pending_size && !index->pending_overflow)
+		add_term(index);
+
+	index->pending_size = 0;
+	index->pending_overflow = 0;
+}
+
+static int
+cmp_terms(const void *a, const void *b)
+{
+	const struct index_term *ta = *(const struct index_term **)a;
+	const struct index_term *tb = *(const struct index_term **)b;
+	int cmp = memcmp(ta->data, tb->data, ta->size < tb->size ? ta->size : tb->size);
+
+	if (cmp)
+		return cmp;
+
+	return (ta->size > tb->size) - (ta->size < tb->size);
+}
+
+static void
+free_terms(hoedown_index *index)
+{
+	struct index_term *term, *next;
+	size_t i;
+
+	for (i = 0; i < index->bucket_count; ++i) {
+		for (term = index->buckets[i]; term; term = next) {
+			next = term->next;
+			hoedown_buffer_uninit(&term->postings);
+			free(term);
+		}
+		index->buckets[i] = NULL;
+	}
+
+	index->term_count = 0;
+}
+
+
+/**********************
+ * EXPORTED FUNCTIONS *
+ **********************/
+
+hoedown_index *
+hoedown_index_new(void)
+{
+	hoedown_index *index = hoedown_calloc(1, sizeof(hoedown_index));
+
+	index->bucket_count = INDEX_INITIAL_BUCKETS;
+	index->buckets = hoedown_calloc(index->bucket_count, sizeof(struct index_term *));
+	hoedown_buffer_init(&index->blocks, 64, hoedown_realloc, free, NULL);
+
+	return index;
+}
+
+void
+hoedown_index_begin_block(hoedown_index *index, hoedown_index_block_type type)
+{
+	flush_term(index);
+
+	if (type == HOEDOWN_INDEX_HEADER)
+		index->heading = index->block_count + 1;
+
+	hoedown_buffer_putc(&index->blocks, (uint8_t)type);
+	put_varint(&index->blocks, index->heading);
+	index->block_count++;
+}
+
+void
+hoedown_index_text(hoedown_index *index, const uint8_t *data, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; ++i) {
+		uint8_t c = data[i];
+
+		if (c < 0x80 && !hoedown_isalnum(c)) {
+			flush_term(index);
+			continue;
+		}
+
+		if (index->pending_size < HOEDOWN_INDEX_MAX_TERM)
+			index->pending[index->pending_size++] = hoedown_tolower(c);
+		else
+			index->pending_overflow = 1;
+	}
+}
+
+void
+hoedown_index_break(hoedown_index *index)
+{
+	flush_term(index);
+}
+
+void
+hoedown_index_write(hoedown_index *index, hoedown_buffer *ob)
+{
+	struct index_term **terms, *term;
+	size_t i, n = 0;
+
+	flush_term(index);
+
+	put_varint(ob, index->block_count);
+	if (index->blocks.size)
+		hoedown_buffer_put(ob, index->blocks.data, index->blocks.size);
+
+	terms = hoedown_malloc((index->term_count + 1) * sizeof(struct index_term *));
+	for (i = 0; i < index->bucket_count; ++i)
+		for (term = index->buckets[i]; term; term = term->next)
+			terms[n++] = term;
+
+	qsort(terms, n, sizeof(struct index_term *), cmp_terms);
+
+	put_varint(ob, n);
+	for (i = 0; i < n; ++i) {
+		put_varint(ob, terms[i]->size);
+		hoedown_buffer_put(ob, terms[i]->data, terms[i]->size);
+		put_varint(ob, terms[i]->count);
+		hoedown_buffer_put(ob, terms[i]->postings.data, terms[i]->postings.size);
+	}
+
+	free(terms);
+}
+
+void
+hoedown_index_reset(hoedown_index *index)
+{
+	free_terms(index);
+	index->blocks.size = 0;
+	index->block_count = 0;
+	index->heading = 0;
+	index->position = 0;
+	index->pending_size = 0;
+	index->pending_overflow = 0;
+}
+
+void
+hoedown_index_free(hoedown_index *index)
+{
+	free_terms(index);
+	free(index->buckets);
+	hoedown_buffer_uninit(&index->blocks);
+	free(index);
+}
@@ -0,0 +1,81 @@
+/* index.h - inverted term index built while rendering */
+
+#ifndef HOEDOWN_INDEX_H
+#define HOEDOWN_INDEX_H
+
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*************
+ * CONSTANTS *
+ *************/
+
+typedef enum hoedown_index_block_type {
+	HOEDOWN_INDEX_PARAGRAPH,
+	HOEDOWN_INDEX_HEADER,
+	HOEDOWN_INDEX_LIST,
+	HOEDOWN_INDEX_TABLE,
+	HOEDOWN_INDEX_CAPTION
+} hoedown_index_block_type;
+
+#define HOEDOWN_INDEX_MAX_TERM 64
+
+
+/*********
+ * TYPES *
+ *********/
+
+struct hoedown_index;
+typedef struct hoedown_index hoedown_index;
+
+
+/*************
+ * FUNCTIONS *
+ *************/
+
+/* hoedown_index_new: allocate an empty index */
+hoedown_index *hoedown_index_new(void) __attribute__ ((malloc));
+
+/* hoedown_index_begin_block: start a new block, a header block becomes the heading of the following ones */
+void hoedown_index_begin_block(hoedown_index *index, hoedown_index_block_type type);
+
+/* hoedown_index_text: feed visible text of the current block, words may span several calls */
+void hoedown_index_text(hoedown_index *index, const uint8_t *data, size_t size);
+
+/* hoedown_index_break: end the pending word, for text that is not indexed (e.g. code spans) */
+void hoedown_index_break(hoedown_index *index);
+
+/*
+ * hoedown_index_write: serialize the postings, every number being an
+ * unsigned LEB128 varint:
+ *
+ *	block count, then for each block:
+ *		type (hoedown_index_block_type),
+ *		heading (1 + number of the governing header block, 0 if none)
+ *	term count, then for each term, in bytewise order:
+ *		size, bytes, posting count, then for each posting:
+ *			position delta, block delta
+ *
+ * Positions count terms from the start of the document; deltas are
+ * relative to the previous posting of the same term (the first one is absolute).
+ * Terms are runs of ASCII alphanumerics and non-ASCII bytes, lowercased
+ * (ASCII only), longer ones than HOEDOWN_INDEX_MAX_TERM are dropped.
+ */
+void hoedown_index_write(hoedown_index *index, hoedown_buffer *ob);
+
+/* hoedown_index_reset: forget every block and term */
+void hoedown_index_reset(hoedown_index *index);
+
+/* hoedown_index_free: deallocate an index */
+void hoedown_index_free(hoedown_index *index);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** HOEDOWN_INDEX_H **/
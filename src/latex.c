@@ -3,12 +3,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 
 #include "charter/src/parser.h"
 #include "charter/src/renderer.h"
 
 #include "escape.h"
+#include "charclass.h"
 
 #define MAX_FILE_SIZE 1000000
 
@@ -39,7 +39,7 @@ scidown_latex_is_tag(const uint8_t *data, size_t size, const char *tagname)
 	if (i == size)
 		return SCIDOWN_RENDER_TAG_NONE;
 
-	if (isspace(data[i]) || data[i] == '>')
+	if (hoedown_isspace(data[i]) || data[i] == '>')
 		return closed ? SCIDOWN_RENDER_TAG_CLOSE : SCIDOWN_RENDER_TAG_OPEN;
 
 	return SCIDOWN_RENDER_TAG_NONE;
@@ -101,14 +101,14 @@ rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buf
 		if (text) {
 
 			char * copy = malloc((text->size + 1)*sizeof(char));
-			memset(copy, 0, text->size+1);
 			memcpy(copy, text->data, text->size);
+			copy[text->size] = 0;
 
 			chart * c =  parse_chart(copy);
 			char * tex = chart_to_latex(c);
 
-			int n = strlen(tex);
-			hoedown_buffer_printf(ob, tex, n);
+			/* the chart is not a format string, its % are output as is */
+			hoedown_buffer_puts(ob, tex);
 
 			free(copy);
 			chart_free(c);
@@ -326,7 +326,7 @@ rndr_paragraph(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_
 	if (!content || !content->size)
 		return;
 
-	while (i < content->size && isspace(content->data[i])) i++;
+	while (i < content->size && hoedown_isspace(content->data[i])) i++;
 
 	if (i == content->size)
 		return;
@@ -657,9 +657,21 @@ rndr_keywords(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_r
 }
 
 static void
-rndr_begin(hoedown_buffer *ob, const hoedown_renderer_data *data)
+clear_chapters(scidown_latex_renderer_state *state)
 {
+	size_t i;
+
+	for (i = 0; i < state->chapters_count; ++i) {
+		free(state->chapters[i].name);
+		hoedown_buffer_free(state->chapters[i].content);
+	}
+	state->chapters_count = 0;
+}
 
+static void
+rndr_begin(hoedown_buffer *ob, const hoedown_renderer_data *data)
+{
+	clear_chapters(data->opaque);
 }
 
 static void
@@ -702,7 +714,57 @@ rndr_close(hoedown_buffer *ob){
 	hoedown_buffer_puts(ob, "\\end{abstract}");
 }
 
-static int rndr_ref (hoedown_buffer *ob, char * id, int count)
+/* chapter_name: file name of an included file, without directories nor extension */
+static char *
+chapter_name(const scidown_latex_renderer_state *state, const char *path)
+{
+	const char *base = strrchr(path, '/'), *ext;
+	size_t n, i, suffix = 1;
+	char *name;
+
+	base = base ? base + 1 : path;
+	ext = strrchr(base, '.');
+	n = (ext && ext != base) ? (size_t)(ext - base) : strlen(base);
+	name = hoedown_malloc(n + 24);
+
+	for (i = 0; i < n; ++i)
+		name[i] = hoedown_isalnum(base[i]) || base[i] == '_' ? base[i] : '-';
+	name[n] = 0;
+
+	/* the same file included twice gets different numbers, keep both */
+	for (i = 0; i < state->chapters_count; ++i) {
+		if (strcmp(state->chapters[i].name, name) == 0) {
+			snprintf(name + n, 24, "-%zu", ++suffix);
+			i = (size_t)-1;
+		}
+	}
+
+	return name;
+}
+
+static int
+rndr_include(hoedown_buffer *ob, const char *path, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	scidown_latex_renderer_state *state = data->opaque;
+	scidown_latex_chapter *chapter;
+
+	if (state->chapters_count >= state->chapters_asize) {
+		state->chapters_asize = state->chapters_asize ? state->chapters_asize * 2 : 8;
+		state->chapters = hoedown_realloc(state->chapters, state->chapters_asize * sizeof(scidown_latex_chapter));
+	}
+
+	chapter = &state->chapters[state->chapters_count];
+	chapter->name = chapter_name(state, path);
+	chapter->content = hoedown_buffer_new(content->size ? content->size : 64);
+	hoedown_buffer_put(chapter->content, content->data, content->size);
+	state->chapters_count++;
+
+	if (ob->size) hoedown_buffer_putc(ob, '\n');
+	hoedown_buffer_printf(ob, "\\include{%s}\n", chapter->name);
+	return 1;
+}
+
+static int rndr_ref (hoedown_buffer *ob, char * id, int count, const hoedown_renderer_data *data)
 {
 	hoedown_buffer_printf(ob, "(\\ref{%s})", id);
 	return 1;
@@ -780,7 +842,7 @@ static void rnrd_close_float(hoedown_buffer *ob, float_args args, const hoedown_
 
 
 static void
-rndr_toc(hoedown_buffer *ob, toc * tree, int numbering)
+rndr_toc(hoedown_buffer *ob, toc * tree, int numbering, const hoedown_renderer_data *data)
 {
 	hoedown_buffer_puts(ob, "\\tableofcontents");
 }
@@ -849,6 +911,9 @@ scidown_latex_renderer_new(scidown_render_flags render_flags, int nesting_level,
 		NULL,
 		NULL,
 		NULL,
+
+		NULL,
+		rndr_include,
 	};
 
 	scidown_latex_renderer_state *state;
@@ -872,13 +937,107 @@ scidown_latex_renderer_new(scidown_render_flags render_flags, int nesting_level,
 	renderer = hoedown_malloc(sizeof(hoedown_renderer));
 	memcpy(renderer, &cb_default, sizeof(hoedown_renderer));
 
+	/* without a split, includes render in place like any other block */
+	if (!(render_flags & SCIDOWN_RENDER_SPLIT))
+		renderer->include = NULL;
+
 	renderer->opaque = state;
 	return renderer;
 }
 
+/* write_if_changed: write <folder>/<name><suffix>.tex unless it already holds the given content */
+static int
+write_if_changed(const char *folder, const char *name, const char *suffix, const uint8_t *data, size_t size)
+{
+	hoedown_buffer *path = hoedown_buffer_new(64);
+	hoedown_buffer *old = hoedown_buffer_new(1024);
+	int written = 0;
+	FILE *file;
+
+	hoedown_buffer_printf(path, "%s/%s%s.tex", folder, name, suffix);
+
+	file = fopen(hoedown_buffer_cstr(path), "rb");
+	if (file) {
+		hoedown_buffer_putf(old, file);
+		fclose(file);
+	}
+
+	if (!file || old->size != size || memcmp(old->data, data, size) != 0) {
+		file = fopen(hoedown_buffer_cstr(path), "wb");
+		if (file && fwrite(data, 1, size, file) == size)
+			written = 1;
+		else
+			written = -1;
+		if (file)
+			fclose(file);
+	}
+
+	hoedown_buffer_free(path);
+	hoedown_buffer_free(old);
+	return written;
+}
+
+int
+scidown_latex_write_split(hoedown_renderer *renderer, const hoedown_buffer *ob, const char *folder, const char *name)
+{
+	static const char begin[] = "\\begin{document}\n";
+	scidown_latex_renderer_state *state = renderer->opaque;
+	hoedown_buffer *root = hoedown_buffer_new(64);
+	size_t i, preamble = 0;
+	int written, total = 0;
+
+	for (i = 0; i + sizeof(begin) - 1 <= ob->size; ++i) {
+		if (memcmp(ob->data + i, begin, sizeof(begin) - 1) == 0) {
+			preamble = i;
+			break;
+		}
+	}
+
+	if (preamble) {
+		written = write_if_changed(folder, name, "-preamble", ob->data, preamble);
+		if (written < 0) goto error;
+		total += written;
+		hoedown_buffer_printf(root, "\\input{%s-preamble}\n", name);
+	}
+
+	hoedown_buffer_put(root, ob->data + preamble, ob->size - preamble);
+	written = write_if_changed(folder, name, "", root->data, root->size);
+	if (written < 0) goto error;
+	total += written;
+
+	for (i = 0; i < state->chapters_count; ++i) {
+		written = write_if_changed(folder, state->chapters[i].name, "",
+			state->chapters[i].content->data, state->chapters[i].content->size);
+		if (written < 0) goto error;
+		total += written;
+	}
+
+	hoedown_buffer_free(root);
+	return total;
+
+error:
+	hoedown_buffer_free(root);
+	return -1;
+}
+
+void
+scidown_latex_renderer_reset(hoedown_renderer *renderer)
+{
+	scidown_latex_renderer_state *state = renderer->opaque;
+
+	memset(&state->counter, 0, sizeof(state->counter));
+	state->toc_data.header_count = 0;
+	state->toc_data.current_level = 0;
+	state->toc_data.level_offset = 0;
+}
+
 void
 scidown_latex_renderer_free(hoedown_renderer *renderer)
 {
+	scidown_latex_renderer_state *state = renderer->opaque;
+
+	clear_chapters(state);
+	free(state->chapters);
 	free(renderer->opaque);
 	free(renderer);
 }
@@ -11,6 +11,13 @@
 extern "C" {
 #endif
 
+/* scidown_latex_chapter: an @include target rendered to its own file */
+struct scidown_latex_chapter {
+	char *name;
+	hoedown_buffer *content;
+};
+typedef struct scidown_latex_chapter scidown_latex_chapter;
+
 struct scidown_latex_renderer_state {
 	void *opaque;
 
@@ -25,6 +32,11 @@ struct scidown_latex_renderer_state {
 	html_counter counter;
 	localization localization;
 
+	/* chapters of the last render, with SCIDOWN_RENDER_SPLIT */
+	scidown_latex_chapter *chapters;
+	size_t chapters_count;
+	size_t chapters_asize;
+
 	/* extra callbacks */
 	void (*link_attributes)(hoedown_buffer *ob, const hoedown_buffer *url, const hoedown_renderer_data *data);
 };
@@ -49,6 +61,16 @@ hoedown_renderer *scidown_latex_renderer_new(
 	localization local
 ) __attribute__ ((malloc));
 
+/* scidown_latex_write_split: with SCIDOWN_RENDER_SPLIT, write the output of
+ * the last render as <folder>/<name>-preamble.tex, <folder>/<name>.tex which
+ * inputs the preamble, and one file per top-level @include, referenced with
+ * \include. Files whose content did not change are not rewritten; returns
+ * the number of files written, or -1 on I/O errors */
+int scidown_latex_write_split(hoedown_renderer *renderer, const hoedown_buffer *ob, const char *folder, const char *name);
+
+/* scidown_latex_renderer_reset: forget the float and header numbers of a previous render */
+void scidown_latex_renderer_reset(hoedown_renderer *renderer);
+
 /* hoedown_html_renderer_free: deallocate an HTML renderer */
 void scidown_latex_renderer_free(hoedown_renderer *renderer);
 
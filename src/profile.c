@@ -0,0 +1,211 @@
+#include "profile.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PROFILE_INITIAL_SIZE 64
+
+static const char *profile_type_names[] = {
+	"other",
+	"paragraph",
+	"header",
+	"list",
+	"quote",
+	"code",
+	"table",
+	"html",
+	"rule",
+	"float",
+	"equation",
+	"include"
+};
+
+
+/********************
+ * HELPER FUNCTIONS *
+ ********************/
+
+static double
+entry_cost(const hoedown_profile_entry *entry)
+{
+	return entry->parse_time + entry->render_time;
+}
+
+/* cmp_cost: costliest first, then in source order */
+static int
+cmp_cost(const void *a, const void *b)
+{
+	const hoedown_profile_entry *ea = *(const hoedown_profile_entry **)a;
+	const hoedown_profile_entry *eb = *(const hoedown_profile_entry **)b;
+	double ca = entry_cost(ea), cb = entry_cost(eb);
+
+	if (ca != cb)
+		return ca < cb ? 1 : -1;
+
+	return (ea->source_begin > eb->source_begin) - (ea->source_begin < eb->source_begin);
+}
+
+/* sorted_entries: the entries costliest first, to free by the caller */
+static const hoedown_profile_entry **
+sorted_entries(const hoedown_profile *profile)
+{
+	const hoedown_profile_entry **sorted = hoedown_malloc((profile->count + 1) * sizeof(hoedown_profile_entry *));
+	size_t i;
+
+	for (i = 0; i < profile->count; ++i)
+		sorted[i] = &profile->entries[i];
+
+	qsort(sorted, profile->count, sizeof(hoedown_profile_entry *), cmp_cost);
+	return sorted;
+}
+
+
+/**********************
+ * EXPORTED FUNCTIONS *
+ **********************/
+
+hoedown_profile *
+hoedown_profile_new(void)
+{
+	return hoedown_calloc(1, sizeof(hoedown_profile));
+}
+
+double
+hoedown_profile_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+hoedown_profile_entry *
+hoedown_profile_add(hoedown_profile *profile)
+{
+	hoedown_profile_entry *entry;
+
+	if (profile->count >= profile->asize) {
+		profile->asize = profile->asize ? profile->asize * 2 : PROFILE_INITIAL_SIZE;
+		profile->entries = hoedown_realloc(profile->entries, profile->asize * sizeof(hoedown_profile_entry));
+	}
+
+	entry = &profile->entries[profile->count++];
+	memset(entry, 0, sizeof(hoedown_profile_entry));
+
+	return entry;
+}
+
+void
+hoedown_profile_finish(hoedown_profile *profile, const uint8_t *source, size_t size)
+{
+	hoedown_profile_entry *entry;
+	size_t i, offset = 0, line = 1, last;
+
+	for (i = 0; i < profile->count; ++i) {
+		entry = &profile->entries[i];
+		entry->source_end = i + 1 < profile->count ? profile->entries[i + 1].source_begin : size;
+		if (entry->source_begin > size)
+			entry->source_begin = size;
+		if (entry->source_end < entry->source_begin)
+			entry->source_end = entry->source_begin;
+
+		/* offsets only grow, so the lines are counted in a single pass */
+		for (; offset < entry->source_begin; ++offset)
+			if (source[offset] == '\n') line++;
+		entry->line_begin = line;
+
+		/* the block ends on its last non-blank byte */
+		last = entry->source_end;
+		while (last > entry->source_begin && (source[last - 1] == '\n' || source[last - 1] == '\r' ||
+			source[last - 1] == ' ' || source[last - 1] == '\t'))
+			last--;
+
+		for (; offset + 1 < last; ++offset)
+			if (source[offset] == '\n') line++;
+		entry->line_end = line;
+	}
+}
+
+const char *
+hoedown_profile_type_name(hoedown_profile_block_type type)
+{
+	if ((size_t)type >= sizeof(profile_type_names) / sizeof(profile_type_names[0]))
+		return profile_type_names[HOEDOWN_PROFILE_OTHER];
+
+	return profile_type_names[type];
+}
+
+void
+hoedown_profile_write_json(const hoedown_profile *profile, hoedown_buffer *ob)
+{
+	const hoedown_profile_entry **sorted = sorted_entries(profile);
+	const hoedown_profile_entry *entry;
+	size_t i;
+
+	hoedown_buffer_printf(ob, "{\"prepare\": %.6f, \"total\": %.6f, \"blocks\": [",
+		profile->prepare_time, profile->total_time);
+
+	for (i = 0; i < profile->count; ++i) {
+		entry = sorted[i];
+		hoedown_buffer_printf(ob,
+			"%s\n\t{\"type\": \"%s\", \"lines\": [%zu, %zu], \"parse\": %.6f, \"render\": %.6f, \"output\": %zu}",
+			i ? "," : "", hoedown_profile_type_name(entry->type), entry->line_begin, entry->line_end,
+			entry->parse_time, entry->render_time, entry->output_size);
+	}
+
+	HOEDOWN_BUFPUTSL(ob, "\n]}\n");
+	free(sorted);
+}
+
+void
+hoedown_profile_write_html(const hoedown_profile *profile, hoedown_buffer *ob, size_t limit)
+{
+	const hoedown_profile_entry **sorted = sorted_entries(profile);
+	const hoedown_profile_entry *entry;
+	double max;
+	size_t i;
+
+	if (!limit || limit > profile->count)
+		limit = profile->count;
+	max = profile->count ? entry_cost(sorted[0]) : 0;
+
+	HOEDOWN_BUFPUTSL(ob, "<div class=\"scidown-profile\">\n<style>\n"
+		".scidown-profile{position:fixed;top:0;right:0;max-height:50%;overflow:auto;z-index:1000;"
+		"background:rgba(255,255,255,.95);border:1px solid #ccc;font:12px monospace;padding:4px}\n"
+		".scidown-profile td{padding:0 6px;text-align:right}\n"
+		".scidown-profile-bar{display:inline-block;height:8px;background:#d33}\n"
+		"</style>\n");
+	hoedown_buffer_printf(ob, "<table>\n<caption>Total %.2f ms, prepare %.2f ms</caption>\n"
+		"<tr><th>Lines</th><th>Block</th><th>Parse</th><th>Render</th><th>Output</th><th></th></tr>\n",
+		profile->total_time * 1e3, profile->prepare_time * 1e3);
+
+	for (i = 0; i < limit; ++i) {
+		entry = sorted[i];
+		hoedown_buffer_printf(ob,
+			"<tr data-line-begin=\"%zu\" data-line-end=\"%zu\"><td>%zu-%zu</td><td>%s</td>"
+			"<td>%.2f ms</td><td>%.2f ms</td><td>%zu B</td>"
+			"<td><span class=\"scidown-profile-bar\" style=\"width:%dpx\"></span></td></tr>\n",
+			entry->line_begin, entry->line_end, entry->line_begin, entry->line_end,
+			hoedown_profile_type_name(entry->type), entry->parse_time * 1e3, entry->render_time * 1e3,
+			entry->output_size, max > 0 ? (int)(100 * entry_cost(entry) / max) : 0);
+	}
+
+	HOEDOWN_BUFPUTSL(ob, "</table>\n</div>\n");
+	free(sorted);
+}
+
+void
+hoedown_profile_reset(hoedown_profile *profile)
+{
+	profile->count = 0;
+	profile->prepare_time = 0;
+	profile->total_time = 0;
+}
+
+void
+hoedown_profile_free(hoedown_profile *profile)
+{
+	free(profile->entries);
+	free(profile);
+}
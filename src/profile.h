@@ -0,0 +1,109 @@
+/* profile.h - cost of the top-level blocks of a render */
+
+#ifndef HOEDOWN_PROFILE_H
+#define HOEDOWN_PROFILE_H
+
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*************
+ * CONSTANTS *
+ *************/
+
+typedef enum hoedown_profile_block_type {
+	HOEDOWN_PROFILE_OTHER,
+	HOEDOWN_PROFILE_PARAGRAPH,
+	HOEDOWN_PROFILE_HEADER,
+	HOEDOWN_PROFILE_LIST,
+	HOEDOWN_PROFILE_QUOTE,
+	HOEDOWN_PROFILE_CODE,
+	HOEDOWN_PROFILE_TABLE,
+	HOEDOWN_PROFILE_HTML,
+	HOEDOWN_PROFILE_RULE,
+	HOEDOWN_PROFILE_FLOAT,
+	HOEDOWN_PROFILE_EQUATION,
+	HOEDOWN_PROFILE_INCLUDE
+} hoedown_profile_block_type;
+
+
+/*********
+ * TYPES *
+ *********/
+
+/* hoedown_profile_entry: a top-level block of the source */
+struct hoedown_profile_entry {
+	hoedown_profile_block_type type;
+
+	size_t source_begin;	/* byte offsets in the source, end excluded */
+	size_t source_end;
+	size_t line_begin;	/* first and last line, from 1 */
+	size_t line_end;
+
+	double parse_time;	/* seconds spent parsing, inline callbacks included */
+	double render_time;	/* seconds spent in the block callbacks of the renderer */
+	size_t output_size;	/* bytes of output */
+};
+typedef struct hoedown_profile_entry hoedown_profile_entry;
+
+/* hoedown_profile: filled by the renders of a document, in source order */
+struct hoedown_profile {
+	hoedown_profile_entry *entries;
+	size_t count;
+	size_t asize;
+
+	double prepare_time;	/* pre-scan of the whole source: references, table of contents, metadata */
+	double total_time;
+};
+typedef struct hoedown_profile hoedown_profile;
+
+
+/*************
+ * FUNCTIONS *
+ *************/
+
+/* hoedown_profile_new: allocate an empty profile */
+hoedown_profile *hoedown_profile_new(void) __attribute__ ((malloc));
+
+/* hoedown_profile_now: monotonic time in seconds */
+double hoedown_profile_now(void);
+
+/* hoedown_profile_add: append a zeroed entry */
+hoedown_profile_entry *hoedown_profile_add(hoedown_profile *profile);
+
+/* hoedown_profile_finish: end each entry where the next one begins and
+ * number the lines of every entry, source is the rendered document */
+void hoedown_profile_finish(hoedown_profile *profile, const uint8_t *source, size_t size);
+
+/* hoedown_profile_type_name: lowercase name of a block type */
+const char *hoedown_profile_type_name(hoedown_profile_block_type type);
+
+/* hoedown_profile_write_json: write the prepare and total times and the
+ * entries, costliest first, as a JSON object:
+ *
+ *	{"prepare": s, "total": s, "blocks": [
+ *		{"type": name, "lines": [first, last], "parse": s, "render": s, "output": bytes},
+ *		...]}
+ */
+void hoedown_profile_write_json(const hoedown_profile *profile, hoedown_buffer *ob);
+
+/* hoedown_profile_write_html: write an overlay for the HTML preview listing
+ * the limit costliest entries (all of them when 0); every row carries its
+ * line range in data-line-begin and data-line-end attributes */
+void hoedown_profile_write_html(const hoedown_profile *profile, hoedown_buffer *ob, size_t limit);
+
+/* hoedown_profile_reset: forget every entry */
+void hoedown_profile_reset(hoedown_profile *profile);
+
+/* hoedown_profile_free: deallocate a profile */
+void hoedown_profile_free(hoedown_profile *profile);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** HOEDOWN_PROFILE_H **/
@@ -0,0 +1,298 @@
+/* scidown.hpp - header-only C++17 wrapper of the document and renderer API */
+
+#ifndef SCIDOWN_HPP
+#define SCIDOWN_HPP
+
+#include "document.h"
+#include "buffer.h"
+#include "html.h"
+#include "latex.h"
+#include "text.h"
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace scidown {
+
+
+/**********
+ * BUFFER *
+ **********/
+
+/* Buffer: owns a hoedown_buffer; it can only be moved, so output handed out
+ * by a render is never copied */
+class Buffer {
+public:
+	explicit Buffer(size_t unit = 64) : buf_(hoedown_buffer_new(unit)) {}
+
+	/* takes ownership of a buffer allocated with hoedown_buffer_new */
+	static Buffer adopt(hoedown_buffer *buf) noexcept { return Buffer(buf, 0); }
+
+	Buffer(Buffer &&other) noexcept : buf_(std::exchange(other.buf_, nullptr)) {}
+	Buffer &operator=(Buffer &&other) noexcept
+	{
+		std::swap(buf_, other.buf_);
+		return *this;
+	}
+	Buffer(const Buffer &) = delete;
+	Buffer &operator=(const Buffer &) = delete;
+	~Buffer() { hoedown_buffer_free(buf_); }
+
+	hoedown_buffer *get() const noexcept { return buf_; }
+	const uint8_t *data() const noexcept { return buf_ ? buf_->data : nullptr; }
+	size_t size() const noexcept { return buf_ ? buf_->size : 0; }
+	bool empty() const noexcept { return size() == 0; }
+
+	std::string_view view() const noexcept
+	{
+		return std::string_view(reinterpret_cast<const char *>(data()), size());
+	}
+
+	/* NUL-terminated contents, valid until the buffer is modified */
+	const char *c_str() { return hoedown_buffer_cstr(buf_); }
+
+	/* keeps the allocated storage for the next render */
+	void clear() noexcept { if (buf_) buf_->size = 0; }
+
+	/* gives up ownership, the caller frees with hoedown_buffer_free */
+	hoedown_buffer *release() noexcept { return std::exchange(buf_, nullptr); }
+
+private:
+	Buffer(hoedown_buffer *buf, int) noexcept : buf_(buf) {}
+
+	hoedown_buffer *buf_;
+};
+
+
+/************
+ * RENDERER *
+ ************/
+
+/* default_localization: English float names, as used by the scidown tool */
+inline localization
+default_localization() noexcept
+{
+	localization local;
+	local.figure = const_cast<char *>("Figure");
+	local.listing = const_cast<char *>("Listing");
+	local.table = const_cast<char *>("Table");
+	return local;
+}
+
+/* Renderer: owns a renderer created by one of the C constructors */
+class Renderer {
+public:
+	enum class Kind { html, html_toc, latex, text };
+
+	static Renderer html(scidown_render_flags flags = scidown_render_flags(), int nesting_level = 0,
+		localization local = default_localization())
+	{
+		return Renderer(Kind::html, hoedown_html_renderer_new(flags, nesting_level, local));
+	}
+
+	static Renderer html_toc(int nesting_level = 0, localization local = default_localization())
+	{
+		return Renderer(Kind::html_toc, hoedown_html_toc_renderer_new(nesting_level, local));
+	}
+
+	static Renderer latex(scidown_render_flags flags = scidown_render_flags(), int nesting_level = 0,
+		localization local = default_localization())
+	{
+		return Renderer(Kind::latex, scidown_latex_renderer_new(flags, nesting_level, local));
+	}
+
+	static Renderer text(scidown_render_flags flags = scidown_render_flags())
+	{
+		return Renderer(Kind::text, scidown_text_renderer_new(flags));
+	}
+
+	Renderer(Renderer &&other) noexcept
+		: kind_(other.kind_), renderer_(std::exchange(other.renderer_, nullptr)) {}
+	Renderer &operator=(Renderer &&other) noexcept
+	{
+		std::swap(kind_, other.kind_);
+		std::swap(renderer_, other.renderer_);
+		return *this;
+	}
+	Renderer(const Renderer &) = delete;
+	Renderer &operator=(const Renderer &) = delete;
+	~Renderer() { destroy(); }
+
+	hoedown_renderer *get() const noexcept { return renderer_; }
+	Kind kind() const noexcept { return kind_; }
+
+	/* reset: forget the float numbers and offsets of the previous render,
+	 * so that the next one numbers its figures from one again */
+	void reset() noexcept
+	{
+		switch (kind_) {
+		case Kind::html:
+		case Kind::html_toc:
+			hoedown_html_renderer_reset(renderer_);
+			break;
+		case Kind::latex:
+			scidown_latex_renderer_reset(renderer_);
+			break;
+		case Kind::text:
+			scidown_text_renderer_reset(renderer_);
+			break;
+		}
+	}
+
+private:
+	Renderer(Kind kind, hoedown_renderer *renderer) noexcept : kind_(kind), renderer_(renderer) {}
+
+	void destroy() noexcept
+	{
+		if (!renderer_)
+			return;
+
+		switch (kind_) {
+		case Kind::html:
+		case Kind::html_toc:
+			hoedown_html_renderer_free(renderer_);
+			break;
+		case Kind::latex:
+			scidown_latex_renderer_free(renderer_);
+			break;
+		case Kind::text:
+			scidown_text_renderer_free(renderer_);
+			break;
+		}
+	}
+
+	Kind kind_;
+	hoedown_renderer *renderer_;
+};
+
+
+/************
+ * DOCUMENT *
+ ************/
+
+/* Document: owns a document processor; the renderer and the ext_definition
+ * it was created with must outlive it */
+class Document {
+public:
+	static constexpr hoedown_extensions default_extensions =
+		static_cast<hoedown_extensions>(HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS);
+
+	explicit Document(const Renderer &renderer, hoedown_extensions extensions = default_extensions,
+		ext_definition *external = nullptr, const char *base_folder = nullptr, size_t max_nesting = 16)
+		: doc_(hoedown_document_new(renderer.get(), extensions, external, base_folder, max_nesting)) {}
+
+	Document(Document &&other) noexcept
+		: doc_(std::exchange(other.doc_, nullptr)), source_(std::move(other.source_)) {}
+	Document &operator=(Document &&other) noexcept
+	{
+		std::swap(doc_, other.doc_);
+		std::swap(source_, other.source_);
+		return *this;
+	}
+	Document(const Document &) = delete;
+	Document &operator=(const Document &) = delete;
+	~Document() { if (doc_) hoedown_document_free(doc_); }
+
+	hoedown_document *get() const noexcept { return doc_; }
+
+	/* render: append the rendering of input to ob; the parser reads past
+	 * the end of its input, so input is copied into a NUL-terminated buffer
+	 * kept for the next renders */
+	void render(Buffer &ob, std::string_view input, int position = -1)
+	{
+		hoedown_document_render(doc_, ob.get(), source(input), input.size(), position);
+	}
+
+	Buffer render(std::string_view input, int position = -1)
+	{
+		Buffer ob(input.size() / 2 + 64);
+		render(ob, input, position);
+		return ob;
+	}
+
+	/* render_single_pass: render without the pre-scans of the floats and
+	 * headers, see hoedown_document_render_single_pass */
+	void render_single_pass(Buffer &ob, std::string_view input, int position = -1)
+	{
+		hoedown_document_render_single_pass(doc_, ob.get(), source(input), input.size(), position);
+	}
+
+	void render_inline(Buffer &ob, std::string_view input, int position = -1)
+	{
+		hoedown_document_render_inline(doc_, ob.get(), source(input), input.size(), position);
+	}
+
+private:
+	/* source: NUL-terminated copy of input */
+	const uint8_t *source(std::string_view input)
+	{
+		source_.clear();
+		if (!input.empty())
+			hoedown_buffer_put(source_.get(), reinterpret_cast<const uint8_t *>(input.data()), input.size());
+		return reinterpret_cast<const uint8_t *>(source_.c_str());
+	}
+
+	hoedown_document *doc_;
+	Buffer source_;
+};
+
+
+/***********
+ * SESSION *
+ ***********/
+
+/* Session: a renderer, a document and an output buffer kept across renders,
+ * e.g. for the live preview of an editor. Each render starts from fresh
+ * numbering and reuses the memory of the previous ones */
+class Session {
+public:
+	explicit Session(Renderer renderer, hoedown_extensions extensions = Document::default_extensions,
+		ext_definition external = ext_definition{nullptr, nullptr}, const char *base_folder = nullptr,
+		size_t max_nesting = 16)
+		: renderer_(std::move(renderer)), external_(new ext_definition(external)),
+		  document_(renderer_, extensions, external_, base_folder, max_nesting) {}
+
+	Session(Session &&other) noexcept
+		: renderer_(std::move(other.renderer_)), external_(std::exchange(other.external_, nullptr)),
+		  document_(std::move(other.document_)), output_(std::move(other.output_)) {}
+	Session &operator=(Session &&other) noexcept
+	{
+		std::swap(renderer_, other.renderer_);
+		std::swap(external_, other.external_);
+		std::swap(document_, other.document_);
+		std::swap(output_, other.output_);
+		return *this;
+	}
+	Session(const Session &) = delete;
+	Session &operator=(const Session &) = delete;
+	~Session() { delete external_; }
+
+	Renderer &renderer() noexcept { return renderer_; }
+	Document &document() noexcept { return document_; }
+
+	/* render: the returned view stays valid until the next render or take */
+	std::string_view render(std::string_view input, int position = -1)
+	{
+		if (!output_.get())
+			output_ = Buffer(input.size() / 2 + 64);
+
+		output_.clear();
+		renderer_.reset();
+		document_.render(output_, input, position);
+		return output_.view();
+	}
+
+	/* take: move the output of the last render out of the session */
+	Buffer take() noexcept { return std::move(output_); }
+
+private:
+	Renderer renderer_;
+	ext_definition *external_;	/* stable address, the document points to it */
+	Document document_;
+	Buffer output_;
+};
+
+}
+
+#endif /** SCIDOWN_HPP **/
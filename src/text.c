@@ -0,0 +1,586 @@
+#include "text.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "charclass.h"
+
+/*
+ * Plain text output, meant for search indexing and snippet extraction:
+ * only the visible text is kept, every block is followed by a blank line,
+ * list items and table rows by a newline and table cells by a tab.
+ */
+
+/* put_block • copies content without its surrounding spacing and ends the block */
+static void
+put_block(hoedown_buffer *ob, const uint8_t *data, size_t size)
+{
+	size_t org = 0;
+
+	while (org < size && hoedown_isspace(data[org]))
+		org++;
+
+	while (size > org && hoedown_isspace(data[size - 1]))
+		size--;
+
+	if (org >= size)
+		return;
+
+	hoedown_buffer_put(ob, data + org, size - org);
+	HOEDOWN_BUFPUTSL(ob, "\n\n");
+}
+
+/********************
+ * GENERIC RENDERER *
+ ********************/
+static int
+rndr_autolink(hoedown_buffer *ob, const hoedown_buffer *link, hoedown_autolink_type type, const hoedown_renderer_data *data)
+{
+	(void)type;
+	(void)data;
+
+	if (!link || !link->size)
+		return 0;
+
+	if (hoedown_buffer_prefix(link, "mailto:") == 0)
+		hoedown_buffer_put(ob, link->data + 7, link->size - 7);
+	else
+		hoedown_buffer_put(ob, link->data, link->size);
+
+	return 1;
+}
+
+static void
+rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buffer *lang, const hoedown_renderer_data *data)
+{
+	scidown_text_renderer_state *state = data->opaque;
+
+	/* diagrams are rendered as pictures, their source is not visible */
+	if (lang && (hoedown_buffer_eqs(lang, "charter") ||
+		hoedown_buffer_eqs(lang, "gnuplot") || hoedown_buffer_eqs(lang, "mermaid")))
+		return;
+
+	if (text && !(state->flags & SCIDOWN_RENDER_SKIP_CODE))
+		put_block(ob, text->data, text->size);
+}
+
+static void
+rndr_blockquote(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (content) hoedown_buffer_put(ob, content->data, content->size);
+}
+
+static int
+rndr_codespan(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
+{
+	scidown_text_renderer_state *state = data->opaque;
+
+	if (text && !(state->flags & SCIDOWN_RENDER_SKIP_CODE))
+		hoedown_buffer_put(ob, text->data, text->size);
+	return 1;
+}
+
+static int
+rndr_span(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (!content || !content->size)
+		return 0;
+
+	hoedown_buffer_put(ob, content->data, content->size);
+	return 1;
+}
+
+static int
+rndr_quote(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (!content || !content->size)
+		return 0;
+
+	hoedown_buffer_putc(ob, '"');
+	hoedown_buffer_put(ob, content->data, content->size);
+	hoedown_buffer_putc(ob, '"');
+	return 1;
+}
+
+static int
+rndr_linebreak(hoedown_buffer *ob, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	hoedown_buffer_putc(ob, '\n');
+	return 1;
+}
+
+static void
+rndr_header(hoedown_buffer *ob, const hoedown_buffer *content, int level, const hoedown_renderer_data *data, h_counter counter, int numbering)
+{
+	(void)level;
+	(void)data;
+	(void)counter;
+	(void)numbering;
+
+	if (content)
+		put_block(ob, content->data, content->size);
+}
+
+static int
+rndr_link(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_buffer *link, const hoedown_buffer *title, const hoedown_renderer_data *data)
+{
+	(void)link;
+	(void)title;
+	(void)data;
+
+	if (content && content->size)
+		hoedown_buffer_put(ob, content->data, content->size);
+	return 1;
+}
+
+static void
+rndr_list(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_list_flags flags, const hoedown_renderer_data *data)
+{
+	(void)flags;
+	(void)data;
+
+	if (!content || !content->size)
+		return;
+
+	hoedown_buffer_put(ob, content->data, content->size);
+	hoedown_buffer_putc(ob, '\n');
+}
+
+static void
+rndr_listitem(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_list_flags flags, const hoedown_renderer_data *data)
+{
+	size_t size;
+
+	(void)flags;
+	(void)data;
+
+	if (!content)
+		return;
+
+	size = content->size;
+	while (size && hoedown_isspace(content->data[size - 1]))
+		size--;
+
+	hoedown_buffer_put(ob, content->data, size);
+	hoedown_buffer_putc(ob, '\n');
+}
+
+static void
+rndr_paragraph(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (content)
+		put_block(ob, content->data, content->size);
+}
+
+static void
+rndr_raw_block(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
+{
+	(void)ob;
+	(void)text;
+	(void)data;
+
+	/* raw HTML is not visible text */
+}
+
+static int
+rndr_image(hoedown_buffer *ob, const hoedown_buffer *link, const hoedown_buffer *title, const hoedown_buffer *alt, const hoedown_renderer_data *data)
+{
+	(void)link;
+	(void)title;
+	(void)data;
+
+	if (alt && alt->size)
+		hoedown_buffer_put(ob, alt->data, alt->size);
+	return 1;
+}
+
+static int
+rndr_raw_html(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
+{
+	(void)ob;
+	(void)text;
+	(void)data;
+
+	return 1;
+}
+
+static void
+rndr_table(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data, hoedown_table_flags *flags, int columns)
+{
+	(void)data;
+	(void)flags;
+	(void)columns;
+
+	if (!content || !content->size)
+		return;
+
+	hoedown_buffer_put(ob, content->data, content->size);
+	hoedown_buffer_putc(ob, '\n');
+}
+
+static void
+rndr_table_part(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (content) hoedown_buffer_put(ob, content->data, content->size);
+}
+
+static void
+rndr_tablerow(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	size_t size;
+
+	(void)data;
+
+	if (!content)
+		return;
+
+	/* drop the separator of the last cell */
+	size = content->size;
+	if (size && content->data[size - 1] == '\t')
+		size--;
+
+	hoedown_buffer_put(ob, content->data, size);
+	hoedown_buffer_putc(ob, '\n');
+}
+
+static void
+rndr_tablecell(hoedown_buffer *ob, const hoedown_buffer *content, hoedown_table_flags flags, const hoedown_renderer_data *data)
+{
+	(void)flags;
+	(void)data;
+
+	if (content) hoedown_buffer_put(ob, content->data, content->size);
+	hoedown_buffer_putc(ob, '\t');
+}
+
+static void
+rndr_footnotes(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (content) hoedown_buffer_put(ob, content->data, content->size);
+}
+
+static void
+rndr_footnote_def(hoedown_buffer *ob, const hoedown_buffer *content, unsigned int num, const hoedown_renderer_data *data)
+{
+	(void)num;
+	(void)data;
+
+	if (content) hoedown_buffer_put(ob, content->data, content->size);
+}
+
+static int
+rndr_footnote_ref(hoedown_buffer *ob, int num, const hoedown_renderer_data *data)
+{
+	(void)ob;
+	(void)num;
+	(void)data;
+
+	return 1;
+}
+
+static int
+rndr_math(hoedown_buffer *ob, const hoedown_buffer *text, int displaymode, const hoedown_renderer_data *data)
+{
+	scidown_text_renderer_state *state = data->opaque;
+
+	(void)displaymode;
+
+	if (!(state->flags & SCIDOWN_RENDER_SKIP_MATH))
+		hoedown_buffer_put(ob, text->data, text->size);
+	return 1;
+}
+
+static int
+rndr_eq_math(hoedown_buffer *ob, const hoedown_buffer *text, int displaymode, const hoedown_renderer_data *data)
+{
+	scidown_text_renderer_state *state = data->opaque;
+
+	(void)displaymode;
+
+	if (!(state->flags & SCIDOWN_RENDER_SKIP_MATH))
+		put_block(ob, text->data, text->size);
+	return 1;
+}
+
+static int
+rndr_ref(hoedown_buffer *ob, char *id, int count, const hoedown_renderer_data *data)
+{
+	(void)id;
+	(void)data;
+
+	if (count < 0)
+		HOEDOWN_BUFPUTSL(ob, "??");
+	else
+		hoedown_buffer_printf(ob, "%d", count);
+	return 1;
+}
+
+static void
+rndr_entity(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
+{
+	static const struct {
+		const char *name;
+		uint8_t c;
+	} named[] = {
+		{ "&amp;", '&' },
+		{ "&lt;", '<' },
+		{ "&gt;", '>' },
+		{ "&quot;", '"' },
+		{ "&apos;", '\'' },
+		{ "&nbsp;", ' ' },
+	};
+	unsigned int cp = 0;
+	size_t i;
+
+	(void)data;
+
+	/* numeric references: &#NNN; and &#xHHH; */
+	if (text->size > 3 && text->data[1] == '#') {
+		int hex = (text->data[2] == 'x' || text->data[2] == 'X');
+
+		for (i = hex ? 3 : 2; i < text->size - 1 && cp <= 0x10FFFF; i++) {
+			uint8_t c = hoedown_tolower(text->data[i]);
+
+			if (c >= '0' && c <= '9')
+				cp = cp * (hex ? 16 : 10) + (c - '0');
+			else if (hex && c >= 'a' && c <= 'f')
+				cp = cp * 16 + (c - 'a' + 10);
+			else
+				break;
+		}
+
+		if (i == text->size - 1 && cp > 0 && cp <= 0x10FFFF) {
+			hoedown_buffer_put_utf8(ob, cp);
+			return;
+		}
+	}
+
+	for (i = 0; i < sizeof(named) / sizeof(named[0]); i++) {
+		if (hoedown_buffer_eqs(text, named[i].name)) {
+			hoedown_buffer_putc(ob, named[i].c);
+			return;
+		}
+	}
+
+	hoedown_buffer_put(ob, text->data, text->size);
+}
+
+static void
+rndr_normal_text(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (content)
+		hoedown_buffer_put(ob, content->data, content->size);
+}
+
+static void
+rndr_title(hoedown_buffer *ob, const hoedown_buffer *content, const metadata *data)
+{
+	(void)data;
+
+	put_block(ob, content->data, content->size);
+}
+
+static void
+rndr_authors(hoedown_buffer *ob, Strings *authors)
+{
+	Strings *it;
+
+	for (it = authors; it != NULL; it = it->next) {
+		if (it->str) {
+			hoedown_buffer_puts(ob, it->str);
+			hoedown_buffer_putc(ob, '\n');
+		}
+	}
+	hoedown_buffer_putc(ob, '\n');
+}
+
+static void
+rndr_metadata_block(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	put_block(ob, content->data, content->size);
+}
+
+static void
+rndr_section(hoedown_buffer *ob)
+{
+	(void)ob;
+}
+
+static void
+rndr_open_equation(hoedown_buffer *ob, const char *ref, const hoedown_renderer_data *data)
+{
+	(void)ob;
+	(void)ref;
+	(void)data;
+}
+
+static void
+rndr_close_equation(hoedown_buffer *ob, const hoedown_renderer_data *data)
+{
+	(void)ob;
+	(void)data;
+}
+
+static void
+rndr_open_float(hoedown_buffer *ob, float_args args, const hoedown_renderer_data *data)
+{
+	(void)ob;
+	(void)args;
+	(void)data;
+}
+
+static void
+rndr_close_float(hoedown_buffer *ob, float_args args, const hoedown_renderer_data *data)
+{
+	(void)data;
+
+	if (args.caption)
+		put_block(ob, (const uint8_t *)args.caption, strlen(args.caption));
+}
+
+static void
+rndr_source_offset(hoedown_buffer *ob, size_t offset, const hoedown_renderer_data *data)
+{
+	scidown_text_renderer_state *state = data->opaque;
+	scidown_text_offset *last;
+
+	/* a block which produced no text is superseded by the next one */
+	if (state->offsets_count) {
+		last = &state->offsets[state->offsets_count - 1];
+		if (last->text == ob->size) {
+			last->source = offset;
+			return;
+		}
+	}
+
+	if (state->offsets_count >= state->offsets_asize) {
+		state->offsets_asize = state->offsets_asize ? state->offsets_asize * 2 : 64;
+		state->offsets = hoedown_realloc(state->offsets,
+			state->offsets_asize * sizeof(scidown_text_offset));
+	}
+
+	last = &state->offsets[state->offsets_count++];
+	last->text = ob->size;
+	last->source = offset;
+}
+
+hoedown_renderer *
+scidown_text_renderer_new(scidown_render_flags render_flags)
+{
+	static const hoedown_renderer cb_default = {
+		NULL,
+
+		NULL,
+		rndr_title,
+		rndr_authors,
+		rndr_metadata_block,
+		rndr_metadata_block,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+
+		rndr_section,
+		rndr_section,
+		rndr_open_equation,
+		rndr_close_equation,
+		rndr_open_float,
+		rndr_close_float,
+		rndr_blockcode,
+		rndr_blockquote,
+		rndr_header,
+		NULL,
+		rndr_list,
+		rndr_listitem,
+		rndr_paragraph,
+		rndr_table,
+		rndr_table_part,
+		rndr_table_part,
+		rndr_tablerow,
+		rndr_tablecell,
+		rndr_footnotes,
+		rndr_footnote_def,
+		rndr_raw_block,
+		NULL,
+
+		rndr_autolink,
+		rndr_codespan,
+		rndr_span,
+		rndr_span,
+		rndr_span,
+		rndr_span,
+		rndr_quote,
+		rndr_image,
+		rndr_linebreak,
+		rndr_link,
+		rndr_span,
+		rndr_span,
+		rndr_span,
+		rndr_footnote_ref,
+		rndr_math,
+		rndr_eq_math,
+		rndr_ref,
+		rndr_raw_html,
+
+		rndr_entity,
+		rndr_normal_text,
+
+		NULL,
+		NULL,
+		NULL,
+
+		rndr_source_offset,
+		NULL,
+	};
+
+	scidown_text_renderer_state *state;
+	hoedown_renderer *renderer;
+
+	/* Prepare the state pointer */
+	state = hoedown_malloc(sizeof(scidown_text_renderer_state));
+	memset(state, 0x0, sizeof(scidown_text_renderer_state));
+
+	state->flags = render_flags;
+
+	/* Prepare the renderer */
+	renderer = hoedown_malloc(sizeof(hoedown_renderer));
+	memcpy(renderer, &cb_default, sizeof(hoedown_renderer));
+
+	renderer->opaque = state;
+	return renderer;
+}
+
+void
+scidown_text_renderer_reset(hoedown_renderer *renderer)
+{
+	scidown_text_renderer_state *state = renderer->opaque;
+	state->offsets_count = 0;
+}
+
+void
+scidown_text_renderer_free(hoedown_renderer *renderer)
+{
+	scidown_text_renderer_state *state = renderer->opaque;
+	free(state->offsets);
+	free(state);
+	free(renderer);
+}
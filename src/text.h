@@ -0,0 +1,62 @@
+/* text.h - plain text renderer */
+
+#ifndef SCIDOWN_TEXT_H
+#define SCIDOWN_TEXT_H
+
+#include "document.h"
+#include "buffer.h"
+#include "utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*********
+ * TYPES *
+ *********/
+
+/* scidown_text_offset: start of a top-level block in the output and in the source */
+struct scidown_text_offset {
+	size_t text;
+	size_t source;
+};
+typedef struct scidown_text_offset scidown_text_offset;
+
+struct scidown_text_renderer_state {
+	void *opaque;
+
+	scidown_render_flags flags;
+
+	/* one entry per top-level block, in output order */
+	scidown_text_offset *offsets;
+	size_t offsets_count;
+	size_t offsets_asize;
+};
+typedef struct scidown_text_renderer_state scidown_text_renderer_state;
+
+
+/*************
+ * FUNCTIONS *
+ *************/
+
+/* scidown_text_renderer_new: allocates a plain text renderer; blocks are
+ * separated by a blank line, list items and table rows by a newline and
+ * table cells by a tab. Raw HTML is always skipped, math and code unless
+ * SCIDOWN_RENDER_SKIP_MATH / SCIDOWN_RENDER_SKIP_CODE are given */
+hoedown_renderer *scidown_text_renderer_new(
+	scidown_render_flags render_flags
+) __attribute__ ((malloc));
+
+/* scidown_text_renderer_reset: forgets the offsets recorded by a previous render */
+void scidown_text_renderer_reset(hoedown_renderer *renderer);
+
+/* scidown_text_renderer_free: deallocate a plain text renderer */
+void scidown_text_renderer_free(hoedown_renderer *renderer);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** SCIDOWN_TEXT_H **/
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "charclass.h"
 #include <stdlib.h>
 
 Strings*
@@ -73,3 +74,53 @@ clean_string (char    *string,
  *i = 0;
  return string;
 }
+
+uint32_t
+scidown_hash (const uint8_t *data,
+              size_t         size)
+{
+  return scidown_hash_more(SCIDOWN_HASH_INIT, data, size);
+}
+
+uint32_t
+scidown_hash_more (uint32_t    hash,
+                   const void *data,
+                   size_t      size)
+{
+  const uint8_t *bytes = data;
+  size_t i;
+
+  for (i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+size_t
+scidown_tag_end (const uint8_t *data,
+                 size_t         size)
+{
+  size_t i;
+  uint8_t quote = 0;
+  int after_equal = 0;
+
+  for (i = 1; i < size; ++i) {
+    if (quote) {
+      if (data[i] == quote)
+        quote = 0;
+    } else if (after_equal && (data[i] == '"' || data[i] == '\'')) {
+      quote = data[i];
+      after_equal = 0;
+    } else if (data[i] == '>') {
+      return i + 1;
+    } else if (data[i] == '=') {
+      after_equal = 1;
+    } else if (!hoedown_isspace(data[i])) {
+      after_equal = 0;
+    }
+  }
+
+  return 0;
+}
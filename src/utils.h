@@ -4,6 +4,7 @@
 #define SCIDOWN_UTILS_H
 
 #include <string.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +25,15 @@ typedef enum scidown_render_flags {
 	SCIDOWN_RENDER_CHARTER    = (1 << 5),
 	SCIDOWN_RENDER_GNUPLOT    = (1 << 6),
 	SCIDOWN_RENDER_CSS        = (1 << 7),
+	/* -- plain text renderer -- */
+	SCIDOWN_RENDER_SKIP_MATH  = (1 << 8),
+	SCIDOWN_RENDER_SKIP_CODE  = (1 << 9),
+	/* -- LaTeX renderer -- */
+	SCIDOWN_RENDER_SPLIT      = (1 << 10),
+	/* -- raw HTML filtered through an allow-list -- */
+	SCIDOWN_RENDER_SANITIZE   = (1 << 11),
+	/* -- no cosmetic newlines nor dir="auto" attributes -- */
+	SCIDOWN_RENDER_COMPACT    = (1 << 12),
 } scidown_render_flags;
 
 typedef enum scidown_render_tag {
@@ -59,6 +69,26 @@ void     remove_char  (char    *source,
 char*    clean_string (char    *string,
                        size_t  size);
 
+/* SCIDOWN_HASH_INIT: scidown_hash of no bytes */
+#define SCIDOWN_HASH_INIT 2166136261u
+
+/* scidown_hash: hash of size bytes (FNV-1a), the one used by the tables of
+ * labels, anchors, index terms and paths; stable across runs */
+uint32_t     scidown_hash      (const uint8_t *data,
+                                size_t         size);
+
+/* scidown_hash_more: hash continued over size more bytes, so that
+ * scidown_hash_more(scidown_hash(a), b) is the hash of a followed by b */
+uint32_t     scidown_hash_more (uint32_t       hash,
+                                const void    *data,
+                                size_t         size);
+
+/* scidown_tag_end: offset past the '>' closing the HTML tag at data[0] == '<',
+ * quoted attribute values skipped; a quote only opens a value right after
+ * '='. 0 when the tag is not closed */
+size_t       scidown_tag_end   (const uint8_t *data,
+                                size_t         size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,95 @@
+/* render_to.c - hoedown_document_render_to does not allocate in steady state
+ *
+ * A document is rendered once with hoedown_document_render to learn the size
+ * of its output, then with hoedown_document_render_to into a buffer of
+ * exactly that size. Once the document has warmed up, a render_to must
+ * write the same output and make no allocation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "document.h"
+#include "html.h"
+
+#define BLOCKS 400
+
+static const char block[] =
+	"Some *emphasis*, some **strong** text and `code` in a paragraph\n"
+	"that runs over two lines.\n"
+	"\n"
+	"- a list item\n"
+	"- another one\n"
+	"\n"
+	"> a quote\n"
+	"\n";
+
+static size_t allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+int
+main(void)
+{
+	localization local = {"Figure", "Listing", "Table"};
+	hoedown_renderer *renderer = hoedown_html_renderer_new(0, 0, local);
+	hoedown_document *document = hoedown_document_new(renderer, HOEDOWN_EXT_BLOCK | HOEDOWN_EXT_SPAN | HOEDOWN_EXT_FLAGS, NULL, NULL, 16);
+	hoedown_buffer *expected = hoedown_buffer_new(1024);
+	size_t size = BLOCKS * (sizeof(block) - 1), written, before, i;
+	uint8_t *source = malloc(size + 1), *out;
+	int run, failed = 0;
+
+	for (i = 0; i < BLOCKS; ++i)
+		memcpy(source + i * (sizeof(block) - 1), block, sizeof(block) - 1);
+	/* the pre-scans read the source as a string */
+	source[size] = '\0';
+
+	hoedown_document_render(document, expected, source, size, -1);
+	out = malloc(expected->size);
+
+	for (run = 0; run < 3; ++run) {
+		before = allocations;
+		written = hoedown_document_render_to(document, out, expected->size, source, size, -1);
+		if (written != expected->size || memcmp(out, expected->data, written)) {
+			fprintf(stderr, "render %d: %zu bytes instead of %zu\n", run + 1, written, expected->size);
+			failed = 1;
+		}
+		/* the first render warms up the work buffers */
+		if (run > 0 && allocations != before) {
+			fprintf(stderr, "render %d: %zu allocations\n", run + 1, allocations - before);
+			failed = 1;
+		}
+	}
+
+	hoedown_buffer_free(expected);
+	hoedown_document_free(document);
+	hoedown_html_renderer_free(renderer);
+	free(source);
+	free(out);
+	return failed;
+}
@@ -8,7 +8,7 @@ import re
 import subprocess
 import unittest
 
-TEST_ROOT = os.path.dirname(__file__)
+TEST_ROOT = os.path.abspath(os.path.dirname(__file__))
 PROJECT_ROOT = os.path.dirname(TEST_ROOT)
 HOEDOWN = [os.path.abspath(os.path.join(PROJECT_ROOT, 'hoedown'))]
 TIDY = ['tidy', '--show-body-only', '1', '--show-warnings', '0',
@@ -47,10 +47,20 @@ def _test_func(test_case):
     flags = test_case.get('flags') or []
     hoedown_proc = subprocess.Popen(
         HOEDOWN + flags + [os.path.join(TEST_ROOT, test_case['input'])],
-        stdout=subprocess.PIPE,
+        stdout=subprocess.PIPE, cwd=TEST_ROOT,
     )
     stdoutdata = hoedown_proc.communicate()[0]
 
+    # Non-HTML output is compared byte for byte.
+    if test_case.get('exact', False):
+        hoedown_proc.stdout.close()
+        with open(os.path.join(TEST_ROOT, test_case['output']), 'rb') as f:
+            expected = f.read()
+        if expected != stdoutdata:
+            raise TestFailed(test_case['input'], expected.decode('utf-8'),
+                             stdoutdata.decode('utf-8'))
+        return
+
     got_tidy_proc = subprocess.Popen(
         TIDY, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
     )
@@ -0,0 +1,65 @@
+/* worker.c - the render worker must render what md2html renders
+ *
+ * Each document is rendered in-process with md2html, then twice by the
+ * same worker; the three outputs must be equal. The worker maps its input
+ * at the start of a page, so reads before the first byte of a document
+ * fault there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct md2html_worker md2html_worker;
+
+int md2html(const uint8_t *input_data, size_t input_size, uint8_t **output_data, size_t *output_size, int screen_height);
+md2html_worker *md2html_worker_new(int timeout_ms);
+int md2html_worker_render(md2html_worker *worker, const uint8_t *input_data, size_t input_size, const uint8_t **output_data, size_t *output_size);
+void md2html_worker_free(md2html_worker *worker);
+
+static const char *documents[] = {
+	"Title\n=====\n\ntext\n",
+	"Subtitle\n--------\n\ntext\n",
+	"Title\n=====",
+	"# Title\n\nSubtitle\n--------\n",
+	"text\n",
+	"",
+};
+
+int
+main(void)
+{
+	md2html_worker *worker = md2html_worker_new(0);
+	const uint8_t *mapped;
+	uint8_t *output;
+	size_t i, size, output_size, mapped_size;
+	int r, run, failed = 0;
+
+	if (!worker) {
+		fprintf(stderr, "cannot start the worker\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(documents) / sizeof(documents[0]); ++i) {
+		size = strlen(documents[i]);
+		output = NULL;
+		output_size = 0;
+		md2html((const uint8_t *)documents[i], size, &output, &output_size, -1);
+
+		for (run = 0; run < 2; ++run) {
+			mapped = NULL;
+			mapped_size = 0;
+			r = md2html_worker_render(worker, (const uint8_t *)documents[i], size, &mapped, &mapped_size);
+			if (r != 0 || mapped_size != output_size || (output_size && memcmp(mapped, output, output_size))) {
+				fprintf(stderr, "document %zu, render %d: status %d, %zu bytes instead of %zu\n",
+					i, run + 1, r, mapped_size, output_size);
+				failed = 1;
+			}
+		}
+		free(output);
+	}
+
+	md2html_worker_free(worker);
+	return failed;
+}